@@ -0,0 +1,384 @@
+/**
+ * @file headless-render.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Offline renderer that does not need a display. Renders one of the
+ * built-in scenes and writes the result to disk.
+ *
+ * Usage: headless-render [--scene N] [--width W] [--height H] [--spp S]
+ *                        [--depth D] [--rr-depth R] [--threads T]
+ *                        [--tonemap clamp|reinhard] [--adaptive E]
+ *                        [--min-spp N] [--max-spp N] [--heatmap FILE]
+ *                        [--packet 1|4|8|16] [--integrator path|wavefront]
+ *                        [--sampler independent|sobol] [--denoise]
+ *                        [--aov LIST] [--aov-format EXT] [--output FILE]
+ *                        [--workers N] [--listen ADDR] [--task-tiles N]
+ *                        [--task-samples N] [--worker-timeout S]
+ *                        [--checkpoint FILE] [--checkpoint-interval S]
+ *                        [--deterministic] [--seed N]
+ *        headless-render --worker ADDR [--threads T]
+ * @version 0.1
+ * @date 2024-10-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "DistributedRenderer.hpp"
+#include "HeadlessRenderer.hpp"
+#include "scenes.hpp"
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+struct render_options {
+  int scene = 5;
+  int screen_width = 1000;
+  int screen_height = 562;
+  int samples_per_pixel = 100;
+  int max_depth = 10;
+  int rr_depth = 3;
+  int threads = 0;
+  tonemap_operator tonemap = tonemap_operator::clamp;
+  float adaptive_threshold = 0;
+  int min_samples = 16;
+  int max_samples = 0;
+  std::string heatmap;
+  int packet_size = 4;
+  bool wavefront = false;
+  sampler_type sampling = sampler_type::sobol;
+  bool denoise = false;
+  bool deterministic = false;  // Reproducible samples, see --deterministic
+  uint32_t seed = 0;
+  aov_set aovs = 0;
+  std::string aov_format = "pfm";
+  std::string output = "render.png";
+  int workers = 0;             // Worker processes to start on this machine
+  std::string listen;          // Address the coordinator listens on
+  std::string worker;          // Address of the coordinator to work for
+  int task_tiles = 16;         // Tiles of a distributed task
+  int task_samples = 0;        // Samples of a distributed task, 0 for all
+  float worker_timeout = 60;   // Seconds before a silent worker is dropped
+  std::string checkpoint;      // File the render is saved to and resumed from
+  float checkpoint_interval = 60;  // Seconds between two checkpoint saves
+};
+
+void print_usage(const char* program) {
+  std::cout
+      << "Usage: " << program << " [options]\n"
+      << "  --scene N    Scene to render (1-5, default 5)\n"
+      << "  --width W    Image width in pixels (default 1000)\n"
+      << "  --height H   Image height in pixels (default 562)\n"
+      << "  --spp S      Samples per pixel (default 100)\n"
+      << "  --depth D    Maximum ray depth (default 10)\n"
+      << "  --rr-depth R Depth at which Russian roulette starts (default 3)\n"
+      << "  --threads T  Number of render threads (default: all cores)\n"
+      << "  --tonemap O  clamp or reinhard (default clamp)\n"
+      << "  --adaptive E Enable adaptive sampling, stop sampling pixels whose\n"
+      << "               relative error is below E (e.g. 0.05). --spp becomes\n"
+      << "               the average sample budget\n"
+      << "  --min-spp N  Samples before a pixel can converge (default 16)\n"
+      << "  --max-spp N  Maximum samples of a pixel (default 8 * spp)\n"
+      << "  --heatmap F  Write a heatmap of the samples per pixel to F\n"
+      << "  --packet N   Camera rays traced together: 1, 4, 8 or 16\n"
+      << "               (default 4)\n"
+      << "  --integrator I path or wavefront (default path)\n"
+      << "  --sampler S  independent or sobol (default sobol)\n"
+      << "  --denoise    Denoise the image, good results from 8-16 spp\n"
+      << "  --aov L      Extra passes written next to the output, a comma\n"
+      << "               separated list of depth, normal, albedo, object,\n"
+      << "               material, path, visits, or all\n"
+      << "  --aov-format pfm (raw values, default) or an image format\n"
+      << "  --output F   Output image (default render.png)\n"
+      << "  --workers N  Split the render across N worker processes\n"
+      << "  --listen A   Also accept workers on address A, unix:/path or\n"
+      << "               host:port (*:port for every interface)\n"
+      << "  --task-tiles N   16x16 tiles of a worker task (default 16)\n"
+      << "  --task-samples N Samples of a worker task (default: all)\n"
+      << "  --worker-timeout S Seconds before the task of a silent worker\n"
+      << "               is given to another one (default 60)\n"
+      << "  --worker A   Run as a worker of the coordinator at address A\n"
+      << "  --checkpoint F Save the render to F as it goes, and resume it\n"
+      << "               from F if it was interrupted\n"
+      << "  --checkpoint-interval S Seconds between two saves (default 60)\n"
+      << "  --deterministic Bit identical images whatever the thread count,\n"
+      << "               for before/after comparisons\n"
+      << "  --seed N     Seed of the samples (default 0)\n";
+}
+
+/**
+ * @brief Parse the command line into the render options
+ *
+ * @return true if the options are valid, false otherwise
+ */
+bool parse_options(int argc, char** argv, render_options& options) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) return false;
+    if (!strcmp(arg, "--denoise")) {
+      options.denoise = true;
+      continue;
+    }
+    if (!strcmp(arg, "--deterministic")) {
+      options.deterministic = true;
+      continue;
+    }
+
+    // Every other option takes a value
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << "\n";
+      return false;
+    }
+    const char* value = argv[++i];
+
+    if (!strcmp(arg, "--scene"))
+      options.scene = atoi(value);
+    else if (!strcmp(arg, "--width"))
+      options.screen_width = atoi(value);
+    else if (!strcmp(arg, "--height"))
+      options.screen_height = atoi(value);
+    else if (!strcmp(arg, "--spp"))
+      options.samples_per_pixel = atoi(value);
+    else if (!strcmp(arg, "--depth"))
+      options.max_depth = atoi(value);
+    else if (!strcmp(arg, "--rr-depth"))
+      options.rr_depth = atoi(value);
+    else if (!strcmp(arg, "--threads"))
+      options.threads = atoi(value);
+    else if (!strcmp(arg, "--tonemap")) {
+      if (!strcmp(value, "clamp"))
+        options.tonemap = tonemap_operator::clamp;
+      else if (!strcmp(value, "reinhard"))
+        options.tonemap = tonemap_operator::reinhard;
+      else {
+        std::cerr << "Unknown tonemap operator " << value << "\n";
+        return false;
+      }
+    } else if (!strcmp(arg, "--adaptive"))
+      options.adaptive_threshold = (float)atof(value);
+    else if (!strcmp(arg, "--min-spp"))
+      options.min_samples = atoi(value);
+    else if (!strcmp(arg, "--max-spp"))
+      options.max_samples = atoi(value);
+    else if (!strcmp(arg, "--heatmap"))
+      options.heatmap = value;
+    else if (!strcmp(arg, "--packet"))
+      options.packet_size = atoi(value);
+    else if (!strcmp(arg, "--integrator")) {
+      if (!strcmp(value, "path"))
+        options.wavefront = false;
+      else if (!strcmp(value, "wavefront"))
+        options.wavefront = true;
+      else {
+        std::cerr << "Unknown integrator " << value << "\n";
+        return false;
+      }
+    } else if (!strcmp(arg, "--sampler")) {
+      if (!strcmp(value, "independent"))
+        options.sampling = sampler_type::independent;
+      else if (!strcmp(value, "sobol"))
+        options.sampling = sampler_type::sobol;
+      else {
+        std::cerr << "Unknown sampler " << value << "\n";
+        return false;
+      }
+    } else if (!strcmp(arg, "--aov")) {
+      if (!aov_buffer::parse(value, options.aovs)) {
+        std::cerr << "Unknown passes " << value << "\n";
+        return false;
+      }
+    } else if (!strcmp(arg, "--aov-format"))
+      options.aov_format = value;
+    else if (!strcmp(arg, "--output"))
+      options.output = value;
+    else if (!strcmp(arg, "--workers"))
+      options.workers = atoi(value);
+    else if (!strcmp(arg, "--listen"))
+      options.listen = value;
+    else if (!strcmp(arg, "--worker"))
+      options.worker = value;
+    else if (!strcmp(arg, "--task-tiles"))
+      options.task_tiles = atoi(value);
+    else if (!strcmp(arg, "--task-samples"))
+      options.task_samples = atoi(value);
+    else if (!strcmp(arg, "--worker-timeout"))
+      options.worker_timeout = (float)atof(value);
+    else if (!strcmp(arg, "--seed"))
+      options.seed = (uint32_t)strtoul(value, nullptr, 10);
+    else if (!strcmp(arg, "--checkpoint"))
+      options.checkpoint = value;
+    else if (!strcmp(arg, "--checkpoint-interval"))
+      options.checkpoint_interval = (float)atof(value);
+    else {
+      std::cerr << "Unknown option " << arg << "\n";
+      return false;
+    }
+  }
+
+  return options.screen_width > 0 && options.screen_height > 0 &&
+         options.samples_per_pixel > 0 && options.max_depth > 0 &&
+         options.rr_depth >= 0 && options.adaptive_threshold >= 0 &&
+         options.min_samples > 0 && options.max_samples >= 0 &&
+         (options.packet_size == 1 || options.packet_size == 4 ||
+          options.packet_size == 8 || options.packet_size == 16) &&
+         options.workers >= 0 && options.task_tiles > 0 &&
+         options.task_samples >= 0 && options.worker_timeout > 0 &&
+         options.checkpoint_interval >= 0;
+}
+
+/**
+ * @brief Render with worker processes, started here (--workers) or on other
+ * machines (--listen)
+ *
+ * @return true if every task was rendered, false otherwise
+ */
+bool render_distributed(const char* program, const render_options& options,
+                        HeadlessRenderer& renderer,
+                        RenderCoordinator& coordinator) {
+  if (options.adaptive_threshold > 0 || options.denoise || options.aovs ||
+      options.wavefront || !options.checkpoint.empty())
+    std::cerr << "Adaptive sampling, denoising, passes, checkpoints and the "
+                 "wavefront integrator are not used by distributed renders\n";
+  renderer.set_denoise(false);
+  renderer.set_aovs(0);
+
+  // Local workers share the cores of this machine
+  const std::string address =
+      !options.listen.empty()
+          ? options.listen
+          : "unix:/tmp/headless-render-" + std::to_string(getpid()) +
+                ".sock";
+  const int cores = (int)std::thread::hardware_concurrency();
+  const int threads =
+      options.threads > 0
+          ? options.threads
+          : std::max(1, cores / std::max(1, options.workers));
+
+  coordinator.set_task_size(options.task_tiles, options.task_samples);
+  coordinator.set_worker_timeout(options.worker_timeout);
+  if (!coordinator.listen(address) ||
+      !coordinator.spawn_workers(program, options.workers, threads))
+    return false;
+
+  const auto start_time = Clock::now();
+  if (!coordinator.render(options.samples_per_pixel, renderer)) return false;
+
+  std::cout << "Distributed " << coordinator.get_task_count()
+            << " tasks to " << coordinator.get_worker_count()
+            << " workers in "
+            << std::chrono::duration_cast<Secondsf>(Clock::now() -
+                                                    start_time)
+                   .count()
+            << " s (" << coordinator.get_reassigned_tasks()
+            << " reassigned, " << coordinator.get_compressed_bytes() / 1024
+            << " KiB received for " << coordinator.get_raw_bytes() / 1024
+            << " KiB of samples)\n";
+  return true;
+}
+
+int main(int argc, char** argv) {
+  render_options options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  if (!options.worker.empty()) {
+    RenderWorker worker;
+    worker.set_threads(options.threads);
+    return worker.run(options.worker) ? 0 : 1;
+  }
+
+  hittable_list world = make_scene(options.scene);
+
+  HeadlessRenderer renderer(options.screen_width, options.screen_height,
+                            options.max_depth);
+  renderer.set_world(&world);
+  renderer.set_threads(options.threads);
+  renderer.set_russian_roulette_depth(options.rr_depth);
+  renderer.set_tonemap(options.tonemap);
+  renderer.set_packet_size(options.packet_size);
+  renderer.set_wavefront(options.wavefront);
+  renderer.set_sampler(options.sampling);
+  renderer.set_deterministic(options.deterministic, options.seed);
+  renderer.set_denoise(options.denoise);
+  renderer.set_aovs(options.aovs);
+  renderer.set_checkpoint(options.checkpoint, options.scene,
+                          options.checkpoint_interval);
+  renderer.set_adaptive(options.adaptive_threshold, options.min_samples,
+                        options.max_samples > 0
+                            ? options.max_samples
+                            : 8 * options.samples_per_pixel);
+
+  const bool distributed = options.workers > 0 || !options.listen.empty();
+  if (distributed) {
+    render_job job;
+    job.scene = options.scene;
+    job.width = options.screen_width;
+    job.height = options.screen_height;
+    job.max_depth = options.max_depth;
+    job.rr_depth = options.rr_depth;
+    job.packet_size = options.packet_size;
+    job.sampling = options.sampling;
+    job.seed = options.seed;
+    job.deterministic = options.deterministic ? 1 : 0;
+
+    RenderCoordinator coordinator(job);
+    if (!render_distributed(argv[0], options, renderer, coordinator)) {
+      std::cerr << "The distributed render failed\n";
+      return 1;
+    }
+  } else {
+    renderer.render(options.samples_per_pixel);
+  }
+
+  if (!renderer.save(options.output.c_str())) {
+    std::cerr << "Could not write " << options.output << "\n";
+    return 1;
+  }
+
+  // The passes are named after the output: render.png -> render_depth.pfm.
+  // Only the extension of the file name is dropped, not a dot of a directory
+  const std::string prefix =
+      std::filesystem::path(options.output).replace_extension().string();
+  if (options.aovs && !renderer.save_aovs(prefix, options.aov_format)) {
+    std::cerr << "Could not write the passes of " << options.output << "\n";
+    return 1;
+  }
+
+  if (!options.heatmap.empty() &&
+      !renderer.save_heatmap(options.heatmap.c_str())) {
+    std::cerr << "Could not write " << options.heatmap << "\n";
+    return 1;
+  }
+
+  std::cout << "Rendered " << options.screen_width << "x"
+            << options.screen_height << " @ " << options.samples_per_pixel
+            << " spp to " << options.output << "\n";
+  if (distributed) return 0;
+
+  if (renderer.get_resumed_samples() > 0)
+    std::cout << "Resumed from " << renderer.get_resumed_samples()
+              << " spp in " << options.checkpoint << "\n";
+  std::cout << "Wall time: " << renderer.get_render_duration() << " s\n"
+            << "Camera rays: " << renderer.get_rays_sent() << "\n"
+            << "Rays traced: " << renderer.get_rays_traced() << " ("
+            << renderer.get_mrays_per_second() << " Mrays/s)\n"
+            << "Average path length: " << renderer.get_average_path_length()
+            << "\n";
+  if (options.denoise)
+    std::cout << "Denoise time: " << renderer.get_denoise_duration()
+              << " s\n";
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file bench_bvh_build.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Benchmark of the BVH build. Builds the linear BVH over clouds of
+ * random spheres of growing size with 1, 2, 4, ... threads up to the OpenMP
+ * default, and checks that every thread count gives the same tree.
+ *
+ * Usage: bench_bvh_build [largest primitive count] [repetitions]
+ * @version 0.1
+ * @date 2024-12-04
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cstdlib>
+
+#include "objects/linear_bvh.hpp"
+#include "objects/sphere.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief Spheres in a cube, denser in one corner so that the tree is not
+ * trivially balanced
+ *
+ */
+hittable_list make_cloud(const size_t count) {
+  auto mat = make_shared<lambertian>(vec3(0.5f, 0.5f, 0.5f));
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> position(0.0f, 1.0f);
+
+  const float radius = 2.0f / std::cbrt((float)count);
+  hittable_list cloud;
+  for (size_t i = 0; i < count; i++) {
+    const float x = position(generator), y = position(generator),
+                z = position(generator);
+    cloud.add(make_shared<sphere>(
+        vec3(100.0f * x * x, 100.0f * y, -100.0f * z), radius, mat));
+  }
+  return cloud;
+}
+
+int main(int argc, char** argv) {
+  const size_t largest = argc > 1 ? atol(argv[1]) : 1000000;
+  const int repetitions = argc > 2 ? atoi(argv[2]) : 3;
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  int max_threads = 1;
+#ifdef _OPENMP
+  max_threads = omp_get_max_threads();
+#endif
+
+  for (size_t count = 10000; count <= largest; count *= 10) {
+    const hittable_list cloud = make_cloud(count);
+
+    float serial_time = 0;
+    size_t serial_nodes = 0;
+    float serial_cost = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+      bvh_build_options options;
+      options.threads = threads;
+
+      // The fastest of the repetitions
+      float best = infinity;
+      size_t nodes = 0;
+      float cost = 0;
+      for (int r = 0; r < repetitions; r++) {
+        const auto start_time = Clock::now();
+        linear_bvh bvh(cloud, options);
+        const float duration = std::chrono::duration_cast<Secondsf>(
+                                   Clock::now() - start_time)
+                                   .count();
+        best = std::min(best, duration);
+        nodes = bvh.get_nodes().size();
+        cost = bvh.get_sah_cost();
+      }
+
+      if (threads == 1) {
+        serial_time = best;
+        serial_nodes = nodes;
+        serial_cost = cost;
+      }
+
+      std::cout << count << " primitives, " << threads
+                << " threads: " << best * 1000.0f << " ms, "
+                << count / best / 1e6f << " Mprims/s, speedup "
+                << serial_time / best << "x, " << nodes
+                << " nodes, SAH cost " << cost
+                << (nodes == serial_nodes && cost == serial_cost
+                        ? ""
+                        : " (differs from 1 thread)")
+                << "\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file bench_bvh_refit.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Benchmark of the BVH updates of an animated scene. Every frame a
+ * part of the spheres of a cloud take a small random step, then the trees are
+ * either refitted (rebuilt past the threshold of the options) or rebuilt from
+ * scratch.
+ *
+ * Usage: bench_bvh_refit [primitive count] [frames]
+ * @version 0.1
+ * @date 2024-12-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cstdlib>
+
+#include "objects/bvh4.hpp"
+#include "objects/sphere.hpp"
+
+// Spheres in a cube, as in bench_bvh_build
+hittable_list make_cloud(const size_t count) {
+  auto mat = make_shared<lambertian>(vec3(0.5f, 0.5f, 0.5f));
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> position(0.0f, 1.0f);
+
+  const float radius = 2.0f / std::cbrt((float)count);
+  hittable_list cloud;
+  for (size_t i = 0; i < count; i++) {
+    const float x = position(generator), y = position(generator),
+                z = position(generator);
+    cloud.add(make_shared<sphere>(
+        vec3(100.0f * x * x, 100.0f * y, -100.0f * z), radius, mat));
+  }
+  return cloud;
+}
+
+/**
+ * @brief Animate a fraction of the cloud for some frames and update a tree
+ * of type Tree after every frame
+ *
+ */
+template <typename Tree>
+void animate(const char* name, const size_t count, const int frames,
+             const float fraction) {
+  hittable_list cloud = make_cloud(count);
+  Tree tree(cloud);
+  std::mt19937 generator(2);
+  std::uniform_int_distribution<size_t> pick(0, count - 1);
+  std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+  const size_t moving = std::max((size_t)1, (size_t)(fraction * count));
+
+  float refit_time = 0, rebuild_time = 0;
+  int rebuilds = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    for (size_t i = 0; i < moving; i++) {
+      const size_t object = pick(generator);
+      cloud.objects[object]->move(
+          vec3(step(generator), step(generator), step(generator)));
+      tree.mark_moved(object);
+    }
+
+    auto start_time = Clock::now();
+    rebuilds += tree.refit();
+    refit_time +=
+        std::chrono::duration_cast<Secondsf>(Clock::now() - start_time)
+            .count();
+
+    start_time = Clock::now();
+    Tree rebuilt(cloud);
+    rebuild_time +=
+        std::chrono::duration_cast<Secondsf>(Clock::now() - start_time)
+            .count();
+  }
+
+  std::cout << name << ", " << count << " primitives, " << fraction * 100
+            << "% moving: refit " << refit_time * 1000.0f / frames
+            << " ms/frame, rebuild " << rebuild_time * 1000.0f / frames
+            << " ms/frame, speedup " << rebuild_time / refit_time << "x, "
+            << rebuilds << " rebuilds by the refits, cost "
+            << tree.get_degradation() << "x the last build\n";
+}
+
+int main(int argc, char** argv) {
+  const size_t count = argc > 1 ? atol(argv[1]) : 100000;
+  const int frames = argc > 2 ? atoi(argv[2]) : 20;
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  for (const float fraction : {0.001f, 0.01f, 0.1f, 1.0f}) {
+    animate<linear_bvh>("linear_bvh", count, frames, fraction);
+    animate<bvh4>("bvh4", count, frames, fraction);
+  }
+  return 0;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file bench_rng.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Microbenchmark of the random number generators. Draws random floats
+ * on all cores with the old raylib based generator (a shared libc rand()) and
+ * with the thread local xoshiro generator used by random_float().
+ *
+ * Usage: bench_rng [samples per thread]
+ * @version 0.1
+ * @date 2024-11-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cstdlib>
+#include <unordered_set>
+
+#include "utils.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// The generator random_float() used before the thread local generators
+inline float legacy_random_float() {
+  return (float)GetRandomValue(0, 1000) / 1000.0f;
+}
+
+/**
+ * @brief Draw samples floats on every thread with the given generator
+ *
+ * @return float Millions of floats per second over all threads
+ */
+template <typename Generator>
+float measure(const char* name, const long samples, Generator generate) {
+  int threads = 1;
+  float checksum = 0;
+
+  const auto start_time = Clock::now();
+
+#ifdef _OPENMP
+#pragma omp parallel reduction(+ : checksum)
+#endif
+  {
+#ifdef _OPENMP
+#pragma omp single
+    threads = omp_get_num_threads();
+#endif
+
+    float sum = 0;
+    for (long i = 0; i < samples; i++) sum += generate();
+    checksum += sum;
+  }
+
+  const float duration =
+      std::chrono::duration_cast<Secondsf>(Clock::now() - start_time).count();
+  const float rate = samples * threads / duration / 1e6f;
+
+  // Count the distinct values of a short sequence to show the resolution
+  std::unordered_set<float> values;
+  for (int i = 0; i < 100000; i++) values.insert(generate());
+
+  std::cout << name << ": " << rate << " Mfloats/s on " << threads
+            << " threads, " << values.size()
+            << " distinct values in 100000 draws (checksum " << checksum
+            << ")\n";
+  return rate;
+}
+
+int main(int argc, char** argv) {
+  const long samples = argc > 1 ? atol(argv[1]) : 10000000;
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  const float legacy = measure("GetRandomValue", samples,
+                               [] { return legacy_random_float(); });
+  const float local =
+      measure("thread_rng", samples, [] { return random_float(); });
+
+  std::cout << "Speedup: " << local / legacy << "x\n";
+  return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file bench_slab_test.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Microbenchmark of the ray/box slab test. Tests rays against the
+ * boxes of the children of the BVH nodes of every scene, with the old test (a
+ * division and a branch per axis) and with aabb::hit (the inverse direction
+ * of the ray computed once and the planes picked by its sign). The camera
+ * rays are coherent, the bounce rays start anywhere in the scene and go in
+ * any direction, as the rays after the first hit.
+ *
+ * Usage: bench_slab_test [box tests per scene]
+ * @version 0.1
+ * @date 2024-12-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <cstdlib>
+
+#include "camera.hpp"
+#include "objects/bvh4.hpp"
+#include "scenes.hpp"
+
+// The slab test aabb::hit used before the rays carried their inverse
+// direction
+inline bool legacy_hit(const aabb& box, const ray& r, interval ray_t) {
+  const vec3& ray_orig = r.origin();
+  const vec3& ray_dir = r.direction();
+
+  for (int axis = 0; axis < 3; axis++) {
+    const interval& ax = box.axis_interval(axis);
+    const float adinv = 1.0f / ray_dir[axis];
+
+    auto t0 = (ax.min - ray_orig[axis]) * adinv;
+    auto t1 = (ax.max - ray_orig[axis]) * adinv;
+
+    if (t0 < t1) {
+      if (t0 > ray_t.min) ray_t.min = t0;
+      if (t1 < ray_t.max) ray_t.max = t1;
+    } else {
+      if (t1 > ray_t.min) ray_t.min = t1;
+      if (t0 < ray_t.max) ray_t.max = t0;
+    }
+
+    if (ray_t.max <= ray_t.min) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Test every ray against every box until at least tests box tests
+ * are done. Every pass starts the rays a little further, so that the passes
+ * are not folded into one.
+ *
+ * @param hits Set to the hits of one pass over the rays
+ * @return float Nanoseconds per box test
+ */
+template <typename Test>
+float measure(const std::vector<ray>& rays, const std::vector<aabb>& boxes,
+              const long tests, size_t& hits, Test test) {
+  const long per_pass = (long)(rays.size() * boxes.size());
+  const long passes = std::max(1L, tests / per_pass);
+
+  size_t total = 0;
+  const auto start_time = Clock::now();
+  for (long pass = 0; pass < passes; pass++) {
+    const interval ray_t(0.001f * (pass + 1), infinity);
+    // Boxes outside, so that the work on one ray is not shared by several
+    // boxes, the tree meets a ray once per node
+    for (const aabb& box : boxes)
+      for (const ray& r : rays) total += test(box, r, ray_t);
+  }
+  const float duration =
+      std::chrono::duration_cast<Secondsf>(Clock::now() - start_time).count();
+
+  // All the rays start before the boxes, every pass has the same hits
+  hits = total / passes;
+  return duration * 1e9f / (passes * per_pass);
+}
+
+/**
+ * @brief Print the cost of both tests for one set of rays
+ *
+ * @return float The speedup of aabb::hit
+ */
+float compare(const char* name, const std::vector<ray>& rays,
+              const std::vector<aabb>& boxes, const long tests) {
+  size_t legacy_hits = 0, current_hits = 0;
+  const float legacy =
+      measure(rays, boxes, tests, legacy_hits,
+              [](const aabb& box, const ray& r, const interval& ray_t) {
+                return legacy_hit(box, r, ray_t);
+              });
+  const float current =
+      measure(rays, boxes, tests, current_hits,
+              [](const aabb& box, const ray& r, const interval& ray_t) {
+                return box.hit(r, ray_t);
+              });
+
+  std::cout << "  " << name << " rays: " << legacy << " ns per test before, "
+            << current << " ns after, speedup " << legacy / current << "x"
+            << (legacy_hits == current_hits ? "" : " (the hits differ)")
+            << "\n";
+  return legacy / current;
+}
+
+int main(int argc, char** argv) {
+  const long tests = argc > 1 ? atol(argv[1]) : 50000000;
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  const int width = 320, height = 180;
+  camera cam(width, height, 10);
+  std::vector<ray> rays;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      sampler s(sampler_type::independent, 0, true);
+      s.start_pixel_sample(y * width + x, 0);
+      rays.push_back(cam.get_ray(x + 0.5f, y + 0.5f, s));
+    }
+  }
+
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> position(0.0f, 1.0f);
+
+  float camera_speedup = 0, bounce_speedup = 0;
+  for (int scene = 1; scene <= 5; scene++) {
+    const hittable_list world = make_scene(scene);
+
+    // The boxes a ray is tested against while it walks the tree
+    std::vector<aabb> boxes;
+    for (const shared_ptr<hittable>& object : world.objects) {
+      const bvh4* tree = dynamic_cast<const bvh4*>(object.get());
+      if (!tree) {
+        boxes.push_back(object->bounding_box());
+        continue;
+      }
+      for (const bvh4_node& node : tree->get_nodes())
+        for (uint32_t c = 0; c < node.child_count; c++)
+          boxes.push_back(aabb(
+              vec3(node.bounds_min[0][c], node.bounds_min[1][c],
+                   node.bounds_min[2][c]),
+              vec3(node.bounds_max[0][c], node.bounds_max[1][c],
+                   node.bounds_max[2][c])));
+    }
+
+    // The box of the list itself starts from the universe
+    aabb bbox = aabb::empty;
+    for (const shared_ptr<hittable>& object : world.objects)
+      bbox = aabb(bbox, object->bounding_box());
+
+    std::vector<ray> bounces;
+    for (size_t i = 0; i < rays.size(); i++) {
+      vec3 origin;
+      for (int axis = 0; axis < 3; axis++) {
+        const interval& extent = bbox.axis_interval(axis);
+        origin[axis] = extent.min + position(generator) * extent.size();
+      }
+      bounces.push_back(ray(origin, random_unit_vector()));
+    }
+
+    std::cout << "Scene " << scene << ", " << boxes.size() << " boxes\n";
+    camera_speedup += compare("Camera", rays, boxes, tests);
+    bounce_speedup += compare("Bounce", bounces, boxes, tests);
+  }
+
+  std::cout << "Mean speedup: " << camera_speedup / 5
+            << "x for the camera rays, " << bounce_speedup / 5
+            << "x for the bounce rays\n";
+  return 0;
+}
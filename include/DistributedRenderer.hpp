@@ -0,0 +1,215 @@
+/**
+ * @file DistributedRenderer.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the RenderCoordinator and RenderWorker classes that
+ * split an offline render across several processes, on one machine or on a
+ * network. The coordinator cuts the frame into tasks (a run of tiles and a
+ * range of samples) and hands them to the workers that connect to it. Every
+ * worker renders its tasks with a HeadlessRenderer and sends back the
+ * compressed linear sums of their pixels. A task of a worker that fails or
+ * stops answering goes back to the queue for another worker. The results are
+ * merged in task order once all of them are in, so the image does not depend
+ * on the number of workers or on which worker rendered what.
+ *
+ * The messages are sent in the byte order of the machine, the coordinator
+ * and the workers must share the same architecture.
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef DISTRIBUTED_RENDERER_HPP
+#define DISTRIBUTED_RENDERER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "HeadlessRenderer.hpp"
+#include "net/socket.hpp"
+
+/**
+ * @brief Everything a worker needs to render the same image as the
+ * coordinator. The scene is rebuilt by every worker from its number (see
+ * make_scene).
+ *
+ */
+struct render_job {
+  int32_t scene = 5;
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t max_depth = 10;
+  int32_t rr_depth = 3;
+  int32_t packet_size = 4;
+  sampler_type sampling = sampler_type::sobol;
+  uint32_t seed = 0;           // See HeadlessRenderer::set_deterministic
+  uint32_t deterministic = 0;  // 1 for reproducible samples
+};
+
+class RenderCoordinator {
+ public:
+  /**
+   * @brief Construct a new RenderCoordinator object
+   *
+   * @param job The image to render, sent to every worker
+   */
+  RenderCoordinator(const render_job& job) : job(job) {}
+
+  /**
+   * @brief Stops listening and waits for the spawned workers, which are
+   * killed if they are still running
+   *
+   */
+  ~RenderCoordinator();
+
+  /**
+   * @brief Set the size of the tasks
+   *
+   * @param tiles Consecutive tiles (16x16 pixels, in scanline order) of a
+   * task
+   * @param samples Samples per pixel of a task, 0 gives every pixel all its
+   * samples in one task
+   */
+  void set_task_size(const size_t tiles, const uint32_t samples);
+
+  /**
+   * @brief Set how long a worker may stay silent before its task is given
+   * to another worker. Also the longest the coordinator waits while no
+   * worker is connected.
+   *
+   * @param seconds The timeout
+   */
+  void set_worker_timeout(const float seconds) { worker_timeout = seconds; }
+
+  /**
+   * @brief Start accepting workers
+   *
+   * @param address "unix:/path" for workers on this machine, "*:port" or
+   * "host:port" for workers on the network
+   * @return true if the coordinator is listening, false otherwise
+   */
+  bool listen(const std::string& address);
+
+  /**
+   * @brief Start worker processes on this machine. They run program with
+   * "--worker ADDRESS --threads THREADS" and connect to the coordinator,
+   * which must already be listening.
+   *
+   * @param program The path of the executable that serves as a worker
+   * @param count The number of processes
+   * @param threads The number of render threads of every process
+   * @return true if every process was started, false otherwise
+   */
+  bool spawn_workers(const char* program, const int count,
+                     const int threads);
+
+  /**
+   * @brief Render the image with the connected workers and merge it into
+   * the accumulation buffer of a renderer, which can then save() it
+   *
+   * @param samples_per_pixel The number of samples of every pixel
+   * @param renderer The renderer that receives the image, of the size of the
+   * job
+   * @return true if every task was rendered, false if the workers were all
+   * gone for longer than the worker timeout
+   */
+  bool render(const uint32_t samples_per_pixel, HeadlessRenderer& renderer);
+
+  size_t get_task_count() const { return tasks.size(); }
+  // Tasks that had to be given to another worker
+  size_t get_reassigned_tasks() const { return reassigned; }
+  // Workers that connected during the last render
+  size_t get_worker_count() const { return workers_seen; }
+  // Size of the results before and after compression
+  size_t get_raw_bytes() const { return raw_bytes; }
+  size_t get_compressed_bytes() const { return compressed_bytes; }
+
+ private:
+  struct render_task {
+    uint32_t first_tile;
+    uint32_t tile_count;
+    uint32_t first_sample;
+    uint32_t samples;
+  };
+
+  render_job job;
+  size_t tiles_per_task = 16;
+  uint32_t samples_per_task = 0;
+  float worker_timeout = 60;
+  socket_listener listener;
+  std::vector<int> processes;  // The spawned workers
+
+  std::vector<render_task> tasks;
+  std::vector<size_t> pixel_counts;          // Pixels of every task
+  std::vector<std::vector<uint32_t>> results;  // Decoded, per task
+
+  // Shared with the threads that talk to the workers
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<size_t> pending;  // Tasks waiting for a worker
+  size_t remaining = 0;        // Tasks without a result
+  bool aborted = false;
+  std::atomic<int> connected{0};
+  std::atomic<size_t> reassigned{0};
+  std::atomic<size_t> raw_bytes{0};
+  std::atomic<size_t> compressed_bytes{0};
+  size_t workers_seen = 0;
+
+  /**
+   * @brief Hand out tasks to one worker until there are none left or the
+   * worker fails. Runs on its own thread.
+   *
+   * @param connection The connection to the worker
+   */
+  void serve(socket_connection connection);
+
+  // Wait for a task, false once every task has a result
+  bool take_task(size_t& index);
+  void give_back(const size_t index);
+  void finish(const size_t index, std::vector<uint32_t>&& result);
+
+  // Wait for the spawned workers, killing them if kill is true
+  void stop_workers(const bool kill);
+};
+
+class RenderWorker {
+ public:
+  /**
+   * @brief Set the number of threads used to render the tasks
+   *
+   * @param threads The number of threads, 0 keeps the OpenMP default
+   */
+  void set_threads(const int threads) { this->threads = threads; }
+
+  /**
+   * @brief Leave after receiving this many tasks, without answering the
+   * last one, as a worker that crashed would. Used to test the coordinator.
+   *
+   * @param tasks The number of tasks, 0 never leaves
+   */
+  void set_drop_after(const size_t tasks) { drop_after = tasks; }
+
+  /**
+   * @brief Connect to a coordinator and render its tasks until it has no
+   * more
+   *
+   * @param address The address the coordinator listens on
+   * @return true if the coordinator ended the job, false on any error
+   */
+  bool run(const std::string& address);
+
+  // Tasks rendered and sent back by the last run()
+  size_t get_tasks_done() const { return tasks_done; }
+
+ private:
+  int threads = 0;
+  size_t drop_after = 0;
+  size_t tasks_done = 0;
+};
+
+#endif  // DISTRIBUTED_RENDERER_HPP
@@ -0,0 +1,326 @@
+/**
+ * @file HeadlessRenderer.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the HeadlessRenderer class, an offline renderer that
+ * does not open a window and writes the final image to disk
+ * @version 0.1
+ * @date 2024-10-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef HEADLESS_RENDERER_HPP
+#define HEADLESS_RENDERER_HPP
+
+#include "camera.hpp"
+#include "render/accumulation_buffer.hpp"
+#include "render/adaptive_sampling.hpp"
+#include "render/aov_buffer.hpp"
+#include "render/checkpoint_file.hpp"
+#include "render/denoiser.hpp"
+#include "render/feature_buffer.hpp"
+#include "render/tile_scheduler.hpp"
+#include "render/wavefront_integrator.hpp"
+
+class HeadlessRenderer {
+ public:
+  /**
+   * @brief Construct a new HeadlessRenderer object
+   *
+   * @param screen_width The width of the rendered image
+   * @param screen_height The height of the rendered image
+   * @param max_depth The maximum depth of the rays
+   */
+  HeadlessRenderer(const int screen_width, const int screen_height,
+                   const size_t max_depth);
+
+  void set_world(hittable_list* world) { this->world = world; }
+
+  /**
+   * @brief Set the number of threads used to render. Has no effect when the
+   * library is built without OpenMP
+   *
+   * @param threads The number of threads, 0 keeps the OpenMP default
+   */
+  void set_threads(const int threads);
+
+  /**
+   * @brief Set the depth after which paths may be terminated by Russian
+   * roulette
+   *
+   * @param depth The minimum path depth
+   */
+  void set_russian_roulette_depth(const size_t depth) {
+    cam.set_russian_roulette_depth(depth);
+  }
+
+  /**
+   * @brief Set how many neighbouring camera rays are traced together as a
+   * SIMD packet
+   *
+   * @param size 4, 8 or 16, 1 traces every ray on its own
+   */
+  void set_packet_size(const int size) { packet_size = size; }
+
+  /**
+   * @brief Trace the paths with the wavefront integrator instead of one path
+   * at a time. The wavefront integrator advances a large batch of paths one
+   * bounce per stage and sorts them by material before shading.
+   *
+   * @param enabled true to use the wavefront integrator
+   */
+  void set_wavefront(const bool enabled) { use_wavefront = enabled; }
+
+  /**
+   * @brief Choose the pattern of the random numbers of every sample
+   *
+   * @param type Independent random numbers or scrambled Sobol points
+   */
+  void set_sampler(const sampler_type type) {
+    sampling = type;
+    wavefront.set_sampler(type, seed, deterministic);
+  }
+
+  /**
+   * @brief Make every random number of a sample a pure function of (seed,
+   * pixel, sample, dimension), also with the independent sampler. The image
+   * is then bit identical whatever the number of threads and the order in
+   * which they pick the tiles, so two renders only differ where the code
+   * does.
+   *
+   * @param enabled true for reproducible renders
+   * @param seed Gives another, equally reproducible, image
+   */
+  void set_deterministic(const bool enabled, const uint32_t seed = 0) {
+    deterministic = enabled;
+    this->seed = seed;
+    wavefront.set_sampler(sampling, seed, deterministic);
+  }
+
+  /**
+   * @brief Enable adaptive sampling. The samples per pixel given to render()
+   * become an average budget: once a tile has converged it stops receiving
+   * samples and the rest of the budget goes to the noisy tiles.
+   *
+   * @param error_threshold Relative error under which a pixel has converged,
+   * 0 disables adaptive sampling
+   * @param min_samples Samples every pixel gets before it can converge
+   * @param max_samples Upper limit for the samples of a pixel, 0 for none
+   */
+  void set_adaptive(const float error_threshold, const uint32_t min_samples,
+                    const uint32_t max_samples);
+
+  /**
+   * @brief Denoise the image once all samples are in. The albedo, normal and
+   * depth of the first hits are gathered while rendering to guide the
+   * filter.
+   *
+   * @param enabled true to denoise
+   */
+  void set_denoise(const bool enabled) { denoise_enabled = enabled; }
+
+  /**
+   * @brief Choose the extra passes (depth, normals, ids, ...) computed with
+   * the color. They are filled from the first hit of the same samples, the
+   * paths are not traced again. The wavefront integrator does not support
+   * them, the path integrator is used instead when any pass is enabled.
+   *
+   * @param passes The passes to compute, 0 for none
+   */
+  void set_aovs(const aov_set passes);
+
+  /**
+   * @brief Keep the state of the render in a checkpoint file. A render that
+   * finds a checkpoint of the same scene, camera and settings resumes it
+   * instead of starting over, and a checkpoint with fewer samples than asked
+   * for is completed. Not used with adaptive sampling. The passes (AOVs)
+   * only see the samples rendered since the last resume.
+   *
+   * @param path The checkpoint file, empty to disable checkpoints
+   * @param scene_key Identifies the scene (e.g. its make_scene number), the
+   * checkpoint of another scene is not resumed
+   * @param interval_seconds Wall time between two saves
+   */
+  void set_checkpoint(const std::string& path, const uint64_t scene_key,
+                      const float interval_seconds);
+
+  /**
+   * @brief Render the whole image as fast as possible, without any frame
+   * pacing
+   *
+   * @param samples_per_pixel The number of rays sent through every pixel (on
+   * average when adaptive sampling is enabled)
+   */
+  void render(const int samples_per_pixel);
+
+  /**
+   * @brief Render a part of the image only, for example the share of a
+   * worker of a distributed render (see DistributedRenderer.hpp). The samples
+   * are numbered from first_sample, so that the passes of several calls
+   * (or several processes) add up to the samples of a single render().
+   * Always uses the path integrator.
+   *
+   * @param first_tile The index of the first tile of the scheduler to render
+   * @param tile_count The number of consecutive tiles to render
+   * @param first_sample The number of the first sample of every pixel
+   * @param samples_per_pixel The number of samples of every pixel
+   */
+  void render_tiles(const size_t first_tile, const size_t tile_count,
+                    const uint32_t first_sample,
+                    const uint32_t samples_per_pixel);
+
+  /**
+   * @brief Choose how the linear radiance is mapped to the output image
+   *
+   * @param op The tonemapping operator
+   */
+  void set_tonemap(const tonemap_operator op) { accum.set_tonemap(op); }
+
+  /**
+   * @brief Write the rendered image to disk. The format is deduced from the
+   * file extension (png, bmp, tga, ...)
+   *
+   * @param filename The path of the output image
+   * @return true if the image was written, false otherwise
+   */
+  bool save(const char* filename);
+
+  /**
+   * @brief Write a heatmap of where the samples were spent to disk
+   *
+   * @param filename The path of the output image
+   * @return true if the image was written, false otherwise
+   */
+  bool save_heatmap(const char* filename);
+
+  /**
+   * @brief Write the extra passes of the last render to disk
+   *
+   * @param prefix The path of the files without the extension, the name of
+   * every pass is appended to it
+   * @param extension "pfm" for the raw values, or an image format
+   * @return true if all the passes were written, false otherwise
+   */
+  bool save_aovs(const std::string& prefix, const std::string& extension) {
+    return aovs.save_all(prefix, extension);
+  }
+
+  // The linear samples of the last render, and how the image is split
+  accumulation_buffer& get_accumulation() { return accum; }
+  const tile_scheduler& get_scheduler() const { return scheduler; }
+
+  /**
+   * @brief Wall time of the last call to render()
+   *
+   * @return float The duration in seconds
+   */
+  float get_render_duration() const { return render_duration; }
+
+  /**
+   * @brief Samples per pixel read from the checkpoint by the last call to
+   * render()
+   *
+   * @return uint32_t The samples, 0 if the render started over
+   */
+  uint32_t get_resumed_samples() const { return resumed_samples; }
+
+  /**
+   * @brief Wall time of the denoiser in the last call to render()
+   *
+   * @return float The duration in seconds, 0 without denoising
+   */
+  float get_denoise_duration() const { return denoise_duration; }
+
+  /**
+   * @brief Number of camera rays sent by the last call to render()
+   *
+   * @return size_t The number of rays
+   */
+  size_t get_rays_sent() const { return rays_sent; }
+
+  /**
+   * @brief Number of rays traced by the last call to render(), counting the
+   * camera rays and every bounce
+   *
+   * @return size_t The number of rays
+   */
+  size_t get_rays_traced() const { return rays_traced; }
+
+  /**
+   * @brief Average number of rays per path in the last call to render()
+   *
+   * @return float The average path length
+   */
+  float get_average_path_length() const;
+
+  /**
+   * @brief Throughput of the last call to render()
+   *
+   * @return float Millions of traced rays (including bounces) per second
+   */
+  float get_mrays_per_second() const;
+
+ private:
+  const int screen_width;     // The dimensions of the image
+  const int screen_height;    // The dimensions of the image
+  hittable_list* world;       // The world that we are going to render
+  camera cam;                 // The camera object
+  tile_scheduler scheduler;   // Splits the image into tiles for the threads
+  adaptive_sampling adaptive;  // Decides which tiles still need samples
+  bool adaptive_enabled = false;
+  int packet_size = 4;        // Camera rays traced together
+  bool use_wavefront = false;  // Trace with the wavefront integrator
+  sampler_type sampling = sampler_type::sobol;  // Pattern of the samples
+  uint32_t sample_offset = 0;  // Number of the first sample, see render_tiles
+  uint32_t seed = 0;           // Of the samplers
+  bool deterministic = false;  // See set_deterministic
+  wavefront_integrator wavefront;
+  accumulation_buffer accum;  // The linear sum of the samples of every pixel
+  std::vector<Color> pixels;  // The final (tonemapped) image
+  bool denoise_enabled = false;
+  feature_buffer features;    // First hits of the samples, for the denoiser
+  aov_buffer aovs;            // The extra passes, empty unless enabled
+  denoiser filter;
+  std::string checkpoint_path;  // Empty without checkpoints
+  uint64_t checkpoint_scene = 0;
+  float checkpoint_interval = 60;
+  uint32_t resumed_samples = 0;
+
+  float render_duration = 0;  // Wall time of the last render
+  float denoise_duration = 0;  // Part of the render spent denoising
+  size_t rays_sent = 0;       // Camera rays sent in the last render
+  size_t rays_traced = 0;     // All rays traced in the last render
+
+  /**
+   * @brief Send samples_per_pixel samples through every pixel of the first
+   * active tiles of the scheduler
+   *
+   * @param samples_per_pixel The number of samples of every pixel
+   * @param tiles The number of active tiles to render
+   */
+  void render_pass(const uint32_t samples_per_pixel, const size_t tiles);
+
+  /**
+   * @brief Same as render_pass, but traces the samples with the wavefront
+   * integrator
+   *
+   * @param samples_per_pixel The number of samples of every pixel
+   * @param tiles The number of active tiles to render
+   */
+  void render_pass_wavefront(const uint32_t samples_per_pixel,
+                             const size_t tiles);
+
+  /**
+   * @brief Render every pixel up to samples_per_pixel samples in short
+   * passes, starting from the checkpoint and saving to it regularly
+   *
+   * @param samples_per_pixel The number of samples of every pixel
+   */
+  void render_with_checkpoint(const uint32_t samples_per_pixel);
+
+  // Hash of what decides the converged image, see checkpoint_file
+  uint64_t checkpoint_config_hash();
+};
+
+#endif  // HEADLESS_RENDERER_HPP
@@ -12,10 +12,9 @@
 #ifndef WINDOW_HPP
 #define WINDOW_HPP
 
-#include <omp.h>
-
 #include "camera.hpp"
 #include "objects/bvh.hpp"
+#include "render/render_engine.hpp"
 
 class RaytraceWindow {
  public:
@@ -28,26 +27,24 @@ class RaytraceWindow {
   void set_world(hittable_list* world) { this->world = world; }
 
  private:
-  int current_renders = 0;
-  int max_renders = 100;
   uint target_fps = 30;
-  int start_index = 0;  // The starting index for the next selection (when
-                        // selecting random colors)
+  tile_order order = tile_order::spiral;  // Tile order of the engine
+  bool show_heatmap = false;  // Show where the samples were spent
+  bool show_stats = false;    // Show the render statistics
+  bool denoise = false;       // Filter the image after every batch
+  float frame_time = 0;       // Wall time of the last UI frame
 
   const int screen_width;     // The dimensions of the window
   const int screen_height;    // The dimensions of the window
   hittable_list* world;       // The world that we are going to draw
-  camera cam;                 // The camera object
-  std::vector<Color> pixels;  // The array of pixels that we are going to draw
+  camera cam;                 // The camera driven by the input
+  render_engine engine;       // Traces the image on a background thread
   Texture2D texture;  // The texture that we are going to draw (DrawPixel method
                       // is not efficient for large images)
-
-  std::vector<int> shuffled_index_array;  // An array of shuffled indices
+  std::vector<Color> staging;  // The pixels of the tile being uploaded
 
   void draw_pixels();
-  void reset_pixels();
-  float get_ray_random_duration();
-  void shuffle_indices(std::vector<int>& indices, int start_index);
+  void draw_stats();
 };
 
 #endif  // WINDOW_HPP
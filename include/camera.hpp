@@ -13,6 +13,7 @@
 #define CAMERA_H
 
 #include "objects/hittable_list.hpp"
+#include "render/feature_buffer.hpp"
 
 Color vec3_to_color(const vec3& v);
 
@@ -54,11 +55,38 @@ class camera {
    * @param pixel_height The "index" of the pixel on the y-axis. The value
    * should be between 0 and screen_height but can be a floating point number as
    * we are using anti-aliasing.
+   * @param s The sampler of the sample, already started on the pixel and past
+   * the pixel jitter
+   * @param path_length If not null, receives the number of rays traced for
+   * this sample (the camera ray and all its bounces)
+   * @param features If not null, receives the first hit of the sample
    *
    * @return vec3 The color of the pixel that the ray intersects with
    */
   vec3 send_ray(hittable_list* world, const float pixel_width,
-                const float pixel_height);
+                const float pixel_height, sampler& s,
+                size_t* path_length = nullptr,
+                pixel_features* features = nullptr);
+
+  /**
+   * @brief Function that sends the rays of several neighbouring pixels as one
+   * packet. The first hit of the packet is found with SIMD box tests, then
+   * every path is continued on its own.
+   *
+   * @param world The list of objects in the scene
+   * @param pixel_width The "index" of every pixel on the x-axis
+   * @param pixel_height The "index" of every pixel on the y-axis
+   * @param count The number of pixels, at most ray_packet::max_size
+   * @param samplers The sampler of every pixel, see send_ray
+   * @param colors Receives the color of every pixel
+   * @param path_lengths If not null, receives the path length of every pixel
+   * @param features If not null, receives the first hit of every pixel
+   */
+  void send_packet(hittable_list* world, const float* pixel_width,
+                   const float* pixel_height, const int count,
+                   sampler* samplers, vec3* colors,
+                   size_t* path_lengths = nullptr,
+                   pixel_features* features = nullptr);
 
   float aspect_ratio = 1.0;  // Ratio of image width over height
   int screen_width = 100;    // Rendered image width in pixel count
@@ -73,9 +101,103 @@ class camera {
    */
   bool update_state(float dt);
 
+  /**
+   * @brief Set the depth after which paths are terminated by Russian
+   * roulette. Paths shorter than this are never cut off.
+   *
+   * @param depth The minimum depth, max_depth disables Russian roulette
+   */
+  void set_russian_roulette_depth(const size_t depth) { rr_min_depth = depth; }
+
+  void set_max_depth(const size_t depth) { max_depth = depth; }
+  size_t get_max_depth() const { return max_depth; }
+  size_t get_russian_roulette_depth() const { return rr_min_depth; }
+
+  /**
+   * @brief Function that generates the camera ray through a point of the
+   * screen
+   *
+   * @param pixel_width The "index" of the pixel on the x-axis
+   * @param pixel_height The "index" of the pixel on the y-axis
+   * @param s The sampler of the sample, picks the point on the lens
+   * @return ray The camera ray
+   */
+  ray get_ray(const float pixel_width, const float pixel_height,
+              sampler& s) const;
+
+  const vec3& get_position() const { return camera_position; }
+
+  /**
+   * @brief Move the camera without turning it
+   *
+   * @param position The new camera center
+   */
+  void set_position(const vec3& position) {
+    look_at_point += position - camera_position;
+    camera_position = position;
+    initialize();
+  }
+
+  /**
+   * @brief Find the point of the screen that sees a direction, the inverse of
+   * get_ray (without the defocus blur)
+   *
+   * @param direction A direction leaving the camera position
+   * @param pixel_width Receives the "index" of the pixel on the x-axis
+   * @param pixel_height Receives the "index" of the pixel on the y-axis
+   * @return true if the direction is inside the field of view
+   */
+  bool project_direction(const vec3& direction, float& pixel_width,
+                         float& pixel_height) const;
+
+  /**
+   * @brief Find the point of the screen that sees a point of the scene
+   *
+   * @param point The point in world space
+   * @param pixel_width Receives the "index" of the pixel on the x-axis
+   * @param pixel_height Receives the "index" of the pixel on the y-axis
+   * @return true if the point is inside the field of view
+   */
+  bool project(const vec3& point, float& pixel_width,
+               float& pixel_height) const {
+    return project_direction(point - camera_position, pixel_width,
+                             pixel_height);
+  }
+
+  /**
+   * @brief The color of the sky seen by a ray that escapes the scene
+   *
+   */
+  static vec3 background(const ray& r);
+
+  /**
+   * @brief The features of the first hit of a camera ray
+   *
+   * @param r The camera ray
+   * @param hit Whether the ray hit anything
+   * @param rec The closest hit of the ray, if any
+   * @return pixel_features The albedo, normal and depth of the hit
+   */
+  static pixel_features first_hit_features(const ray& r, const bool hit,
+                                           const hit_record& rec);
+
+  /**
+   * @brief Russian roulette: past the minimum depth, a path continues with a
+   * probability equal to its throughput and the survivors are boosted so
+   * that the estimate stays unbiased
+   *
+   * @param throughput The throughput of the path, boosted if it survives
+   * @param depth The number of rays traced so far
+   * @param s The sampler of the path
+   * @return true if the path continues, false if it is terminated
+   */
+  bool russian_roulette(vec3& throughput, const size_t depth,
+                        sampler& s) const;
+
  private:
   int screen_height;  // Rendered image height
   size_t max_depth;   // Maximum depth of the ray
+  size_t rr_min_depth = 3;  // Depth at which Russian roulette starts
 
   vec3 pixel00_loc;    // Location of pixel 0, 0
   vec3 pixel_delta_u;  // Offset to pixel to the right
@@ -108,16 +230,36 @@ class camera {
 
   /**
    * @brief Function that takes a ray as input and returns the color of the
-   * pixel that the ray intersects with. The function is recursive and will
-   * continue to call itself until the maximum depth is reached.
+   * pixel that the ray intersects with.
    *
    * @param r The ray to trace
    * @param world The list of objects in the scene
-   * @param depth The current depth of the ray
+   * @param s The sampler of the path
+   * @param path_length Receives the number of rays traced
+   * @param features If not null, receives the first hit of the ray
    *
    * @return vec3 The color of the pixel that the ray intersects with
    */
-  vec3 ray_color(ray& r, hittable_list* world, const size_t depth = 1);
+  vec3 ray_color(const ray& r, hittable_list* world, sampler& s,
+                 size_t& path_length, pixel_features* features) const;
+
+  /**
+   * @brief Function that follows a path whose first intersection is already
+   * known. The path is followed in a loop that carries the throughput of the
+   * path until it escapes, is absorbed, reaches the maximum depth or is
+   * terminated by Russian roulette.
+   *
+   * @param r The first ray of the path
+   * @param hit Whether the first ray hit anything
+   * @param rec The closest hit of the first ray, if any
+   * @param world The list of objects in the scene
+   * @param s The sampler of the path
+   * @param path_length Receives the number of rays traced
+   *
+   * @return vec3 The color carried by the path
+   */
+  vec3 continue_path(ray r, bool hit, hit_record rec, hittable_list* world,
+                     sampler& s, size_t& path_length) const;
 
   /**
    * @brief Function that updates the camera's orientation based on the
@@ -131,9 +273,10 @@ class camera {
    * @brief Function that returns a random point on the defocus disk. The
    * function is used to simulate the defocus effect of the camera.
    *
+   * @param s The sampler that picks the point
    * @return vec3 The random point on the defocus disk
    */
-  vec3 defocus_disk_sample() const;
+  vec3 defocus_disk_sample(sampler& s) const;
 };
 
 #endif
@@ -26,13 +26,25 @@ class material {
    * @param rec  The hit record
    * @param attenuation  The attenuation of the ray
    * @param scattered  The scattered ray
+   * @param s  The sampler of the path, at most three dimensions are drawn
    * @return true  If the ray scatters
    * @return false  If the ray does not scatter
    */
   virtual bool scatter(ray& r_in, const hit_record& rec, vec3& attenuation,
-                       ray& scattered) const {
+                       ray& scattered, sampler& s) const {
     return false;
   }
+
+  /**
+   * @brief The color of the surface, without any lighting. Used as a guide
+   * by the denoiser.
+   *
+   * @param rec  The hit record
+   * @return vec3  The albedo at the hit point
+   */
+  virtual vec3 albedo(const hit_record& rec) const {
+    return vec3(1.0f, 1.0f, 1.0f);
+  }
 };
 
 /**
@@ -45,8 +57,10 @@ class lambertian : public material {
   lambertian(shared_ptr<texture> tex) : tex(tex) {}
 
   bool scatter(ray& r_in, const hit_record& rec, vec3& attenuation,
-               ray& scattered) const override {
-    vec3 scatter_direction = rec.normal + random_unit_vector();
+               ray& scattered, sampler& s) const override {
+    float u1, u2;
+    s.get_2d(u1, u2);
+    vec3 scatter_direction = rec.normal + sample_unit_vector(u1, u2);
 
     if (scatter_direction.near_zero()) scatter_direction = rec.normal;
 
@@ -55,6 +69,10 @@ class lambertian : public material {
     return true;
   }
 
+  vec3 albedo(const hit_record& rec) const override {
+    return tex->value(rec.u, rec.v, rec.p);
+  }
+
  private:
   shared_ptr<texture> tex;
 };
@@ -73,17 +91,19 @@ class metal : public material {
    * reflected rays
    */
   metal(const vec3& albedo, const float& fuzz = 0)
-      : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
+      : albedo_color(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
 
   bool scatter(ray& r_in, const hit_record& rec, vec3& attenuation,
-               ray& scattered) const override {
-    scattered = r_in.reflect(rec.normal, rec.p, fuzz);
-    attenuation = albedo;
+               ray& scattered, sampler& s) const override {
+    scattered = r_in.reflect(rec.normal, rec.p, fuzz, s);
+    attenuation = albedo_color;
     return dot(scattered.direction(), rec.normal) > 0;
   }
 
+  vec3 albedo(const hit_record& rec) const override { return albedo_color; }
+
  private:
-  vec3 albedo;
+  vec3 albedo_color;
   float fuzz;
 };
 
@@ -101,11 +121,11 @@ class dielectric : public material {
   dielectric(float refraction_index) : refraction_index(refraction_index) {}
 
   bool scatter(ray& r_in, const hit_record& rec, vec3& attenuation,
-               ray& scattered) const override {
+               ray& scattered, sampler& s) const override {
     attenuation = vec3(1.0f, 1.0f, 1.0f);
     float ri = rec.front_face ? (1.0f / refraction_index) : refraction_index;
 
-    scattered = r_in.refract(rec.normal, rec.p, ri);
+    scattered = r_in.refract(rec.normal, rec.p, ri, s);
     return true;
   }
 
@@ -0,0 +1,144 @@
+/**
+ * @file rng.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the rng class, a small xoshiro128+ pseudo random
+ * number generator. Every thread owns its own generator (see thread_rng()),
+ * so the render threads never share any random state.
+ * @version 0.1
+ * @date 2024-11-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef RNG_HPP
+#define RNG_HPP
+
+#include <atomic>
+#include <cstdint>
+
+class rng {
+ public:
+  /**
+   * @brief Construct a new rng object
+   *
+   * @param seed Any value, generators built from different seeds produce
+   * independent streams
+   */
+  explicit rng(const uint64_t seed = 0) { set_seed(seed); }
+
+  /**
+   * @brief Restart the generator from the given seed
+   *
+   * @param seed The new seed
+   */
+  void set_seed(uint64_t seed) {
+    // Spread the seed over the whole state with splitmix64, xoshiro must not
+    // start from an all zero state
+    for (int i = 0; i < 2; i++) {
+      const uint64_t z = splitmix64(seed);
+      state[2 * i] = (uint32_t)z;
+      state[2 * i + 1] = (uint32_t)(z >> 32);
+    }
+  }
+
+  /**
+   * @brief Get the next 32 random bits
+   *
+   * @return uint32_t Uniformly distributed bits
+   */
+  uint32_t next_uint() {
+    const uint32_t result = state[0] + state[3];
+    const uint32_t t = state[1] << 9;
+
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = (state[3] << 11) | (state[3] >> 21);
+
+    return result;
+  }
+
+  /**
+   * @brief Get a random float in [0, 1) with the full 24 bit resolution of
+   * the mantissa
+   *
+   * @return float The random value
+   */
+  float next_float() { return (next_uint() >> 8) * (1.0f / 16777216.0f); }
+
+  /**
+   * @brief Get a random integer in [0, range) without a division
+   *
+   * @param range The number of possible values
+   * @return uint32_t The random value
+   */
+  uint32_t next_uint(const uint32_t range) {
+    return (uint32_t)(((uint64_t)next_uint() * range) >> 32);
+  }
+
+  static uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+ private:
+  uint32_t state[4];
+};
+
+// The seed shared by all the thread generators. The generation is bumped
+// every time the seed changes, the thread generators compare it with the
+// generation they were seeded for and reseed themselves lazily.
+struct rng_seed {
+  std::atomic<uint64_t> seed{0x853C49E6748FEA9Bull};
+  std::atomic<uint32_t> generation{0};
+  std::atomic<uint32_t> thread_count{0};
+
+  static rng_seed& get() {
+    static rng_seed global;
+    return global;
+  }
+};
+
+/**
+ * @brief Reseed the generators of all threads. Every thread gets its own
+ * stream derived from the seed and the order in which the threads first drew
+ * a number.
+ *
+ * @param seed The global seed
+ */
+inline void set_random_seed(const uint64_t seed) {
+  rng_seed::get().seed = seed;
+  rng_seed::get().generation++;
+}
+
+/**
+ * @brief Get the generator of the calling thread
+ *
+ * @return rng& The generator, only to be used by the calling thread
+ */
+inline rng& thread_rng() {
+  struct thread_state {
+    rng generator;
+    uint32_t index = rng_seed::get().thread_count++;
+    uint32_t generation = ~0u;
+  };
+  thread_local thread_state local;
+
+  const rng_seed& global = rng_seed::get();
+  const uint32_t generation =
+      global.generation.load(std::memory_order_relaxed);
+  if (local.generation != generation) {
+    local.generation = generation;
+    local.generator.set_seed(global.seed.load() ^
+                             ((uint64_t)local.index << 32));
+  }
+
+  return local.generator;
+}
+
+#endif  // RNG_HPP
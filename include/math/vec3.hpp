@@ -194,4 +194,25 @@ inline vec3 random_in_unit_disk() {
   }
 }
 
+// The functions below map uniform numbers in [0,1) (e.g. from a sampler) to
+// the same distributions as the random_* functions above, without rejection
+// so that stratified numbers stay stratified.
+
+inline vec3 sample_unit_vector(float u1, float u2) {
+  const float z = 1 - 2 * u1;
+  const float r = sqrtf(std::max(0.0f, 1 - z * z));
+  const float phi = 2 * M_PI * u2;
+  return vec3(r * cosf(phi), r * sinf(phi), z);
+}
+
+inline vec3 sample_in_unit_sphere(float u1, float u2, float u3) {
+  return sample_unit_vector(u1, u2) * cbrtf(u3);
+}
+
+inline vec3 sample_in_unit_disk(float u1, float u2) {
+  const float r = sqrtf(u1);
+  const float phi = 2 * M_PI * u2;
+  return vec3(r * cosf(phi), r * sinf(phi), 0);
+}
+
 #endif  // VEC3_HPP
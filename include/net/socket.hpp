@@ -0,0 +1,108 @@
+/**
+ * @file socket.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the socket_connection and socket_listener classes,
+ * thin blocking wrappers around Unix domain and TCP sockets. An address is
+ * either "unix:/path/to/socket" or "host:port" ("*:port" listens on every
+ * interface). Only POSIX systems are supported, on other systems every call
+ * fails.
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SOCKET_HPP
+#define SOCKET_HPP
+
+#include <cstddef>
+#include <string>
+
+class socket_connection {
+ public:
+  socket_connection() {}
+  explicit socket_connection(const int descriptor) : descriptor(descriptor) {}
+  ~socket_connection() { close(); }
+
+  // A connection is owned by one object only
+  socket_connection(const socket_connection&) = delete;
+  socket_connection& operator=(const socket_connection&) = delete;
+  socket_connection(socket_connection&& other) noexcept;
+  socket_connection& operator=(socket_connection&& other) noexcept;
+
+  /**
+   * @brief Connect to a listening socket
+   *
+   * @param address "unix:/path" or "host:port"
+   * @return true if the connection is open, false otherwise
+   */
+  bool connect(const std::string& address);
+
+  /**
+   * @brief Give up on a send or receive that makes no progress for a while
+   *
+   * @param seconds The timeout, 0 waits forever
+   * @return true if the timeout was set, false otherwise
+   */
+  bool set_timeout(const float seconds);
+
+  /**
+   * @brief Send the whole buffer, blocking until it is written
+   *
+   * @return true if every byte was sent, false if the connection broke
+   */
+  bool send_all(const void* data, const size_t size);
+
+  /**
+   * @brief Receive exactly size bytes, blocking until they arrive
+   *
+   * @return true if every byte was received, false if the connection was
+   * closed, broke or timed out
+   */
+  bool receive_all(void* data, const size_t size);
+
+  bool is_open() const { return descriptor >= 0; }
+  void close();
+
+ private:
+  int descriptor = -1;
+};
+
+class socket_listener {
+ public:
+  socket_listener() {}
+  ~socket_listener() { close(); }
+
+  socket_listener(const socket_listener&) = delete;
+  socket_listener& operator=(const socket_listener&) = delete;
+
+  /**
+   * @brief Start listening for connections. A Unix socket file left over by
+   * a previous run is replaced, and removed again by close().
+   *
+   * @param address "unix:/path", "host:port" or "*:port"
+   * @return true if the socket is listening, false otherwise
+   */
+  bool listen(const std::string& address);
+
+  /**
+   * @brief Wait for the next connection
+   *
+   * @param connection Receives the connection
+   * @param timeout_ms How long to wait, negative waits forever
+   * @return true if a connection was accepted, false on timeout or error
+   */
+  bool accept(socket_connection& connection, const int timeout_ms);
+
+  bool is_open() const { return descriptor >= 0; }
+  const std::string& get_address() const { return address; }
+  void close();
+
+ private:
+  int descriptor = -1;
+  std::string address;
+  std::string unix_path;  // The socket file to remove, if any
+};
+
+#endif  // SOCKET_HPP
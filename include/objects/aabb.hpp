@@ -18,6 +18,7 @@
 #include "math/interval.hpp"
 #include "math/vec3.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 
 class aabb {
  public:
@@ -54,29 +55,51 @@ class aabb {
   }
 
   bool hit(const ray& r, interval ray_t) const {
-    const vec3& ray_orig = r.origin();
-    const vec3& ray_dir = r.direction();
+    // Branchless slab test. The sign of the direction picks the near and the
+    // far plane of every slab. A ray in the plane of a slab (0 times an
+    // infinite inverse) gives a NaN, which the comparisons ignore, so the ray
+    // counts as inside that slab.
+    const vec3& origin = r.origin();
+    const vec3& inv_dir = r.inv_direction();
+    const float planes[3][2] = {
+        {x.min, x.max}, {y.min, y.max}, {z.min, z.max}};
 
     for (int axis = 0; axis < 3; axis++) {
-      const interval& ax = axis_interval(axis);
-      const float adinv = 1.0f / ray_dir[axis];
-
-      auto t0 = (ax.min - ray_orig[axis]) * adinv;
-      auto t1 = (ax.max - ray_orig[axis]) * adinv;
-
-      if (t0 < t1) {
-        if (t0 > ray_t.min) ray_t.min = t0;
-        if (t1 < ray_t.max) ray_t.max = t1;
-      } else {
-        if (t1 > ray_t.min) ray_t.min = t1;
-        if (t0 < ray_t.max) ray_t.max = t0;
-      }
-
-      if (ray_t.max <= ray_t.min) return false;
+      const int negative = r.is_negative(axis);
+      const float t_near =
+          (planes[axis][negative] - origin[axis]) * inv_dir[axis];
+      const float t_far =
+          (planes[axis][1 - negative] - origin[axis]) * inv_dir[axis];
+      ray_t.min = t_near > ray_t.min ? t_near : ray_t.min;
+      ray_t.max = t_far < ray_t.max ? t_far : ray_t.max;
     }
-    return true;
+    return ray_t.min < ray_t.max;
   }
 
+  /**
+   * @brief Test several rays of a packet against the box at once, using SSE
+   * (4 rays per step) or AVX (8 rays per step) when available. Like hit(),
+   * the planes are picked by the sign of every ray and the NaNs are ignored.
+   *
+   * @param packet The rays, t_max limits the interval of every ray
+   * @param mask The rays to test (one bit per ray)
+   * @param t_min The start of the interval of every ray
+   * @return uint32_t The mask of the tested rays that hit the box
+   */
+  uint32_t hit_packet(const ray_packet& packet, const uint32_t mask,
+                      const float t_min) const;
+
+  /**
+   * @brief The same packet test for a box given by its corners, used by the
+   * flattened BVH whose nodes do not hold an aabb
+   *
+   * @param box_min The lowest corner of the box (x, y, z)
+   * @param box_max The highest corner of the box (x, y, z)
+   */
+  static uint32_t hit_packet(const float box_min[3], const float box_max[3],
+                             const ray_packet& packet, const uint32_t mask,
+                             const float t_min);
+
   int longest_axis() const {
     // Returns the index of the longest axis of the bounding box.
 
@@ -13,11 +13,61 @@
 #define BVH_HPP
 
 #include <algorithm>
+#include <atomic>
+#include <bitset>
 
 #include "aabb.hpp"
 #include "hittable.hpp"
 #include "hittable_list.hpp"
 
+/**
+ * @brief The number of BVH nodes the rays of the calling thread visited,
+ * while bvh_counts_visits() is on. Only ever incremented; read it before and
+ * after tracing to count the nodes of a path.
+ *
+ * @return size_t& The counter of the calling thread
+ */
+inline size_t& bvh_visit_counter() {
+  thread_local size_t visits = 0;
+  return visits;
+}
+
+/**
+ * @brief The BVH nodes each ray of a packet visited, while
+ * bvh_counts_visits() is on. The packet traversals credit every ray of the
+ * mask they test against a node, the caller clears the counts of the packet
+ * before tracing it.
+ *
+ * @return size_t* The counters of the calling thread, one per ray
+ */
+inline size_t* bvh_ray_visit_counters() {
+  thread_local size_t visits[ray_packet::max_size] = {};
+  return visits;
+}
+
+/**
+ * @brief Count the visit of a node by the rays of a packet, in the counter
+ * of the thread and in the counter of every ray of the mask
+ *
+ */
+inline void count_packet_visit(uint32_t mask) {
+  bvh_visit_counter() += std::bitset<32>(mask).count();
+  size_t* rays = bvh_ray_visit_counters();
+  for (; mask; mask &= mask - 1) rays[ray_packet::first_ray(mask)]++;
+}
+
+/**
+ * @brief Whether the trees (bvh_node, linear_bvh and bvh4) count their node
+ * visits. Off by default, so that the traversals do not pay for a count
+ * nobody reads; a renderer turns it on while it computes render passes.
+ *
+ * @return std::atomic<bool>& The switch shared by all the threads
+ */
+inline std::atomic<bool>& bvh_counts_visits() {
+  static std::atomic<bool> enabled(false);
+  return enabled;
+}
+
 class bvh_node : public hittable {
  public:
   bvh_node(hittable_list list)
@@ -61,6 +111,7 @@ class bvh_node : public hittable {
 
   bool hit(const ray& r, const interval& ray_t,
            hit_record& rec) const override {
+    if (bvh_counts_visits()) bvh_visit_counter()++;
     if (!bbox.hit(r, ray_t)) return false;
 
     bool hit_left = left->hit(r, ray_t, rec);
@@ -70,14 +121,41 @@ class bvh_node : public hittable {
     return hit_left || hit_right;
   }
 
+  uint32_t hit_packet(ray_packet& packet, uint32_t mask, const float t_min,
+                      hit_record* recs) const override {
+    const bool count_visits = bvh_counts_visits();
+    if (count_visits) count_packet_visit(mask);
+    mask = bbox.hit_packet(packet, mask, t_min);
+    if (!mask) return 0;
+
+    // Once the packet has diverged down to a single ray, trace it on its own
+    if (!(mask & (mask - 1))) {
+      const size_t visits = bvh_visit_counter();
+      const uint32_t hits = hittable::hit_packet(packet, mask, t_min, recs);
+      if (count_visits)
+        bvh_ray_visit_counters()[ray_packet::first_ray(mask)] +=
+            bvh_visit_counter() - visits;
+      return hits;
+    }
+
+    uint32_t hits = left->hit_packet(packet, mask, t_min, recs);
+    if (right != left) hits |= right->hit_packet(packet, mask, t_min, recs);
+    return hits;
+  }
+
   aabb bounding_box() const override { return bbox; }
 
   void move(const vec3& offset) override {
-    // TODO: Implement movement for BVH nodes.
+    // A node of one object holds it on both sides
+    left->move(offset);
+    if (right != left) right->move(offset);
+    bbox = aabb(left->bounding_box(), right->bounding_box());
   }
 
   void rotate(const vec3& axis, float angle) override {
-    // TODO: Implement rotation for BVH nodes.
+    left->rotate(axis, angle);
+    if (right != left) right->rotate(axis, angle);
+    bbox = aabb(left->bounding_box(), right->bounding_box());
   }
 
  private:
@@ -85,25 +163,25 @@ class bvh_node : public hittable {
   shared_ptr<hittable> right;
   aabb bbox;
 
-  static bool box_compare(const shared_ptr<hittable> a,
-                          const shared_ptr<hittable> b, int axis_index) {
+  static bool box_compare(const shared_ptr<hittable>& a,
+                          const shared_ptr<hittable>& b, int axis_index) {
     auto a_axis_interval = a->bounding_box().axis_interval(axis_index);
     auto b_axis_interval = b->bounding_box().axis_interval(axis_index);
     return a_axis_interval.min < b_axis_interval.min;
   }
 
-  static bool box_x_compare(const shared_ptr<hittable> a,
-                            const shared_ptr<hittable> b) {
+  static bool box_x_compare(const shared_ptr<hittable>& a,
+                            const shared_ptr<hittable>& b) {
     return box_compare(a, b, 0);
   }
 
-  static bool box_y_compare(const shared_ptr<hittable> a,
-                            const shared_ptr<hittable> b) {
+  static bool box_y_compare(const shared_ptr<hittable>& a,
+                            const shared_ptr<hittable>& b) {
     return box_compare(a, b, 1);
   }
 
-  static bool box_z_compare(const shared_ptr<hittable> a,
-                            const shared_ptr<hittable> b) {
+  static bool box_z_compare(const shared_ptr<hittable>& a,
+                            const shared_ptr<hittable>& b) {
     return box_compare(a, b, 2);
   }
 };
@@ -0,0 +1,153 @@
+/**
+ * @file bvh4.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the bvh4 class, a Bounding Volume Hierarchy with up to
+ * four children per node. It is collapsed from a binary linear_bvh: a node
+ * takes the grandchildren of its largest inner children until it has four.
+ * The bounds of the children are stored as a structure of arrays, so a ray is
+ * tested against all of them with one SSE slab test, and the children it hits
+ * are visited from the nearest to the farthest. Moved objects are handled as
+ * in the linear_bvh, by refitting the boxes above them.
+ * @version 0.1
+ * @date 2024-12-06
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef BVH4_HPP
+#define BVH4_HPP
+
+#include "linear_bvh.hpp"
+
+/**
+ * @brief A node of the wide tree, two cache lines
+ *
+ */
+struct alignas(64) bvh4_node {
+  static const int width = 4;
+
+  // Per axis, then per child, one SSE register each
+  float bounds_min[3][width];
+  float bounds_max[3][width];
+  // A node index, or the first primitive of a leaf child
+  uint32_t child[width];
+  uint16_t count[width];  // Primitives of a leaf child, 0 for a node
+  uint32_t child_count;   // The children in use, the first ones
+};
+
+class bvh4 : public hittable {
+ public:
+  // Entries of the traversal stack, a node pushes at most three more than it
+  // pops and the collapsed tree is no deeper than the binary one
+  static const int max_stack = 3 * linear_bvh::max_depth + 1;
+
+  /**
+   * @brief Build the tree over the objects of a list
+   *
+   * @param list The objects, the list itself is not modified
+   * @param options The options of the binary tree that is collapsed
+   */
+  bvh4(const hittable_list& list,
+       const bvh_build_options& options = bvh_build_options());
+
+  bool hit(const ray& r, const interval& ray_t,
+           hit_record& rec) const override;
+
+  uint32_t hit_packet(ray_packet& packet, uint32_t mask, const float t_min,
+                      hit_record* recs) const override;
+
+  aabb bounding_box() const override { return bbox; }
+
+  // As linear_bvh::move
+  void move(const vec3& offset) override;
+
+  // As linear_bvh::rotate
+  void rotate(const vec3& axis, float angle) override;
+
+  // As linear_bvh::mark_moved
+  void mark_moved(const size_t index);
+
+  // As linear_bvh::refit, from the child of the leaf of every moved object
+  bool refit();
+
+  // As linear_bvh::rebuild, the binary tree is built and collapsed again
+  void rebuild();
+
+  /**
+   * @brief The expected cost of tracing a ray through the tree, as
+   * linear_bvh::get_sah_cost with the children of the wide nodes in place of
+   * the binary nodes
+   *
+   * @return float The cost, in primitive intersections
+   */
+  float get_sah_cost() const;
+
+  // As linear_bvh::get_degradation
+  float get_degradation() const;
+
+  const std::vector<bvh4_node>& get_nodes() const { return nodes; }
+  size_t get_primitive_count() const { return primitives.size(); }
+
+ private:
+  // A child on the traversal stack
+  struct stack_entry {
+    uint32_t child;
+    uint32_t count;  // 0 for a node
+    float t_near;    // Where the ray enters its box
+  };
+
+  bvh_build_options options;
+  std::vector<bvh4_node> nodes;
+  std::vector<shared_ptr<hittable>> primitives;  // In leaf order
+  aabb bbox;
+
+  std::vector<uint32_t> parents;       // Of every node, the root is its own
+  std::vector<uint32_t> object_index;  // In the list, of every primitive
+  // The child holding every object of the list, node * width + child
+  std::vector<uint32_t> object_child;
+  std::vector<uint32_t> moved_children;  // Marked since the last refit
+  // The sum over the children of their area times their cost
+  double weighted_area = 0;
+  float built_cost = 0;  // The SAH cost after the last build
+
+  // Build the tree and the indices the refits use over a list
+  void build_tree(const hittable_list& list);
+
+  /**
+   * @brief Append the wide node of an inner node of the binary tree and the
+   * nodes below it
+   *
+   * @return uint32_t The index of the wide node
+   */
+  uint32_t collapse(const std::vector<linear_bvh_node>& binary,
+                    const uint32_t node);
+
+  // The weight of the area of a child in the SAH cost
+  float child_cost(const bvh4_node& node, const int c) const {
+    return node.count[c] > 0 ? node.count[c] : options.traversal_cost;
+  }
+
+  // The union of the boxes of the children of the root
+  void root_bounds(float bounds_min[3], float bounds_max[3]) const;
+
+  /**
+   * @brief Set the box of a child to the union of the boxes of its
+   * primitives or of the children of its node
+   *
+   * @return true if the box changed
+   */
+  bool refit_child(const uint32_t node, const int c);
+
+  // Update the box of the tree after a refit and rebuild it if needed
+  bool finish_refit();
+
+  /**
+   * @brief Trace one ray from a child of the tree down
+   *
+   */
+  bool hit_subtree(const ray& r, const interval& ray_t, hit_record& rec,
+                   const stack_entry& root) const;
+};
+
+#endif  // BVH4_HPP
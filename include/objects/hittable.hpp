@@ -16,6 +16,7 @@
 #include "aabb.hpp"
 #include "material.hpp"
 #include "math/interval.hpp"
+#include "ray_packet.hpp"
 
 class hittable {
  public:
@@ -32,6 +33,34 @@ class hittable {
   virtual bool hit(const ray& r, const interval& interval,
                    hit_record& rec) const = 0;
 
+  /**
+   * @brief Intersect several rays of a packet with the object. The default
+   * implementation traces the rays one by one, acceleration structures
+   * override it to test the whole packet at once.
+   *
+   * @param packet The rays, the closest hits so far are kept in t_max
+   * @param mask The rays of the packet to intersect (one bit per ray)
+   * @param t_min The start of the interval in which the hits should be
+   * @param recs The hit records, one per ray of the packet. Only the records
+   * of the rays that hit something closer than before are written.
+   * @return uint32_t The mask of the rays that hit the object
+   */
+  virtual uint32_t hit_packet(ray_packet& packet, const uint32_t mask,
+                              const float t_min, hit_record* recs) const {
+    uint32_t hits = 0;
+    for (int i = 0; i < packet.size; i++) {
+      if (!(mask & (1u << i))) continue;
+
+      hit_record rec;
+      if (hit(packet.rays[i], interval(t_min, packet.t_max[i]), rec)) {
+        recs[i] = rec;
+        packet.t_max[i] = rec.t;
+        hits |= 1u << i;
+      }
+    }
+    return hits;
+  }
+
   /**
    * @brief Getter for the object's bounding box
    *
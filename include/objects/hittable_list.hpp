@@ -50,6 +50,9 @@ class hittable_list : public hittable {
   bool hit(const ray& r, const interval& interval,
            hit_record& rec) const override;
 
+  uint32_t hit_packet(ray_packet& packet, const uint32_t mask,
+                      const float t_min, hit_record* recs) const override;
+
   void move(const vec3& offset) override;
   void rotate(const vec3& axis, float angle) override;
 
@@ -0,0 +1,263 @@
+/**
+ * @file linear_bvh.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the linear_bvh class, a Bounding Volume Hierarchy
+ * flattened into one array of 32-byte nodes in depth-first order. The first
+ * child of a node is the next node of the array, only the index of the second
+ * child is stored, and the leaves refer to a run of the primitive array. The
+ * rays walk the tree with a small stack instead of recursive virtual calls.
+ * The tree is built with the surface area heuristic over binned centroids,
+ * the large subtrees and the binning of the large nodes as OpenMP tasks.
+ * When objects move the boxes are refitted from the leaves of the moved
+ * objects up, and the tree is rebuilt once refitting has made it too slow.
+ * @version 0.1
+ * @date 2024-12-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef LINEAR_BVH_HPP
+#define LINEAR_BVH_HPP
+
+#include <vector>
+
+#include "bvh.hpp"
+
+/**
+ * @brief A node of the flattened tree, two of them share a cache line
+ *
+ */
+struct alignas(32) linear_bvh_node {
+  float bounds_min[3];
+  uint32_t offset;  // Second child of an inner node, first primitive of a leaf
+  float bounds_max[3];
+  uint16_t count;  // Primitives of a leaf, 0 for an inner node
+  uint16_t axis;   // Split axis of an inner node, orders its children
+
+  bool is_leaf() const { return count > 0; }
+};
+
+/**
+ * @brief How the builder divides the primitives of a node
+ *
+ */
+enum class bvh_split {
+  median,  // Half the primitives on each side of the longest axis
+  sah      // The cheapest bin boundary by the surface area heuristic
+};
+
+struct bvh_build_options {
+  bvh_split split = bvh_split::sah;
+  int bin_count = 16;        // Planes tried per axis are bin_count - 1
+  size_t max_leaf_size = 4;  // A larger node is always split
+  // Cost of visiting a node, relative to intersecting one primitive
+  float traversal_cost = 1.0f;
+  // Threads of the build, 0 keeps the OpenMP default. The tree is the same
+  // for any number of threads.
+  int threads = 0;
+  // A refit that makes the SAH cost grow past this ratio of the cost after
+  // the last build rebuilds the tree instead, 0 never rebuilds
+  float rebuild_threshold = 1.5f;
+};
+
+class linear_bvh : public hittable {
+ public:
+  // Longest path from the root, the traversal stack has one entry per level
+  static const int max_depth = 64;
+  // Upper bound of bvh_build_options::bin_count
+  static const int max_bins = 64;
+
+  /**
+   * @brief Build the tree over the objects of a list
+   *
+   * @param list The objects, the list itself is not modified
+   * @param options The split method, bins and leaf size
+   */
+  linear_bvh(const hittable_list& list,
+             const bvh_build_options& options = bvh_build_options());
+
+  bool hit(const ray& r, const interval& ray_t,
+           hit_record& rec) const override;
+
+  uint32_t hit_packet(ray_packet& packet, uint32_t mask, const float t_min,
+                      hit_record* recs) const override;
+
+  aabb bounding_box() const override { return bbox; }
+
+  /**
+   * @brief Move every object of the tree and refit all the boxes. The
+   * shape of the tree does not change, neither does its cost.
+   *
+   * @param offset The offset to move the objects by
+   */
+  void move(const vec3& offset) override;
+
+  /**
+   * @brief Rotate every object of the tree as its own rotate() does, then
+   * refit all the boxes
+   *
+   */
+  void rotate(const vec3& axis, float angle) override;
+
+  /**
+   * @brief Record that an object of the tree changed, after a call to its
+   * move() for example. The boxes are updated by the next refit().
+   *
+   * @param index The index of the object in the list the tree was built from
+   */
+  void mark_moved(const size_t index);
+
+  /**
+   * @brief Refit the boxes of the leaves of the objects marked as moved and
+   * of the nodes above them. The walk up from a leaf stops at the first node
+   * whose box stays the same, so the cost is in the number of changed nodes.
+   * If the SAH cost grew past the rebuild threshold of the options, the tree
+   * is rebuilt instead.
+   *
+   * @return true if the tree was rebuilt
+   */
+  bool refit();
+
+  /**
+   * @brief Build the tree again over the current boxes of its objects. The
+   * objects keep their indices for mark_moved().
+   *
+   */
+  void rebuild();
+
+  /**
+   * @brief The expected cost of tracing a ray through the tree: the
+   * traversal cost of every inner node and the primitives of every leaf,
+   * weighted by the chance that a ray hitting the root hits the node (the
+   * ratio of their surface areas)
+   *
+   * @return float The cost, in primitive intersections
+   */
+  float get_sah_cost() const;
+
+  /**
+   * @brief How much refitting has slowed the tree down, kept up to date by
+   * the refits in constant time per changed node
+   *
+   * @return float The SAH cost over the cost after the last build, 1 for a
+   * tree that was just built
+   */
+  float get_degradation() const;
+
+  const std::vector<linear_bvh_node>& get_nodes() const { return nodes; }
+  size_t get_primitive_count() const { return primitives.size(); }
+  // The primitives in leaf order, the leaves index into them
+  const std::vector<shared_ptr<hittable>>& get_primitives() const {
+    return primitives;
+  }
+  // The index in the list the tree was built from of every primitive
+  const std::vector<uint32_t>& get_object_indices() const {
+    return object_index;
+  }
+
+ private:
+  // A primitive during the build, its bounds are read once
+  struct build_primitive {
+    float bounds_min[3];
+    float bounds_max[3];
+    float centroid[3];
+    uint32_t index;  // In the list the tree is built from
+  };
+
+  // Spans of at least this many primitives build their children as tasks
+  static const size_t task_span = 4096;
+  // Spans of at least this many primitives are binned in parallel chunks
+  static const size_t parallel_binning_span = 1 << 15;
+
+  bvh_build_options options;
+  std::vector<linear_bvh_node> nodes;
+  std::vector<shared_ptr<hittable>> primitives;  // In leaf order
+  aabb bbox;
+
+  std::vector<uint32_t> parents;       // Of every node, the root is its own
+  std::vector<uint32_t> object_index;  // In the list, of every primitive
+  std::vector<uint32_t> object_leaf;   // Of every object of the list
+  std::vector<uint32_t> moved_leaves;  // Marked since the last refit
+  // The SAH cost times the area of the root, the sum over the nodes of
+  // their area times their cost
+  double weighted_area = 0;
+  float built_cost = 0;  // The SAH cost after the last build
+
+  /**
+   * @brief Build the tree and the indices the refits use over the objects
+   * of a list
+   *
+   */
+  void build_tree(const hittable_list& list);
+
+  /**
+   * @brief Append the subtree of a span of the primitives to an array of
+   * nodes. Must be called by one thread of the parallel region of the build,
+   * if any.
+   *
+   * @param out The array, the indices of the subtree start from its size
+   * @return uint32_t The index of the root of the subtree
+   */
+  uint32_t build(std::vector<build_primitive>& items, const size_t start,
+                 const size_t end, const int depth,
+                 std::vector<linear_bvh_node>& out) const;
+
+  // Copy a subtree built into its own array after the nodes of out
+  static void append_subtree(std::vector<linear_bvh_node>& out,
+                             const std::vector<linear_bvh_node>& subtree);
+
+  // The number of tasks the primitives of a span are split in, 1 for the
+  // small spans and outside of a parallel build
+  static size_t chunk_count(const size_t span);
+
+  /**
+   * @brief Set the bounds of a node and find the bounds of the centroids of
+   * its primitives
+   *
+   */
+  static void span_bounds(const std::vector<build_primitive>& items,
+                          const size_t start, const size_t end,
+                          linear_bvh_node& node, float centroid_min[3],
+                          float centroid_max[3]);
+
+  /**
+   * @brief Find the cheapest binned split of a span by the surface area
+   * heuristic and partition the span around it
+   *
+   * @param node The node of the span, with its bounds set
+   * @param mid Set to the first primitive of the second child
+   * @param axis Set to the split axis
+   * @return true if splitting is cheaper than a leaf (or the span is too
+   * large for one), false to make a leaf
+   */
+  bool split_sah(std::vector<build_primitive>& items, const size_t start,
+                 const size_t end, const linear_bvh_node& node,
+                 const float centroid_min[3], const float centroid_max[3],
+                 size_t& mid, int& axis) const;
+
+  // The weight of the area of a node in the SAH cost
+  float node_cost(const linear_bvh_node& node) const {
+    return node.is_leaf() ? node.count : options.traversal_cost;
+  }
+
+  /**
+   * @brief Set the box of a node to the union of the boxes of its primitives
+   * or children
+   *
+   * @return true if the box changed
+   */
+  bool refit_node(const uint32_t node);
+
+  // Update the box of the tree after a refit and rebuild it if needed
+  bool finish_refit();
+
+  /**
+   * @brief Trace one ray through the subtree below a node
+   *
+   */
+  bool hit_subtree(const ray& r, const interval& ray_t, hit_record& rec,
+                   uint32_t node) const;
+};
+
+#endif  // LINEAR_BVH_HPP
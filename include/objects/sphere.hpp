@@ -69,7 +69,11 @@ class sphere : public hittable {
    *
    * @param offset The offset to move the sphere by
    */
-  void move(const vec3& offset) override { center += offset; }
+  void move(const vec3& offset) override {
+    center += offset;
+    const vec3 rvec = vec3(radius, radius, radius);
+    bbox = aabb(center - rvec, center + rvec);
+  }
 
   /**
    * @brief Rotate the sphere by a given angle around a given axis
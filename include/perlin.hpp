@@ -17,14 +17,24 @@
 
 class perlin {
  public:
-  perlin() {
+  /**
+   * @brief Construct a new perlin object. The noise only depends on the
+   * seed, not on the thread that builds it.
+   *
+   * @param seed The seed of the random gradients and permutations
+   */
+  explicit perlin(const uint64_t seed = 0) {
+    rng generator(seed);
     for (int i = 0; i < point_count; i++) {
-      randvec[i] = unit_vector(vec3::random(-1, 1));
+      const float x = generator.next_float();
+      const float y = generator.next_float();
+      const float z = generator.next_float();
+      randvec[i] = unit_vector(vec3(2 * x - 1, 2 * y - 1, 2 * z - 1));
     }
 
-    perlin_generate_perm(perm_x);
-    perlin_generate_perm(perm_y);
-    perlin_generate_perm(perm_z);
+    perlin_generate_perm(perm_x, generator);
+    perlin_generate_perm(perm_y, generator);
+    perlin_generate_perm(perm_z, generator);
   }
 
   float noise(const vec3& p) const {
@@ -68,15 +78,15 @@ class perlin {
   int perm_y[point_count];
   int perm_z[point_count];
 
-  static void perlin_generate_perm(int* p) {
+  static void perlin_generate_perm(int* p, rng& generator) {
     for (int i = 0; i < point_count; i++) p[i] = i;
 
-    permute(p, point_count);
+    permute(p, point_count, generator);
   }
 
-  static void permute(int* p, int n) {
+  static void permute(int* p, int n, rng& generator) {
     for (int i = n - 1; i > 0; i--) {
-      int target = random_int(0, i);
+      int target = (int)generator.next_uint((uint32_t)(i + 1));
       int tmp = p[i];
       p[i] = p[target];
       p[target] = tmp;
@@ -13,17 +13,40 @@
 #define RAY_H
 
 #include "math/mat4.hpp"
+#include "render/sampler.hpp"
 
 class ray {
  public:
   ray() {}
 
   ray(const vec3& origin, const vec3& direction)
-      : orig(origin), dir(direction) {}
+      : orig(origin),
+        dir(direction),
+        inv_dir(1.0f / direction[0], 1.0f / direction[1],
+                1.0f / direction[2]) {
+    // From the inverse, a -0 component counts as negative
+    for (int axis = 0; axis < 3; axis++) negative[axis] = inv_dir[axis] < 0;
+  }
 
   const vec3& origin() const { return orig; }
   const vec3& direction() const { return dir; }
 
+  /**
+   * @brief The inverse of every component of the direction, computed once
+   * for the box tests. A 0 component gives an infinity of the same sign.
+   *
+   */
+  const vec3& inv_direction() const { return inv_dir; }
+
+  /**
+   * @brief Whether the ray goes towards the negative side of an axis, the
+   * box tests use it to pick the near and the far plane of every slab
+   *
+   * @param axis 0, 1 or 2
+   * @return int 1 if the inverse direction is negative, 0 otherwise
+   */
+  int is_negative(const int axis) const { return negative[axis]; }
+
   /**
    * @brief Returns the point at a distance t from the origin of the ray
    *
@@ -37,10 +60,13 @@ class ray {
    *
    * @param normal The normal of the intersection point
    * @param intersection_point The coordinates of the intersection point
+   * @param fuzz The radius of the sphere the reflected direction is moved in
+   * @param s The sampler of the path, three dimensions are used when fuzz is
+   * not 0
    * @return vec3 The reflected ray
    */
   ray reflect(const vec3& normal, const vec3& intersection_point,
-              const float& fuzz) const;
+              const float& fuzz, sampler& s) const;
 
   /**
    * @brief Function that constructs a refracted ray from an intersection point
@@ -48,19 +74,24 @@ class ray {
    * @param normal The normal of the intersection point
    * @param intersection_point The coordinates of the intersection point
    * @param etai_over_etat The ratio of the refractive indices
+   * @param s The sampler of the path, one dimension chooses between
+   * reflection and refraction
    * @return vec3 The refracted ray
    */
   ray refract(const vec3& normal, const vec3& intersection_point,
-              float etai_over_etat) const;
+              float etai_over_etat, sampler& s) const;
 
  private:
-  vec3 orig;  // Origin of the ray
-  vec3 dir;   // Direction of the ray
+  vec3 orig;            // Origin of the ray
+  vec3 dir;             // Direction of the ray
+  vec3 inv_dir;         // 1 / dir, per component
+  uint8_t negative[3];  // inv_dir < 0, per component
 
   float schlick(float cosine, float ref_idx) const;
 };
 
 class material;
+class hittable;
 
 class hit_record {
  public:
@@ -70,7 +101,11 @@ class hit_record {
   float u;          // U coordinate of the texture
   float v;          // V coordinate of the texture
   bool front_face;  // True if the ray intersects the front face of the object
-  std::shared_ptr<material> mat_ptr;  // Material of the object that was hit
+  // Material of the object that was hit. The object owns the material, the
+  // record only borrows it so that copying a record stays cheap.
+  const material* mat_ptr;
+  // The object that was hit, only used to tell the objects apart
+  const hittable* object;
 
   /**
    * @brief Set the face normal object
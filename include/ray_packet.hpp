@@ -0,0 +1,87 @@
+/**
+ * @file ray_packet.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the ray_packet class, a bundle of up to 16 coherent
+ * rays (e.g. the camera rays of neighbouring pixels) that are traced through
+ * the BVH together
+ * @version 0.1
+ * @date 2024-10-28
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef RAY_PACKET_HPP
+#define RAY_PACKET_HPP
+
+#include "ray.hpp"
+
+class ray_packet {
+ public:
+  static const int max_size = 16;
+
+  ray_packet() { reset(); }
+
+  /**
+   * @brief Remove every ray from the packet
+   *
+   */
+  void reset() {
+    size = 0;
+    for (int i = 0; i < max_size; i++) t_max[i] = infinity;
+  }
+
+  /**
+   * @brief Add a ray to the packet. The packet must not be full.
+   *
+   * @param r The ray to add
+   */
+  void add(const ray& r) {
+    rays[size] = r;
+    for (int axis = 0; axis < 3; axis++) {
+      origin[axis][size] = r.origin()[axis];
+      inv_direction[axis][size] = r.inv_direction()[axis];
+    }
+    size++;
+  }
+
+  /**
+   * @brief Fill the unused lanes with a copy of the last ray so that the SIMD
+   * kernels never read uninitialized values. Call after the last add().
+   *
+   */
+  void pad() {
+    for (int i = size; i < max_size; i++) {
+      for (int axis = 0; axis < 3; axis++) {
+        origin[axis][i] = origin[axis][size - 1];
+        inv_direction[axis][i] = inv_direction[axis][size - 1];
+      }
+    }
+  }
+
+  /**
+   * @brief Mask with one bit set for every ray of the packet
+   *
+   */
+  uint32_t full_mask() const { return (1u << size) - 1; }
+
+  /**
+   * @brief Index of the lowest ray of a mask, which must not be 0
+   *
+   */
+  static int first_ray(const uint32_t mask) {
+    int i = 0;
+    while (!(mask & (1u << i))) i++;
+    return i;
+  }
+
+  int size;                 // Number of rays in the packet
+  ray rays[max_size];       // The rays
+  float t_max[max_size];    // Distance to the closest hit found so far
+
+  // The same rays as structure of arrays, for the SIMD box tests
+  alignas(32) float origin[3][max_size];
+  alignas(32) float inv_direction[3][max_size];
+};
+
+#endif  // RAY_PACKET_HPP
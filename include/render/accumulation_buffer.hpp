@@ -0,0 +1,205 @@
+/**
+ * @file accumulation_buffer.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the accumulation_buffer class that stores the linear
+ * (HDR) sum of every sample and the number of samples of each pixel. The
+ * samples are only tonemapped and gamma corrected when an image is produced.
+ * @version 0.1
+ * @date 2024-10-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef ACCUMULATION_BUFFER_HPP
+#define ACCUMULATION_BUFFER_HPP
+
+#include "math/vec3.hpp"
+
+/**
+ * @brief How the linear radiance is mapped to the [0, 1] display range
+ *
+ */
+enum class tonemap_operator {
+  clamp,    // Values above 1 are clipped
+  reinhard  // x / (1 + x), compresses the highlights
+};
+
+class accumulation_buffer {
+ public:
+  /**
+   * @brief Construct a new, black, accumulation_buffer object
+   *
+   * @param width The width of the image
+   * @param height The height of the image
+   */
+  accumulation_buffer(const int width, const int height);
+
+  /**
+   * @brief Forget every sample
+   *
+   */
+  void reset();
+
+  /**
+   * @brief Add one sample to a pixel
+   *
+   * @param index The index of the pixel (y * width + x)
+   * @param color The linear color of the sample
+   */
+  void add_sample(const int index, const vec3& color) {
+    const float l = luminance(color);
+    add_samples(index, color, l * l, 1);
+  }
+
+  /**
+   * @brief Add one sample to the sums of a batch of samples, to pass them to
+   * add_samples. A NaN or infinite sample is left out, so that it does not
+   * take the rest of the batch with it.
+   *
+   * @param color The linear color of the sample
+   * @param color_sum The sum of the colors of the batch
+   * @param luminance_sq_sum The sum of the squared luminance of the batch
+   * @param count The number of samples kept in the batch
+   */
+  static void accumulate(const vec3& color, vec3& color_sum,
+                         float& luminance_sq_sum, uint32_t& count) {
+    if (!std::isfinite(color.r()) || !std::isfinite(color.g()) ||
+        !std::isfinite(color.b()))
+      return;
+
+    const float l = luminance(color);
+    color_sum += color;
+    luminance_sq_sum += l * l;
+    count++;
+  }
+
+  /**
+   * @brief Add several samples to a pixel at once
+   *
+   * @param index The index of the pixel (y * width + x)
+   * @param color_sum The sum of the linear colors of the samples
+   * @param luminance_sq_sum The sum of the squared luminance of the samples,
+   * used to estimate the variance of the pixel
+   * @param count The number of samples in the sum, see accumulate
+   */
+  void add_samples(const int index, const vec3& color_sum,
+                   const float luminance_sq_sum, const uint32_t count) {
+    // A NaN or infinite sum would poison the pixel forever
+    if (!std::isfinite(color_sum.r()) || !std::isfinite(color_sum.g()) ||
+        !std::isfinite(color_sum.b()) || !std::isfinite(luminance_sq_sum))
+      return;
+
+    sum[index] += color_sum;
+    sum_sq[index] += luminance_sq_sum;
+    samples[index] += count;
+  }
+
+  /**
+   * @brief Replace the samples of a pixel with the samples of a pixel of
+   * another buffer (of the same or another size)
+   *
+   * @param index The index of the pixel to overwrite
+   * @param from The buffer to copy from
+   * @param from_index The index of the pixel to copy
+   * @param max_samples The most samples to keep, a pixel with more samples
+   * is scaled down to this count (keeping its mean and variance)
+   */
+  void copy_pixel(const int index, const accumulation_buffer& from,
+                  const int from_index, const uint32_t max_samples);
+
+  /**
+   * @brief Get the mean linear color of a pixel
+   *
+   * @param index The index of the pixel
+   * @return vec3 The mean color, black if the pixel has no samples
+   */
+  vec3 get_average(const int index) const {
+    if (samples[index] == 0) return vec3(0, 0, 0);
+    return sum[index] / (float)samples[index];
+  }
+
+  uint32_t get_samples(const int index) const { return samples[index]; }
+
+  // The raw sums of a pixel, to send them elsewhere and add_samples() them
+  const vec3& get_sum(const int index) const { return sum[index]; }
+  float get_luminance_sq_sum(const int index) const { return sum_sq[index]; }
+
+  /**
+   * @brief Estimate the relative error of the mean of a pixel, that is the
+   * standard error of its luminance over its mean luminance
+   *
+   * @param index The index of the pixel
+   * @return float The relative error, infinity with fewer than two samples
+   */
+  float get_relative_error(const int index) const;
+
+  /**
+   * @brief Estimate the variance of the mean luminance of a pixel
+   *
+   * @param index The index of the pixel
+   * @return float The variance, infinity with fewer than two samples
+   */
+  float get_variance(const int index) const;
+
+  /**
+   * @brief Luminance of a linear color
+   *
+   */
+  static float luminance(const vec3& color) {
+    return 0.2126f * color.r() + 0.7152f * color.g() + 0.0722f * color.b();
+  }
+
+  int get_width() const { return width; }
+  int get_height() const { return height; }
+
+  void set_tonemap(const tonemap_operator op) { tonemap = op; }
+  void set_exposure(const float value) { exposure = value; }
+
+  /**
+   * @brief Tonemap and gamma correct one pixel
+   *
+   * @param index The index of the pixel
+   * @return Color The display color
+   */
+  Color resolve(const int index) const {
+    return resolve_color(get_average(index));
+  }
+
+  /**
+   * @brief Tonemap and gamma correct a linear color with the settings of the
+   * buffer
+   *
+   * @param linear The linear color
+   * @return Color The display color
+   */
+  Color resolve_color(const vec3& linear) const;
+
+  /**
+   * @brief Tonemap and gamma correct the whole image
+   *
+   * @param pixels The display image, resized if needed
+   */
+  void resolve(std::vector<Color>& pixels) const;
+
+  /**
+   * @brief Draw a heatmap of the number of samples of every pixel, from blue
+   * (fewest samples) to red (most samples)
+   *
+   * @param pixels The display image, resized if needed
+   */
+  void resolve_heatmap(std::vector<Color>& pixels) const;
+
+ private:
+  int width;
+  int height;
+
+  std::vector<vec3> sum;          // Linear sum of the samples of each pixel
+  std::vector<float> sum_sq;      // Sum of the squared sample luminance
+  std::vector<uint32_t> samples;  // Number of samples of each pixel
+
+  tonemap_operator tonemap = tonemap_operator::clamp;
+  float exposure = 1.0f;
+};
+
+#endif  // ACCUMULATION_BUFFER_HPP
@@ -0,0 +1,77 @@
+/**
+ * @file adaptive_sampling.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the adaptive_sampling class that decides, from the
+ * per-pixel variance estimates, which tiles still need samples
+ * @version 0.1
+ * @date 2024-10-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef ADAPTIVE_SAMPLING_HPP
+#define ADAPTIVE_SAMPLING_HPP
+
+#include "render/accumulation_buffer.hpp"
+#include "render/tile_scheduler.hpp"
+
+class adaptive_sampling {
+ public:
+  /**
+   * @brief Construct a new adaptive_sampling object
+   *
+   * @param error_threshold A tile has converged once the relative error of
+   * every pixel is below this value
+   * @param min_samples Samples every pixel gets before it can converge
+   * @param max_samples Samples after which a pixel is considered done no
+   * matter its error (0 means no limit)
+   */
+  adaptive_sampling(const float error_threshold = 0.05f,
+                    const uint32_t min_samples = 16,
+                    const uint32_t max_samples = 0)
+      : error_threshold(error_threshold),
+        min_samples(min_samples),
+        max_samples(max_samples) {}
+
+  void set_error_threshold(const float threshold) {
+    error_threshold = threshold;
+  }
+  void set_min_samples(const uint32_t samples) { min_samples = samples; }
+  void set_max_samples(const uint32_t samples) { max_samples = samples; }
+
+  float get_error_threshold() const { return error_threshold; }
+  uint32_t get_min_samples() const { return min_samples; }
+
+  /**
+   * @brief Estimate the error of every tile and keep only the tiles that
+   * have not converged in the scheduler, noisiest first
+   *
+   * @param scheduler The scheduler whose active tiles are updated
+   * @param accum The samples gathered so far
+   * @return size_t The number of tiles that still need samples
+   */
+  size_t update(tile_scheduler& scheduler, const accumulation_buffer& accum);
+
+  /**
+   * @brief The largest relative error of the active tiles after the last
+   * update
+   *
+   */
+  float get_max_error() const { return max_error; }
+
+ private:
+  float error_threshold;
+  uint32_t min_samples;
+  uint32_t max_samples;
+
+  float max_error = infinity;
+
+  /**
+   * @brief Error of a tile, or a negative value if the tile is done
+   *
+   */
+  float tile_error(const tile& t, const accumulation_buffer& accum) const;
+};
+
+#endif  // ADAPTIVE_SAMPLING_HPP
@@ -0,0 +1,166 @@
+/**
+ * @file aov_buffer.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the aov_buffer class that keeps the arbitrary output
+ * variables (AOVs) of a render: extra images computed from the same samples
+ * as the color, for compositing and debugging. Only the passes that were
+ * asked for are allocated and filled.
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef AOV_BUFFER_HPP
+#define AOV_BUFFER_HPP
+
+#include <string>
+#include <vector>
+
+#include "render/feature_buffer.hpp"
+
+enum class aov_type : uint32_t {
+  depth = 1 << 0,        // Distance to the first hit, infinity for the sky
+  normal = 1 << 1,       // World space normal of the first hit
+  albedo = 1 << 2,       // Surface color of the first hit
+  object_id = 1 << 3,    // Index of the object of the first hit, 0 for sky
+  material_id = 1 << 4,  // Index of the material of the first hit, 0 for sky
+  path_length = 1 << 5,  // Rays traced per sample
+  bvh_visits = 1 << 6,   // BVH nodes visited by the camera ray
+};
+
+// A set of passes, one bit per aov_type
+typedef uint32_t aov_set;
+
+inline aov_set aov_bit(const aov_type type) { return (aov_set)type; }
+
+/**
+ * @brief Everything a sample contributes to the passes
+ *
+ */
+struct aov_sample {
+  pixel_features first_hit;  // albedo, normal, depth, object and material
+  size_t path_length = 0;    // Rays traced by the sample
+  size_t bvh_visits = 0;     // BVH nodes visited by the camera ray
+};
+
+class aov_buffer {
+ public:
+  /**
+   * @brief Construct a new aov_buffer object
+   *
+   * @param width The width of the image
+   * @param height The height of the image
+   * @param passes The passes to keep, the others take no memory
+   */
+  aov_buffer(const int width, const int height, const aov_set passes = 0);
+
+  /**
+   * @brief Change the passes to keep, forgets every sample
+   *
+   * @param passes The passes to keep
+   */
+  void set_passes(const aov_set passes);
+
+  aov_set get_passes() const { return passes; }
+  bool any() const { return passes != 0; }
+  bool has(const aov_type type) const { return passes & aov_bit(type); }
+
+  /**
+   * @brief Forget every sample
+   *
+   */
+  void reset();
+
+  /**
+   * @brief Add one sample to a pixel. Every pixel must only be written by
+   * one thread at a time.
+   *
+   * @param index The index of the pixel (y * width + x)
+   * @param sample The sample
+   */
+  void add_sample(const int index, const aov_sample& sample);
+
+  uint32_t get_samples(const int index) const { return samples[index]; }
+
+  // Mean distance of the samples that hit something, infinity if none did
+  float get_depth(const int index) const;
+  // Mean normal, normalized
+  vec3 get_normal(const int index) const;
+  vec3 get_albedo(const int index) const;
+  float get_path_length(const int index) const;
+  float get_bvh_visits(const int index) const;
+
+  /**
+   * @brief The ids of the objects (or materials) seen by the first sample of
+   * every pixel. The ids are given in the order in which the objects first
+   * appear in the image, row by row, so they do not depend on the order in
+   * which the pixels were rendered.
+   *
+   * @param type object_id or material_id
+   * @return std::vector<uint32_t> One id per pixel, 0 where the sky is seen
+   */
+  std::vector<uint32_t> get_ids(const aov_type type) const;
+
+  /**
+   * @brief Write one pass to disk. A .pfm file keeps the raw float values,
+   * any other format supported by raylib gets an image scaled for viewing.
+   *
+   * @param type The pass, must be kept by the buffer
+   * @param filename The path of the output file
+   * @return true if the file was written, false otherwise
+   */
+  bool save(const aov_type type, const std::string& filename) const;
+
+  /**
+   * @brief Write every pass, next to the color image
+   *
+   * @param prefix The path of the files without the extension, the name of
+   * the pass is appended (render -> render_depth.pfm, ...)
+   * @param extension The format of the files ("pfm", "png", ...)
+   * @return true if all the files were written, false otherwise
+   */
+  bool save_all(const std::string& prefix, const std::string& extension) const;
+
+  /**
+   * @brief The name of a pass, as used on the command line and in the file
+   * names
+   *
+   */
+  static const char* name(const aov_type type);
+
+  /**
+   * @brief Parse a comma separated list of pass names ("depth,normal") or
+   * "all"
+   *
+   * @param list The list of names
+   * @param passes Receives the set of passes
+   * @return true if every name is known, false otherwise
+   */
+  static bool parse(const std::string& list, aov_set& passes);
+
+  // Every pass, in the order of the bits
+  static const aov_type all_types[7];
+
+ private:
+  int width;
+  int height;
+  aov_set passes = 0;
+
+  // One entry per pixel, only allocated for the kept passes
+  std::vector<uint32_t> samples;
+  std::vector<float> depth_sum;       // Over the samples that hit something
+  std::vector<uint32_t> hit_samples;  // Samples that hit something
+  std::vector<vec3> normal_sum;
+  std::vector<vec3> albedo_sum;
+  std::vector<const hittable*> objects;   // Of the first sample
+  std::vector<const material*> materials;  // Of the first sample
+  std::vector<float> path_length_sum;
+  std::vector<float> bvh_visits_sum;
+
+  // The values of a pass, 1 or 3 channels per pixel
+  std::vector<float> channels(const aov_type type, int& channel_count) const;
+};
+
+#endif  // AOV_BUFFER_HPP
@@ -0,0 +1,136 @@
+/**
+ * @file checkpoint_file.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the checkpoint_file class that keeps the state of a
+ * long render (the linear sums and sample counts of every pixel and the
+ * features of the first hits) in a memory-mapped file, so that a later run
+ * can resume it after the process died. The samplers hash the pixel and the
+ * sample number, the sample counts are all the state they need.
+ *
+ * The file has two slots. A save fills the slot that is not in use and a
+ * background thread writes it to disk before it makes it the current one, so
+ * a crash in the middle of a save leaves the previous state intact and the
+ * render threads never wait for the disk. Only POSIX systems are supported.
+ * @version 0.1
+ * @date 2024-11-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef CHECKPOINT_FILE_HPP
+#define CHECKPOINT_FILE_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "render/accumulation_buffer.hpp"
+#include "render/feature_buffer.hpp"
+
+/**
+ * @brief FNV-1a hash of the settings that decide what a render converges
+ * to. A checkpoint is only resumed by a render with the same hash.
+ *
+ */
+class checkpoint_hash {
+ public:
+  template <typename T>
+  checkpoint_hash& add(const T& value) {
+    const unsigned char* bytes = (const unsigned char*)&value;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      hash ^= bytes[i];
+      hash *= 0x100000001B3ull;
+    }
+    return *this;
+  }
+
+  uint64_t get() const { return hash; }
+
+ private:
+  uint64_t hash = 0xCBF29CE484222325ull;
+};
+
+class checkpoint_file {
+ public:
+  checkpoint_file() {}
+  ~checkpoint_file() { close(); }
+
+  checkpoint_file(const checkpoint_file&) = delete;
+  checkpoint_file& operator=(const checkpoint_file&) = delete;
+
+  /**
+   * @brief Open or create a checkpoint. A file written for another render
+   * (other hash or size) or damaged is started over.
+   *
+   * @param path The path of the file
+   * @param config_hash The hash of the render settings
+   * @param width The width of the image
+   * @param height The height of the image
+   * @return true if the file is mapped, false otherwise
+   */
+  bool open(const std::string& path, const uint64_t config_hash,
+            const int width, const int height);
+
+  bool is_open() const { return mapping != nullptr; }
+
+  /**
+   * @brief Samples per pixel of the saved state
+   *
+   * @return uint32_t The samples, 0 if nothing was saved yet
+   */
+  uint32_t get_samples_done() const;
+
+  /**
+   * @brief Replace the content of the buffers with the saved state
+   *
+   */
+  void load(accumulation_buffer& accum, feature_buffer& features) const;
+
+  /**
+   * @brief Copy the buffers to the file and have them written to disk in
+   * the background. The buffers must not change during the copy.
+   *
+   * @param samples_done Samples per pixel in the buffers
+   * @return true if the state was copied, false if the previous save is
+   * still being written (the state is skipped, try again later)
+   */
+  bool save(const accumulation_buffer& accum, const feature_buffer& features,
+            const uint32_t samples_done);
+
+  /**
+   * @brief Wait until the last save is on disk
+   *
+   */
+  void wait();
+
+  /**
+   * @brief Wait for the last save and unmap the file
+   *
+   */
+  void close();
+
+ private:
+  unsigned char* mapping = nullptr;
+  size_t mapping_size = 0;
+  size_t slot_offset = 0;  // Of the first slot, page aligned
+  size_t slot_size = 0;    // Page aligned
+  size_t pixel_count = 0;
+
+  // The background writer
+  std::thread writer;
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool writing = false;  // A slot is being written
+  bool stopping = false;
+  uint32_t written_slot = 0;
+  uint32_t written_samples = 0;
+
+  void write_slots();
+  unsigned char* slot(const uint32_t index) const {
+    return mapping + slot_offset + index * slot_size;
+  }
+};
+
+#endif  // CHECKPOINT_FILE_HPP
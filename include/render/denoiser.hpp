@@ -0,0 +1,106 @@
+/**
+ * @file denoiser.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the denoiser class, an edge avoiding a-trous wavelet
+ * filter (Dammertz et al. 2010) with the variance guided weights of SVGF
+ * (Schied et al. 2017).
+ *
+ * The albedo is divided out of the image before filtering, so the filter
+ * only blurs the lighting and the textures stay sharp. Every iteration is a
+ * 5x5 B3 spline kernel whose taps are spread twice as far apart as in the
+ * previous iteration. The taps are weighted down when their normal, depth or
+ * luminance differ from the center pixel; the luminance is compared to the
+ * estimated noise of the pixel, so converged pixels are left alone.
+ * @version 0.1
+ * @date 2024-11-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef DENOISER_HPP
+#define DENOISER_HPP
+
+#include "render/accumulation_buffer.hpp"
+#include "render/feature_buffer.hpp"
+
+class denoiser {
+ public:
+  /**
+   * @brief Construct a new denoiser object
+   *
+   * @param iterations The number of a-trous passes, the filter reaches
+   * 2^(iterations + 1) pixels away
+   */
+  explicit denoiser(const int iterations = 5) : iterations(iterations) {}
+
+  void set_iterations(const int count) { iterations = count; }
+  int get_iterations() const { return iterations; }
+
+  /**
+   * @brief Set how much the edges stop the filter
+   *
+   * @param luminance Standard deviations of luminance difference tolerated
+   * @param normal Exponent of the cosine between the normals
+   * @param depth Tolerated depth difference, relative to the depth gradient
+   */
+  void set_sigmas(const float luminance, const float normal,
+                  const float depth) {
+    sigma_luminance = luminance;
+    sigma_normal = normal;
+    sigma_depth = depth;
+  }
+
+  /**
+   * @brief Filter the image
+   *
+   * @param accum The samples of every pixel
+   * @param features The first hits of the same samples. Pixels without
+   * features are neither filtered nor used by their neighbours.
+   * @param output Receives the linear colors, resized if needed
+   */
+  void denoise(const accumulation_buffer& accum,
+               const feature_buffer& features, std::vector<vec3>& output);
+
+  /**
+   * @brief Filter the image, then tonemap it with the settings of accum
+   *
+   * @param accum The samples of every pixel
+   * @param features The first hits of the same samples
+   * @param pixels Receives the display image, resized if needed
+   */
+  void denoise(const accumulation_buffer& accum,
+               const feature_buffer& features, std::vector<Color>& pixels);
+
+ private:
+  int iterations;
+  float sigma_luminance = 4.0f;
+  float sigma_normal = 128.0f;
+  float sigma_depth = 1.0f;
+
+  int width = 0;
+  int height = 0;
+
+  // Guides of the filter, one entry per pixel
+  std::vector<vec3> albedo;
+  std::vector<vec3> normal;
+  std::vector<float> depth;
+  std::vector<float> depth_dx;  // Screen space derivatives of the depth
+  std::vector<float> depth_dy;
+  std::vector<uchar> valid;     // Pixels with samples and features
+
+  // The lighting (color over albedo) and the variance of its luminance,
+  // ping-ponged between the iterations
+  std::vector<vec3> irradiance;
+  std::vector<vec3> next_irradiance;
+  std::vector<float> variance;
+  std::vector<float> next_variance;
+  std::vector<float> blurred_variance;
+
+  void prepare(const accumulation_buffer& accum,
+               const feature_buffer& features);
+  void blur_variance();
+  void filter(const int step);
+};
+
+#endif  // DENOISER_HPP
@@ -0,0 +1,157 @@
+/**
+ * @file feature_buffer.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the feature_buffer class that averages what the
+ * camera rays hit first (albedo, normal and depth) over the samples of every
+ * pixel. The features are almost noise free after a single sample, so they
+ * tell the denoiser where the edges of the image are.
+ * @version 0.1
+ * @date 2024-11-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef FEATURE_BUFFER_HPP
+#define FEATURE_BUFFER_HPP
+
+#include <vector>
+
+#include "math/vec3.hpp"
+
+class hittable;
+class material;
+
+/**
+ * @brief The first hit of one sample
+ *
+ */
+struct pixel_features {
+  // Depth given to the rays that escape the scene
+  static constexpr float miss_depth = 1e4f;
+
+  vec3 albedo = vec3(0, 0, 0);  // Surface color, the sky color on a miss
+  vec3 normal = vec3(0, 0, 0);  // Facing the ray, the reversed ray on a miss
+  float depth = miss_depth;     // Distance from the camera to the hit
+
+  // What was hit, null on a miss. Only read by the render passes (see
+  // aov_buffer), a sum of features leaves them alone.
+  const hittable* object = nullptr;
+  const material* mat = nullptr;
+  // BVH nodes the camera ray visited to find the hit, 0 unless
+  // bvh_counts_visits() is on. Only read by the render passes too.
+  size_t bvh_visits = 0;
+
+  // An empty sum of features, see feature_buffer::add_samples
+  static pixel_features zero() {
+    pixel_features sum;
+    sum.depth = 0;
+    return sum;
+  }
+
+  pixel_features& operator+=(const pixel_features& other) {
+    albedo += other.albedo;
+    normal += other.normal;
+    depth += other.depth;
+    return *this;
+  }
+};
+
+class feature_buffer {
+ public:
+  /**
+   * @brief Construct a new, empty, feature_buffer object
+   *
+   * @param width The width of the image
+   * @param height The height of the image
+   */
+  feature_buffer(const int width, const int height);
+
+  /**
+   * @brief Forget every sample
+   *
+   */
+  void reset();
+
+  /**
+   * @brief Add the features of one sample to a pixel
+   *
+   * @param index The index of the pixel (y * width + x)
+   * @param features The first hit of the sample
+   */
+  void add_sample(const int index, const pixel_features& features) {
+    add_samples(index, features, 1);
+  }
+
+  /**
+   * @brief Add the features of several samples to a pixel at once
+   *
+   * @param index The index of the pixel (y * width + x)
+   * @param features_sum The sum of the features of the samples
+   * @param count The number of samples in the sum
+   */
+  void add_samples(const int index, const pixel_features& features_sum,
+                   const uint32_t count) {
+    albedo[index] += features_sum.albedo;
+    normal[index] += features_sum.normal;
+    depth[index] += features_sum.depth;
+    samples[index] += count;
+  }
+
+  /**
+   * @brief Replace the features of a pixel with the features of a pixel of
+   * another buffer
+   *
+   * @param index The index of the pixel to overwrite
+   * @param from The buffer to copy from
+   * @param from_index The index of the pixel to copy
+   */
+  void copy_pixel(const int index, const feature_buffer& from,
+                  const int from_index) {
+    albedo[index] = from.albedo[from_index];
+    normal[index] = from.normal[from_index];
+    depth[index] = from.depth[from_index];
+    samples[index] = from.samples[from_index];
+  }
+
+  uint32_t get_samples(const int index) const { return samples[index]; }
+
+  // The raw sums of a pixel, to store them and add_samples() them back
+  pixel_features get_sum(const int index) const {
+    pixel_features sum;
+    sum.albedo = albedo[index];
+    sum.normal = normal[index];
+    sum.depth = depth[index];
+    return sum;
+  }
+
+  vec3 get_albedo(const int index) const {
+    return samples[index] ? albedo[index] / (float)samples[index]
+                          : vec3(0, 0, 0);
+  }
+
+  // The mean normal is shorter than one where the samples disagree
+  vec3 get_normal(const int index) const {
+    return samples[index] ? normal[index] / (float)samples[index]
+                          : vec3(0, 0, 0);
+  }
+
+  float get_depth(const int index) const {
+    return samples[index] ? depth[index] / samples[index]
+                          : pixel_features::miss_depth;
+  }
+
+  int get_width() const { return width; }
+  int get_height() const { return height; }
+
+ private:
+  int width;
+  int height;
+
+  std::vector<vec3> albedo;       // Sum of the albedo of the samples
+  std::vector<vec3> normal;       // Sum of the normals of the samples
+  std::vector<float> depth;       // Sum of the depth of the samples
+  std::vector<uint32_t> samples;  // Number of samples of each pixel
+};
+
+#endif  // FEATURE_BUFFER_HPP
@@ -0,0 +1,133 @@
+/**
+ * @file frame_budget.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the frame_budget class, a feedback controller that
+ * decides how many camera rays the interactive renderer sends every frame.
+ * The budget follows the measured cost of the previous batches (smoothed with
+ * an exponential moving average) instead of probing the cost of single rays.
+ * @version 0.1
+ * @date 2024-11-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef FRAME_BUDGET_HPP
+#define FRAME_BUDGET_HPP
+
+#include "utils.hpp"
+
+/**
+ * @brief The work done by one render thread during the last batch
+ *
+ */
+struct alignas(64) thread_stats {
+  size_t rays = 0;       // Camera rays sent by the thread
+  float busy_time = 0;   // Seconds the thread spent tracing
+};
+
+class frame_budget {
+ public:
+  /**
+   * @brief Construct a new frame_budget object
+   *
+   * @param target_fps The frame rate the window should hold
+   * @param initial_budget The rays of the first frame, before anything was
+   * measured
+   */
+  explicit frame_budget(const float target_fps = TARGET_FPS,
+                        const size_t initial_budget = 4096);
+
+  /**
+   * @brief Change the frame rate the budget aims for
+   *
+   * @param target_fps The target frame rate
+   */
+  void set_target_fps(const float target_fps);
+
+  /**
+   * @brief The number of camera rays to send in the current frame
+   *
+   * @return size_t The budget
+   */
+  size_t get_budget() const { return budget; }
+
+  /**
+   * @brief Start timing a batch of rays. Clears the per-thread counters and
+   * sizes them for the threads the batch can use.
+   *
+   */
+  void begin_batch();
+
+  /**
+   * @brief Record the work of a render thread. Every thread writes its own
+   * counters, so this can be called from the threads without locking.
+   *
+   * @param thread The index of the calling thread
+   * @param rays The camera rays that were sent
+   * @param seconds The time it took
+   */
+  void add_thread_work(const int thread, const size_t rays,
+                       const float seconds) {
+    threads[thread].rays += rays;
+    threads[thread].busy_time += seconds;
+  }
+
+  /**
+   * @brief Stop timing the batch and compute the budget of the next frame
+   * from its measured cost
+   *
+   * @param rays The camera rays sent in the batch
+   */
+  void end_batch(const size_t rays);
+
+  /**
+   * @brief Mark the end of a frame. Measures the frame time, and shrinks the
+   * share of the frame given to rendering when the frames run late.
+   *
+   */
+  void end_frame();
+
+  float get_frame_time() const { return frame_time; }
+  float get_batch_time() const { return batch_time; }
+  size_t get_achieved_rays() const { return achieved_rays; }
+  float get_render_share() const { return render_share; }
+
+  /**
+   * @brief Smoothed throughput of the batches
+   *
+   * @return float Camera rays per second over all threads
+   */
+  float get_rays_per_second() const;
+
+  /**
+   * @brief How busy the threads were during the last batch
+   *
+   * @return float The busy time of all threads over the wall time of the
+   * batch times the number of threads, between 0 and 1
+   */
+  float get_thread_utilization() const;
+
+  const std::vector<thread_stats>& get_thread_stats() const {
+    return threads;
+  }
+
+ private:
+  float target_frame_time;   // Seconds per frame at the target frame rate
+  float render_share = 0.8f;  // Part of the frame given to the rays
+  size_t budget;             // Camera rays of the next frame
+
+  // Smoothed seconds per camera ray, 0 until the first batch was measured
+  float seconds_per_ray = 0;
+
+  float batch_time = 0;      // Wall time of the last batch
+  size_t achieved_rays = 0;  // Camera rays of the last batch
+  float frame_time = 0;      // Wall time of the last frame
+
+  std::chrono::time_point<Clock> batch_start;
+  std::chrono::time_point<Clock> frame_start;
+
+  std::vector<thread_stats> threads;
+};
+
+#endif  // FRAME_BUDGET_HPP
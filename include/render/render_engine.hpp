@@ -0,0 +1,276 @@
+/**
+ * @file render_engine.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the render_engine class that traces the interactive
+ * image on a background thread. The engine renders into its own back buffer
+ * and publishes the tiles it finished into a front buffer that the UI thread
+ * reads. The UI never waits for a batch: it posts commands (camera moves,
+ * resets, ...) that the engine applies before its next batch.
+ * @version 0.1
+ * @date 2024-11-12
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef RENDER_ENGINE_HPP
+#define RENDER_ENGINE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "camera.hpp"
+#include "render/accumulation_buffer.hpp"
+#include "render/adaptive_sampling.hpp"
+#include "render/denoiser.hpp"
+#include "render/frame_budget.hpp"
+#include "render/temporal_reprojection.hpp"
+#include "render/tile_scheduler.hpp"
+
+enum class render_command_type {
+  set_camera,      // Render from a new camera, restarts (or reprojects) the
+                   // image with a preview
+  reset,           // Restart the image
+  set_tile_order,  // Change the order of the tiles, restarts the image
+  set_heatmap,     // Show the heatmap of the samples instead of the image
+  set_denoise,     // Filter the image after every batch
+};
+
+/**
+ * @brief A change requested by the UI thread
+ *
+ */
+struct render_command {
+  render_command_type type = render_command_type::reset;
+  camera cam;                             // For set_camera
+  tile_order order = tile_order::spiral;  // For set_tile_order
+  bool enabled = false;  // For set_heatmap and set_denoise
+
+  // Whether the command throws away the image rendered so far
+  bool restarts() const {
+    return type != render_command_type::set_heatmap &&
+           type != render_command_type::set_denoise;
+  }
+};
+
+/**
+ * @brief The progress of the engine, as seen by the last published batch
+ *
+ */
+struct render_stats {
+  size_t budget = 0;           // Camera rays planned for the next batch
+  size_t achieved_rays = 0;    // Camera rays sent in the last batch
+  float batch_time = 0;        // Wall time of the last batch
+  float rays_per_second = 0;   // Smoothed camera rays per second
+  float thread_utilization = 0;
+  int passes = 0;              // Completed passes over the active tiles
+  size_t active_tiles = 0;     // Tiles that still receive samples
+  size_t tile_count = 0;       // Tiles of the image
+  bool done = false;           // Converged or reached the maximum passes
+  int preview_scale = 0;       // Downscale of the preview, 0 when not moving
+  float denoise_time = 0;      // Wall time of the last denoise, 0 when off
+};
+
+class render_engine {
+ public:
+  /**
+   * @brief Construct a new render_engine object. Nothing is traced until
+   * start() is called.
+   *
+   * @param screen_width The width of the image
+   * @param screen_height The height of the image
+   */
+  render_engine(const int screen_width, const int screen_height);
+
+  /**
+   * @brief Stops the render thread
+   *
+   */
+  ~render_engine();
+
+  render_engine(const render_engine&) = delete;
+  render_engine& operator=(const render_engine&) = delete;
+
+  void set_max_passes(const int passes) { max_passes = passes; }
+  void set_packet_size(const int size) { packet_size = size; }
+  void set_sampler(const sampler_type type) { sampling = type; }
+
+  /**
+   * @brief Make the samples and the random tile order a function of the
+   * seed only, see HeadlessRenderer::set_deterministic. The number of
+   * samples of a frame still follows the frame budget. Call before start().
+   *
+   * @param enabled true for reproducible samples
+   * @param seed The seed of the samplers and of the tile order
+   */
+  void set_deterministic(const bool enabled, const uint32_t seed = 0);
+  void set_target_fps(const float fps) { budget.set_target_fps(fps); }
+  void set_error_threshold(const float threshold) {
+    adaptive.set_error_threshold(threshold);
+  }
+
+  /**
+   * @brief Configure the preview shown while the camera moves. After every
+   * camera move the engine traces one low resolution frame with short paths
+   * and upsamples it. Full resolution resumes once the camera stood still
+   * for the hold time.
+   *
+   * @param scale 2, 4 or 8 pixels per preview pixel, 0 picks the finest
+   * scale that fits in the frame budget, 1 disables the preview
+   * @param max_depth The maximum depth of the preview paths
+   * @param hold Seconds without camera moves before full resolution resumes
+   */
+  void set_preview(const int scale, const size_t max_depth, const float hold) {
+    preview_scale = scale;
+    preview_depth = max_depth;
+    preview_hold = hold;
+  }
+
+  /**
+   * @brief Keep the samples across camera moves. The primary hit of every
+   * pixel is stored, and after a move the samples follow their surface to
+   * the new view. Pixels that see a surface that was hidden before start
+   * from scratch. The preview is only shown when less than half of the
+   * image could be reprojected.
+   *
+   * @param enabled true to reproject, false to restart after every move
+   * @param max_history The most samples a reprojected pixel keeps
+   */
+  void set_temporal(const bool enabled, const uint32_t max_history = 32) {
+    temporal = enabled;
+    reprojection.set_max_history(max_history);
+  }
+
+  /**
+   * @brief Start the render thread. The settings above must be set before.
+   *
+   * @param world The scene, must outlive the engine (or the call to stop())
+   * @param cam The camera to render from
+   */
+  void start(hittable_list* world, const camera& cam);
+
+  /**
+   * @brief Stop the render thread, the current batch is interrupted
+   *
+   */
+  void stop();
+
+  /**
+   * @brief Queue a command. Commands that restart the image also interrupt
+   * the batch in flight, so that they show up within one frame.
+   *
+   * @param command The command
+   */
+  void post(const render_command& command);
+
+  void set_camera(const camera& cam);
+  void reset();
+  void set_tile_order(const tile_order order);
+  void set_heatmap(const bool enabled);
+  void set_denoise(const bool enabled);
+
+  /**
+   * @brief Read the front buffer. The callback runs while the engine cannot
+   * publish, so it should only copy or upload the pixels.
+   *
+   * @param fn Called with the front buffer and the tiles published since the
+   * last call, only when there is at least one
+   * @return true if the callback was called, false if nothing changed
+   */
+  template <typename Function>
+  bool read_frame(Function fn) {
+    std::lock_guard<std::mutex> lock(frame_mutex);
+    if (dirty.empty()) return false;
+
+    fn(front, dirty);
+    dirty.clear();
+    return true;
+  }
+
+  /**
+   * @brief The statistics of the last published batch
+   *
+   * @return render_stats A copy of the statistics
+   */
+  render_stats get_stats();
+
+ private:
+  const int screen_width;
+  const int screen_height;
+  hittable_list* world = nullptr;
+
+  // Owned by the render thread
+  camera cam;
+  accumulation_buffer accum;
+  tile_scheduler scheduler;
+  adaptive_sampling adaptive;
+  frame_budget budget;
+  sampler_type sampling = sampler_type::sobol;
+  uint32_t seed = 0;           // Of the samplers
+  bool deterministic = false;  // See set_deterministic
+  int packet_size = 4;
+  int max_passes = 100;
+  int passes = 0;
+  size_t start_index = 0;      // The position of the next tile to render
+  bool converged = false;
+  bool show_heatmap = false;
+  std::vector<Color> pixels;   // The back buffer
+  std::vector<tile> finished;  // Tiles resolved since the last publish
+  bool full_frame = false;     // Publish the whole back buffer
+
+  // Preview while the camera moves, owned by the render thread
+  int preview_scale = 0;
+  size_t preview_depth = 3;
+  float preview_hold = 0.15f;
+  bool previewing = false;       // The camera moved less than hold ago
+  bool preview_rendered = false;  // The preview of the last move is shown
+  int last_preview_scale = 0;
+  std::chrono::time_point<Clock> preview_deadline;
+  std::vector<vec3> preview_colors;
+
+  // Reprojection across camera moves, owned by the render thread
+  bool temporal = false;
+  temporal_reprojection reprojection;
+  geometry_buffer geometry;           // Primary hits of the current view
+  geometry_buffer previous_geometry;  // Primary hits of the previous view
+  accumulation_buffer history;        // Samples of the previous view
+
+  // Denoising of every batch, owned by the render thread. The features are
+  // gathered even when the denoiser is off.
+  bool denoising = false;
+  feature_buffer features;          // First hits of the samples in accum
+  feature_buffer history_features;  // First hits of the samples in history
+  denoiser filter;
+  float denoise_time = 0;
+
+  // Shared with the UI thread, guarded by frame_mutex
+  std::mutex frame_mutex;
+  std::vector<Color> front;
+  std::vector<tile> dirty;
+  render_stats stats;
+
+  // The command queue, guarded by command_mutex
+  std::mutex command_mutex;
+  std::condition_variable command_ready;
+  std::vector<render_command> commands;
+  bool stopping = false;
+  std::atomic<bool> interrupted{false};
+
+  std::thread worker;
+
+  void run();
+  bool is_done() const { return passes >= max_passes || converged; }
+  void apply(const std::vector<render_command>& pending);
+  void restart();
+  void restart_passes();
+  float reproject(const camera& previous);
+  void resolve_frame();
+  void render_batch();
+  bool restart_pending();
+  void render_preview();
+  void publish();
+};
+
+#endif  // RENDER_ENGINE_HPP
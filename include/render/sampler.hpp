@@ -0,0 +1,188 @@
+/**
+ * @file sampler.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the sampler class that hands out the random numbers
+ * of a path. Every random decision of a sample (pixel jitter, lens position,
+ * scatter direction, Russian roulette) draws one dimension of the sample.
+ *
+ * Two sample patterns are supported:
+ * - independent: every dimension is a new uniform random number
+ * - sobol: the first two dimensions of the Sobol sequence, Owen scrambled
+ *   per pixel with the hash based scramble of Burley (2020). Every pair of
+ *   dimensions shuffles the sample order on its own, so the pairs are
+ *   decorrelated (padding) while the samples of a pixel stay stratified in
+ *   every pair.
+ *
+ * The Sobol points are a pure function of (seed, pixel, sample, dimension).
+ * The independent numbers come from the generator of the calling thread,
+ * unless the sampler is deterministic: then they hash the same four values,
+ * so an image does not depend on which thread rendered which pixel.
+ * @version 0.1
+ * @date 2024-11-05
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include "utils.hpp"
+
+enum class sampler_type {
+  independent,  // Uniform random numbers
+  sobol,        // Owen scrambled, padded Sobol points
+};
+
+class sampler {
+ public:
+  // The dimensions used by the camera ray: pixel jitter and lens position
+  static const uint32_t pixel_dimensions = 4;
+  // The dimensions used by every bounce: the material gets the first three,
+  // the last one decides the Russian roulette
+  static const uint32_t bounce_dimensions = 4;
+  static const uint32_t roulette_dimension = 3;
+
+  /**
+   * @brief Construct a new sampler object
+   *
+   * @param type The sample pattern
+   * @param seed Changes the scrambling of every pixel
+   * @param deterministic Hash the independent numbers instead of drawing
+   * them from the generator of the thread
+   */
+  explicit sampler(const sampler_type type = sampler_type::independent,
+                   const uint32_t seed = 0, const bool deterministic = false)
+      : type(type), seed(seed), deterministic(deterministic) {}
+
+  sampler_type get_type() const { return type; }
+  bool is_deterministic() const { return deterministic; }
+
+  /**
+   * @brief Start a new sample of a pixel. The samples of a pixel should be
+   * numbered 0, 1, 2, ... for the Sobol points to stay stratified.
+   *
+   * @param pixel The index of the pixel (y * width + x)
+   * @param sample_index The number of samples the pixel already received
+   */
+  void start_pixel_sample(const int pixel, const uint32_t sample_index) {
+    pixel_seed = hash(seed ^ hash((uint32_t)pixel));
+    index = sample_index;
+    dimension = 0;
+  }
+
+  /**
+   * @brief Move to the dimensions of a bounce, so that the same decision of
+   * different samples always uses the same dimension
+   *
+   * @param depth The number of the ray in the path (1 is the camera ray)
+   * @param offset The dimension inside the bounce
+   */
+  void start_bounce(const size_t depth, const uint32_t offset = 0) {
+    dimension = pixel_dimensions + (uint32_t)(depth - 1) * bounce_dimensions +
+                offset;
+  }
+
+  /**
+   * @brief Get the next dimension of the sample
+   *
+   * @return float A value in [0, 1)
+   */
+  float get_1d() {
+    if (type == sampler_type::independent) {
+      if (!deterministic) return thread_rng().next_float();
+      return to_float(hash(hash_combine(pixel_seed ^ hash(index),
+                                        dimension++)));
+    }
+
+    const uint32_t dimension_seed = hash_combine(pixel_seed, dimension++);
+    const uint32_t shuffled = nested_uniform_scramble(index, dimension_seed);
+    return to_float(nested_uniform_scramble(reverse_bits(shuffled),
+                                            hash_combine(dimension_seed, 0)));
+  }
+
+  /**
+   * @brief Get the next two dimensions of the sample, they are stratified
+   * together
+   *
+   * @param u Receives the first value in [0, 1)
+   * @param v Receives the second value in [0, 1)
+   */
+  void get_2d(float& u, float& v) {
+    if (type == sampler_type::independent) {
+      u = get_1d();
+      v = get_1d();
+      return;
+    }
+
+    const uint32_t pair_seed = hash_combine(pixel_seed, dimension);
+    dimension += 2;
+
+    const uint32_t shuffled = nested_uniform_scramble(index, pair_seed);
+    u = to_float(nested_uniform_scramble(reverse_bits(shuffled),
+                                         hash_combine(pair_seed, 0)));
+    v = to_float(nested_uniform_scramble(sobol_dimension_1(shuffled),
+                                         hash_combine(pair_seed, 1)));
+  }
+
+ private:
+  sampler_type type;
+  uint32_t seed;
+  bool deterministic;
+  uint32_t pixel_seed = 0;  // Scrambles the points of the current pixel
+  uint32_t index = 0;       // The number of the sample in its pixel
+  uint32_t dimension = 0;   // The next dimension to hand out
+
+  static float to_float(const uint32_t x) {
+    return (x >> 8) * (1.0f / 16777216.0f);
+  }
+
+  static uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+  }
+
+  static uint32_t hash_combine(const uint32_t seed, const uint32_t value) {
+    return seed ^ (hash(value) + 0x9E3779B9u + (seed << 6) + (seed >> 2));
+  }
+
+  static uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+  }
+
+  // Second dimension of the Sobol sequence (the first one is the bit
+  // reversed index)
+  static uint32_t sobol_dimension_1(uint32_t index) {
+    uint32_t result = 0;
+    for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+      if (index & 1) result ^= v;
+    return result;
+  }
+
+  // A hash that only mixes the lower bits into the higher ones, which is an
+  // Owen scramble of the bit reversed value (Laine and Karras)
+  static uint32_t laine_karras_permutation(uint32_t x, const uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6C50B47Cu;
+    x ^= x * 0xB82F1E52u;
+    x ^= x * 0xC7AFE638u;
+    x ^= x * 0x8D22F6E6u;
+    return x;
+  }
+
+  static uint32_t nested_uniform_scramble(uint32_t x, const uint32_t seed) {
+    x = reverse_bits(x);
+    x = laine_karras_permutation(x, seed);
+    return reverse_bits(x);
+  }
+};
+
+#endif  // SAMPLER_HPP
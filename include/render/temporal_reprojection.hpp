@@ -0,0 +1,111 @@
+/**
+ * @file temporal_reprojection.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the geometry_buffer and temporal_reprojection
+ * classes. When the camera moves, the samples accumulated so far are moved to
+ * the pixels that see the same surface from the new point of view, instead of
+ * being thrown away. Pixels whose surface was hidden before (disocclusions)
+ * start from scratch.
+ * @version 0.1
+ * @date 2024-11-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef TEMPORAL_REPROJECTION_HPP
+#define TEMPORAL_REPROJECTION_HPP
+
+#include "camera.hpp"
+#include "render/accumulation_buffer.hpp"
+#include "render/feature_buffer.hpp"
+
+/**
+ * @brief The primary hit of the center of every pixel
+ *
+ */
+class geometry_buffer {
+ public:
+  geometry_buffer(const int width, const int height);
+
+  /**
+   * @brief Trace one ray through the center of every pixel and store what it
+   * hit
+   *
+   * @param cam The camera
+   * @param world The list of objects in the scene
+   */
+  void build(const camera& cam, hittable_list* world);
+
+  bool is_valid() const { return valid; }
+  void invalidate() { valid = false; }
+
+  int get_width() const { return width; }
+  int get_height() const { return height; }
+
+  // Distance from the camera to the hit, infinity if the ray escaped
+  float get_distance(const int index) const { return distance[index]; }
+  const vec3& get_normal(const int index) const { return normal[index]; }
+  // The normalized direction of the ray through the pixel center
+  const vec3& get_direction(const int index) const { return direction[index]; }
+
+ private:
+  int width;
+  int height;
+  bool valid = false;
+
+  std::vector<float> distance;
+  std::vector<vec3> normal;
+  std::vector<vec3> direction;
+};
+
+class temporal_reprojection {
+ public:
+  /**
+   * @brief Construct a new temporal_reprojection object
+   *
+   * @param max_history The most samples a reprojected pixel keeps. Glossy
+   * and glass surfaces change with the point of view, so old samples are
+   * only trusted up to this count and new samples take over quickly.
+   * @param depth_tolerance The relative difference of the distances under
+   * which two hits are the same surface
+   * @param normal_tolerance The smallest cosine between the normals of two
+   * hits on the same surface
+   */
+  explicit temporal_reprojection(const uint32_t max_history = 32,
+                                 const float depth_tolerance = 0.05f,
+                                 const float normal_tolerance = 0.9f);
+
+  void set_max_history(const uint32_t samples) { max_history = samples; }
+
+  /**
+   * @brief Move the samples of the previous view into the current one
+   *
+   * @param previous The camera of the previous view
+   * @param previous_geometry The primary hits of the previous view
+   * @param previous_accum The samples of the previous view
+   * @param current The camera of the current view
+   * @param current_geometry The primary hits of the current view
+   * @param current_accum Receives the reprojected samples, pixels without a
+   * history are left empty
+   * @param previous_features If not null, the first hits of the previous
+   * view, moved along with the samples
+   * @param current_features Receives the reprojected first hits
+   * @return size_t The number of pixels that kept their history
+   */
+  size_t reproject(const camera& previous,
+                   const geometry_buffer& previous_geometry,
+                   const accumulation_buffer& previous_accum,
+                   const camera& current,
+                   const geometry_buffer& current_geometry,
+                   accumulation_buffer& current_accum,
+                   const feature_buffer* previous_features = nullptr,
+                   feature_buffer* current_features = nullptr) const;
+
+ private:
+  uint32_t max_history;
+  float depth_tolerance;
+  float normal_tolerance;
+};
+
+#endif  // TEMPORAL_REPROJECTION_HPP
@@ -0,0 +1,245 @@
+/**
+ * @file tile_scheduler.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the tile_scheduler class that splits the screen into
+ * small blocks and hands them out to the render threads. Every thread owns a
+ * queue of tiles and steals from the other queues once its own is empty.
+ * @version 0.1
+ * @date 2024-10-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef TILE_SCHEDULER_HPP
+#define TILE_SCHEDULER_HPP
+
+#include <algorithm>
+#include <mutex>
+
+#include "utils.hpp"
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief A rectangular block of pixels. x1 and y1 are exclusive.
+ *
+ */
+struct tile {
+  int x0, y0;
+  int x1, y1;
+
+  int pixel_count() const { return (x1 - x0) * (y1 - y0); }
+};
+
+/**
+ * @brief The order in which the tiles of a pass are handed out
+ *
+ */
+enum class tile_order {
+  scanline,  // Left to right, top to bottom
+  spiral,    // From the center of the screen outwards
+  random     // Shuffled, gives the progressive "random dots" preview look
+};
+
+class tile_scheduler {
+ public:
+  /**
+   * @brief Construct a new tile_scheduler object
+   *
+   * @param screen_width The width of the screen in pixels
+   * @param screen_height The height of the screen in pixels
+   * @param tile_size The side of a (square) tile in pixels
+   * @param order The order in which the tiles are handed out
+   */
+  tile_scheduler(const int screen_width, const int screen_height,
+                 const int tile_size = 16,
+                 const tile_order order = tile_order::spiral);
+
+  size_t tile_count() const { return tiles.size(); }
+  int get_tile_size() const { return tile_size; }
+  const tile& get_tile(const size_t index) const { return tiles[index]; }
+
+  /**
+   * @brief Number of tiles that still take part in a pass. Unless
+   * set_active_tiles() was called this is every tile.
+   *
+   */
+  size_t active_tile_count() const { return active.size(); }
+
+  /**
+   * @brief Get an active tile by its position in the list of active tiles
+   *
+   */
+  const tile& get_active_tile(const size_t position) const {
+    return tiles[active[position]];
+  }
+
+  /**
+   * @brief Restrict the passes to a subset of the tiles, for example the
+   * tiles that have not converged yet
+   *
+   * @param indices The indices of the tiles, in the order they are handed out
+   */
+  void set_active_tiles(std::vector<size_t> indices) {
+    active = std::move(indices);
+  }
+
+  /**
+   * @brief Make every tile take part in the passes again, in tile order
+   *
+   */
+  void activate_all_tiles();
+
+  tile_order get_order() const { return order; }
+
+  /**
+   * @brief Change the order of the tiles. The tiles are reordered in place,
+   * so any pass that is in progress should be restarted.
+   *
+   * @param new_order The new order
+   */
+  void set_order(const tile_order new_order);
+
+  /**
+   * @brief Shuffle the random order with a fixed seed instead of a new one
+   * every time, so that the order is the same on every run. Takes effect
+   * when the tiles are next built (see set_order).
+   *
+   * @param seed The seed of the shuffle
+   */
+  void set_shuffle_seed(const uint64_t seed) {
+    shuffle_seed = seed;
+    seeded = true;
+  }
+
+  /**
+   * @brief Call fn(tile) on the active tiles in [first, last), where first
+   * and last are positions in the list of active tiles. The range is split
+   * into one contiguous queue per thread; threads that run out of work steal
+   * the back half of another thread's queue.
+   *
+   * @param first Index of the first tile
+   * @param last Index one past the last tile
+   * @param fn The function that renders a tile
+   */
+  template <typename TileFunction>
+  void dispatch(const size_t first, const size_t last, TileFunction&& fn);
+
+  /**
+   * @brief Call fn(x, y) on every pixel of a tile, in Morton (Z-curve) order
+   * so that consecutive rays stay close on the screen and in the scene.
+   *
+   * @param t The tile
+   * @param fn The function that renders a pixel
+   */
+  template <typename PixelFunction>
+  void for_each_pixel(const tile& t, PixelFunction&& fn) const;
+
+  /**
+   * @brief Call fn(xs, ys, count) on groups of up to group_size pixels of a
+   * tile. The pixels are taken in Morton order, so groups of 4, 8 and 16
+   * pixels are 2x2, 4x2 and 4x4 blocks of the screen.
+   *
+   * @param t The tile
+   * @param group_size The number of pixels of a group, at most 16
+   * @param fn The function that renders a group of pixels
+   */
+  template <typename GroupFunction>
+  void for_each_pixel_group(const tile& t, const int group_size,
+                            GroupFunction&& fn) const;
+
+ private:
+  // One queue of tile indices per thread. The owner pops from the front,
+  // thieves take from the back.
+  struct alignas(64) work_queue {
+    std::mutex lock;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  const int screen_width;
+  const int screen_height;
+  const int tile_size;
+  tile_order order;
+  uint64_t shuffle_seed = 0;  // Of the random order, if seeded
+  bool seeded = false;
+
+  std::vector<tile> tiles;
+  std::vector<size_t> active;  // Indices of the tiles that take part in a pass
+  std::vector<std::pair<int, int>> pixel_order;  // Morton order in a tile
+
+  std::unique_ptr<work_queue[]> queues;
+  int queue_count = 0;
+
+  void build_tiles();
+  void build_pixel_order();
+
+  void seed_queues(const size_t first, const size_t last, const int threads);
+  bool next_tile(const int thread, size_t& index);
+};
+
+template <typename TileFunction>
+void tile_scheduler::dispatch(const size_t first, const size_t last,
+                              TileFunction&& fn) {
+  const size_t end = std::min(last, active.size());
+  if (first >= end) return;
+
+#ifdef USE_OPENMP
+  const int threads = omp_get_max_threads();
+#else
+  const int threads = 1;
+#endif
+
+  seed_queues(first, end, threads);
+
+#ifdef USE_OPENMP
+#pragma omp parallel num_threads(threads)
+#endif
+  {
+#ifdef USE_OPENMP
+    const int thread = omp_get_thread_num();
+#else
+    const int thread = 0;
+#endif
+    size_t index;
+    while (next_tile(thread, index)) fn(tiles[active[index]]);
+  }
+}
+
+template <typename PixelFunction>
+void tile_scheduler::for_each_pixel(const tile& t, PixelFunction&& fn) const {
+  const bool full = t.x1 - t.x0 == tile_size && t.y1 - t.y0 == tile_size;
+
+  for (const auto& offset : pixel_order) {
+    const int x = t.x0 + offset.first;
+    const int y = t.y0 + offset.second;
+    // Tiles on the right and bottom edges can be cut by the screen border
+    if (!full && (x >= t.x1 || y >= t.y1)) continue;
+    fn(x, y);
+  }
+}
+
+template <typename GroupFunction>
+void tile_scheduler::for_each_pixel_group(const tile& t, const int group_size,
+                                          GroupFunction&& fn) const {
+  const int size = std::max(1, std::min(group_size, 16));
+  int xs[16];
+  int ys[16];
+  int count = 0;
+
+  for_each_pixel(t, [&](const int x, const int y) {
+    xs[count] = x;
+    ys[count] = y;
+    if (++count == size) {
+      fn(xs, ys, count);
+      count = 0;
+    }
+  });
+
+  if (count > 0) fn(xs, ys, count);
+}
+
+#endif  // TILE_SCHEDULER_HPP
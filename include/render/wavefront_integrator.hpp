@@ -0,0 +1,111 @@
+/**
+ * @file wavefront_integrator.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the wavefront_integrator class, a streaming path
+ * tracer that advances a large batch of paths one bounce at a time. Every
+ * bounce runs in stages (intersect, sort by material, shade, compact), each
+ * stage being a tight loop over contiguous arrays.
+ * @version 0.1
+ * @date 2024-10-30
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef WAVEFRONT_INTEGRATOR_HPP
+#define WAVEFRONT_INTEGRATOR_HPP
+
+#include <vector>
+
+#include "camera.hpp"
+#include "render/accumulation_buffer.hpp"
+
+class wavefront_integrator {
+ public:
+  /**
+   * @brief Construct a new wavefront_integrator object
+   *
+   * @param batch_size The number of paths that are in flight at once
+   */
+  explicit wavefront_integrator(const size_t batch_size = 1 << 18);
+
+  /**
+   * @brief Trace samples_per_pixel paths through every given pixel and add
+   * them to the accumulation buffer
+   *
+   * @param cam The camera that generates the paths
+   * @param world The list of objects in the scene
+   * @param pixels The indices (y * width + x) of the pixels to render
+   * @param samples_per_pixel The number of paths of every pixel
+   * @param accum The buffer that receives the samples
+   * @param features If not null, receives the first hits of the samples
+   * @return size_t The number of rays traced
+   */
+  size_t render(const camera& cam, hittable_list* world,
+                const std::vector<int>& pixels,
+                const uint32_t samples_per_pixel, accumulation_buffer& accum,
+                feature_buffer* features = nullptr);
+
+  /**
+   * @brief Choose the pattern of the random numbers of every sample
+   *
+   * @param type Independent random numbers or scrambled Sobol points
+   * @param seed The seed of the samplers
+   * @param deterministic Make the independent numbers a function of the
+   * sample, see sampler
+   */
+  void set_sampler(const sampler_type type, const uint32_t seed = 0,
+                   const bool deterministic = false) {
+    sampling = type;
+    sampler_seed = seed;
+    sampler_deterministic = deterministic;
+  }
+
+ private:
+  size_t batch_size;
+  sampler_type sampling = sampler_type::sobol;
+  uint32_t sampler_seed = 0;
+  bool sampler_deterministic = false;
+
+  // The state of the paths in flight, one entry per path. The arrays are
+  // kept between calls so that they are only allocated once.
+  std::vector<ray> rays;
+  std::vector<vec3> throughput;
+  std::vector<uint32_t> slot;    // The sample the path belongs to
+  std::vector<uint16_t> depth;   // Rays traced so far
+  std::vector<hit_record> recs;  // Closest hit of the current ray
+  std::vector<uchar> hit;        // Whether the current ray hit anything
+  std::vector<uint32_t> order;   // Paths sorted by material
+  size_t hit_count = 0;          // The number of paths in order
+
+  // The same arrays after compaction, swapped with the ones above
+  std::vector<ray> next_rays;
+  std::vector<vec3> next_throughput;
+  std::vector<uint32_t> next_slot;
+  std::vector<uint16_t> next_depth;
+
+  // The state and result of every sample of the batch, indexed by slot
+  std::vector<sampler> samplers;
+  std::vector<vec3> radiance;
+  std::vector<uint16_t> path_length;
+  std::vector<pixel_features> first_hit;  // Only filled for a feature_buffer
+
+  // The samples every pixel had before the call to render()
+  std::vector<uint32_t> first_index;
+
+  void generate(const camera& cam, const std::vector<int>& pixels,
+                const int screen_width, const uint32_t samples_per_pixel,
+                const size_t first_sample, const size_t sample_count);
+  void intersect(hittable_list* world, const size_t path_count);
+  void record_first_hits(const size_t path_count);
+  void sort_by_material(const size_t path_count);
+  void shade(const camera& cam);
+  size_t compact();
+
+  static int octant(const vec3& direction) {
+    return (direction.x() < 0) | (direction.y() < 0) << 1 |
+           (direction.z() < 0) << 2;
+  }
+};
+
+#endif  // WAVEFRONT_INTEGRATOR_HPP
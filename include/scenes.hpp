@@ -0,0 +1,56 @@
+/**
+ * @file scenes.hpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Declaration of the built-in demo scenes shared by the applications
+ * @version 0.1
+ * @date 2024-10-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SCENES_HPP
+#define SCENES_HPP
+
+#include "objects/bvh4.hpp"
+
+/**
+ * @brief Scene containing three spheres and a ground.
+ * The spheres are a dielectric, a metal, and a lambertian material.
+ * The ground is a checker texture.
+ */
+hittable_list three_spheres();
+
+/**
+ * @brief Scene containing a sphere with an earth texture
+ */
+hittable_list earth();
+
+/**
+ * @brief Scene containing two spheres with a perlin noise texture
+ */
+hittable_list perlin_spheres();
+
+/**
+ * @brief Scene containing an open box made out of five coloured quads
+ */
+hittable_list coloured_box();
+
+/**
+ * @brief function that creates a cornell box
+ * NOTE: The function does not create a BVH node
+ *
+ * @return hittable_list The list of objects in the scene
+ */
+hittable_list cornell_box();
+
+/**
+ * @brief Build one of the scenes above by its number
+ *
+ * @param scene_id 1 = three_spheres, 2 = earth, 3 = perlin_spheres,
+ * 4 = coloured_box, 5 = cornell_box
+ * @return hittable_list The scene, or an empty list if the id is unknown
+ */
+hittable_list make_scene(const int scene_id);
+
+#endif  // SCENES_HPP
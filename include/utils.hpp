@@ -27,6 +27,7 @@
 #include <vector>
 
 #include "external/stb_image.h"
+#include "math/rng.hpp"
 #include "raylib.h"
 
 // C++ Std Usings
@@ -51,14 +52,16 @@ const float infinity = std::numeric_limits<float>::infinity();
 
 // Utility Functions
 
-// Returns a random real in [0,1).
+// Returns a random real in [min,max), drawn from the generator of the
+// calling thread.
 inline float random_float(float min = 0, float max = 1) {
-  const float rand = (float)GetRandomValue(0, 1000) / 1000.0f;
-  return min + (max - min) * rand;
+  return min + (max - min) * thread_rng().next_float();
 }
 
 // Returns a random integer in [min,max].
-inline int random_int(int min, int max) { return GetRandomValue(min, max); }
+inline int random_int(int min, int max) {
+  return min + (int)thread_rng().next_uint((uint32_t)(max - min + 1));
+}
 
 inline float clamp(float x, float min, float max) {
   if (x < min) return min;
@@ -0,0 +1,476 @@
+/**
+ * @file DistributedRenderer.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the RenderCoordinator and RenderWorker classes
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "DistributedRenderer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include "scenes.hpp"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Every message starts with a header, followed by size bytes of payload
+const uint32_t protocol_magic = 0x31505246;  // "FRP1"
+const uint32_t protocol_version = 2;
+const uint32_t max_payload = 1u << 30;
+
+enum class message_type : uint32_t {
+  hello = 1,  // Worker -> coordinator: protocol_version
+  job,        // Coordinator -> worker: render_job
+  task,       // Coordinator -> worker: task_message
+  result,     // Worker -> coordinator: result_message + the pixels
+  done,       // Coordinator -> worker: no more tasks, empty
+};
+
+struct message_header {
+  uint32_t magic;
+  message_type type;
+  uint32_t size;
+};
+
+struct task_message {
+  uint32_t index;  // Of the task, sent back with the result
+  uint32_t first_tile;
+  uint32_t tile_count;
+  uint32_t first_sample;
+  uint32_t samples;
+};
+
+struct result_message {
+  uint32_t index;       // Of the task
+  uint32_t raw_size;    // Size of the pixels before compression
+  uint32_t compressed;  // 1 if the pixels that follow are compressed
+};
+
+// Every pixel is sent as 5 words: r, g, b, luminance_sq and samples
+const size_t words_per_pixel = 5;
+
+bool send_message(socket_connection& connection, const message_type type,
+                  const void* payload, const size_t size) {
+  const message_header header = {protocol_magic, type, (uint32_t)size};
+  return connection.send_all(&header, sizeof(header)) &&
+         (size == 0 || connection.send_all(payload, size));
+}
+
+bool receive_message(socket_connection& connection, message_type& type,
+                     std::vector<unsigned char>& payload) {
+  message_header header;
+  if (!connection.receive_all(&header, sizeof(header)) ||
+      header.magic != protocol_magic || header.size > max_payload)
+    return false;
+
+  type = header.type;
+  payload.resize(header.size);
+  return header.size == 0 ||
+         connection.receive_all(payload.data(), payload.size());
+}
+
+// Receive a message that must be of the given type and size
+template <typename T>
+bool receive_fixed(socket_connection& connection, const message_type type,
+                   T& value) {
+  message_type received;
+  std::vector<unsigned char> payload;
+  if (!receive_message(connection, received, payload) || received != type ||
+      payload.size() != sizeof(T))
+    return false;
+
+  memcpy(&value, payload.data(), sizeof(T));
+  return true;
+}
+
+/**
+ * @brief Byte shuffle: the first bytes of every word, then the second bytes,
+ * ... The exponents and high mantissa bytes of neighbouring pixels are
+ * alike, grouping them lets deflate find them.
+ *
+ */
+std::vector<unsigned char> shuffle(const std::vector<uint32_t>& words) {
+  const size_t count = words.size();
+  std::vector<unsigned char> bytes(count * 4);
+  for (size_t i = 0; i < count; i++)
+    for (size_t b = 0; b < 4; b++)
+      bytes[b * count + i] = (unsigned char)(words[i] >> (8 * b));
+  return bytes;
+}
+
+std::vector<uint32_t> unshuffle(const unsigned char* bytes,
+                                const size_t count) {
+  std::vector<uint32_t> words(count, 0);
+  for (size_t b = 0; b < 4; b++)
+    for (size_t i = 0; i < count; i++)
+      words[i] |= (uint32_t)bytes[b * count + i] << (8 * b);
+  return words;
+}
+
+uint32_t float_bits(const float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float bits_float(const uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// The pixels of the tiles of a task, in the order they are sent
+template <typename PixelFunction>
+void for_each_task_pixel(const tile_scheduler& scheduler,
+                         const uint32_t first_tile, const uint32_t tile_count,
+                         PixelFunction&& fn) {
+  for (uint32_t t = first_tile; t < first_tile + tile_count; t++)
+    scheduler.for_each_pixel(scheduler.get_tile(t), fn);
+}
+
+}  // namespace
+
+RenderCoordinator::~RenderCoordinator() {
+  listener.close();
+  stop_workers(true);
+}
+
+void RenderCoordinator::set_task_size(const size_t tiles,
+                                      const uint32_t samples) {
+  tiles_per_task = tiles < 1 ? 1 : tiles;
+  samples_per_task = samples;
+}
+
+bool RenderCoordinator::listen(const std::string& address) {
+  return listener.listen(address);
+}
+
+bool RenderCoordinator::spawn_workers(const char* program, const int count,
+                                      const int threads) {
+#ifndef _WIN32
+  const std::string thread_count = std::to_string(threads);
+  for (int w = 0; w < count; w++) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+      TraceLog(LOG_ERROR, "Could not start a worker: %s", strerror(errno));
+      return false;
+    }
+
+    if (pid == 0) {
+      execlp(program, program, "--worker", listener.get_address().c_str(),
+             "--threads", thread_count.c_str(), (char*)nullptr);
+      _exit(127);
+    }
+    processes.push_back(pid);
+  }
+  return true;
+#else
+  TraceLog(LOG_ERROR, "Worker processes are not supported on this platform");
+  return false;
+#endif
+}
+
+void RenderCoordinator::stop_workers(const bool kill) {
+#ifndef _WIN32
+  for (const int pid : processes) {
+    if (kill) ::kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+  }
+#endif
+  processes.clear();
+}
+
+bool RenderCoordinator::render(const uint32_t samples_per_pixel,
+                               HeadlessRenderer& renderer) {
+  accumulation_buffer& accum = renderer.get_accumulation();
+  const tile_scheduler& scheduler = renderer.get_scheduler();
+  if (accum.get_width() != job.width || accum.get_height() != job.height) {
+    TraceLog(LOG_ERROR, "The renderer does not have the size of the job");
+    return false;
+  }
+  if (!listener.is_open()) {
+    TraceLog(LOG_ERROR, "The coordinator is not listening");
+    return false;
+  }
+
+  // Every run of tiles is split in ranges of samples
+  const uint32_t chunk =
+      samples_per_task > 0 ? samples_per_task : samples_per_pixel;
+  tasks.clear();
+  pixel_counts.clear();
+  for (size_t first = 0; first < scheduler.tile_count();
+       first += tiles_per_task) {
+    const size_t count =
+        std::min(tiles_per_task, scheduler.tile_count() - first);
+    size_t pixels = 0;
+    for (size_t t = first; t < first + count; t++)
+      pixels += scheduler.get_tile(t).pixel_count();
+
+    for (uint32_t s = 0; s < samples_per_pixel; s += chunk) {
+      tasks.push_back({(uint32_t)first, (uint32_t)count, s,
+                       std::min(chunk, samples_per_pixel - s)});
+      pixel_counts.push_back(pixels);
+    }
+  }
+
+  results.assign(tasks.size(), std::vector<uint32_t>());
+  pending.clear();
+  for (size_t i = 0; i < tasks.size(); i++) pending.push_back(i);
+  remaining = tasks.size();
+  aborted = false;
+  reassigned = 0;
+  raw_bytes = 0;
+  compressed_bytes = 0;
+  workers_seen = 0;
+
+  // Accept workers until every task has a result
+  std::vector<std::thread> threads;
+  auto idle_since = Clock::now();
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (remaining == 0) break;
+    }
+
+    socket_connection connection;
+    if (listener.accept(connection, 100)) {
+      connection.set_timeout(worker_timeout);
+      connected++;
+      workers_seen++;
+      threads.emplace_back(&RenderCoordinator::serve, this,
+                           std::move(connection));
+      continue;
+    }
+
+    if (connected > 0) {
+      idle_since = Clock::now();
+    } else if (std::chrono::duration_cast<Secondsf>(Clock::now() -
+                                                    idle_since)
+                   .count() > worker_timeout) {
+      TraceLog(LOG_ERROR, "No worker left to render the remaining %d tasks",
+               (int)remaining);
+      std::lock_guard<std::mutex> lock(mutex);
+      aborted = true;
+      changed.notify_all();
+      break;
+    }
+  }
+
+  for (std::thread& thread : threads) thread.join();
+  stop_workers(aborted);
+  if (aborted) return false;
+
+  // In task order, whatever the order in which the results arrived
+  accum.reset();
+  for (size_t i = 0; i < tasks.size(); i++) {
+    const std::vector<uint32_t>& words = results[i];
+    const size_t count = pixel_counts[i];
+    size_t p = 0;
+    for_each_task_pixel(
+        scheduler, tasks[i].first_tile, tasks[i].tile_count,
+        [&](const int x, const int y) {
+          const vec3 sum(bits_float(words[p]), bits_float(words[count + p]),
+                         bits_float(words[2 * count + p]));
+          accum.add_samples(y * job.width + x, sum,
+                            bits_float(words[3 * count + p]),
+                            words[4 * count + p]);
+          p++;
+        });
+  }
+  results.clear();
+
+  return true;
+}
+
+void RenderCoordinator::serve(socket_connection connection) {
+  uint32_t version = 0;
+  if (!receive_fixed(connection, message_type::hello, version) ||
+      version != protocol_version ||
+      !send_message(connection, message_type::job, &job, sizeof(job))) {
+    TraceLog(LOG_WARNING, "A worker could not join the render");
+    connected--;
+    return;
+  }
+
+  size_t index;
+  while (take_task(index)) {
+    const render_task& t = tasks[index];
+    const task_message request = {(uint32_t)index, t.first_tile,
+                                  t.tile_count, t.first_sample, t.samples};
+    const size_t expected = words_per_pixel * pixel_counts[index] * 4;
+
+    message_type type;
+    std::vector<unsigned char> payload;
+    result_message header;
+    bool valid =
+        send_message(connection, message_type::task, &request,
+                     sizeof(request)) &&
+        receive_message(connection, type, payload) &&
+        type == message_type::result && payload.size() >= sizeof(header);
+    if (valid) {
+      memcpy(&header, payload.data(), sizeof(header));
+      valid = header.index == index && header.raw_size == expected;
+    }
+
+    std::vector<uint32_t> words;
+    if (valid) {
+      const unsigned char* data = payload.data() + sizeof(header);
+      const int size = (int)(payload.size() - sizeof(header));
+      if (header.compressed) {
+        int decompressed_size = 0;
+        unsigned char* decompressed =
+            DecompressData(data, size, &decompressed_size);
+        valid = decompressed && (size_t)decompressed_size == expected;
+        if (valid) words = unshuffle(decompressed, expected / 4);
+        if (decompressed) MemFree(decompressed);
+      } else {
+        valid = (size_t)size == expected;
+        if (valid) words = unshuffle(data, expected / 4);
+      }
+    }
+
+    if (!valid) {
+      TraceLog(LOG_WARNING, "A worker failed, task %d is given to another",
+               (int)index);
+      give_back(index);
+      connected--;
+      return;
+    }
+
+    raw_bytes += expected;
+    compressed_bytes += payload.size() - sizeof(header);
+    finish(index, std::move(words));
+  }
+
+  send_message(connection, message_type::done, nullptr, 0);
+  connected--;
+}
+
+bool RenderCoordinator::take_task(size_t& index) {
+  std::unique_lock<std::mutex> lock(mutex);
+  // A task in flight may still come back if its worker fails
+  changed.wait(lock,
+               [&] { return !pending.empty() || remaining == 0 || aborted; });
+  if (pending.empty() || aborted) return false;
+
+  index = pending.front();
+  pending.pop_front();
+  return true;
+}
+
+void RenderCoordinator::give_back(const size_t index) {
+  std::lock_guard<std::mutex> lock(mutex);
+  pending.push_front(index);
+  reassigned++;
+  changed.notify_all();
+}
+
+void RenderCoordinator::finish(const size_t index,
+                               std::vector<uint32_t>&& result) {
+  std::lock_guard<std::mutex> lock(mutex);
+  results[index] = std::move(result);
+  remaining--;
+  if (remaining == 0) changed.notify_all();
+}
+
+bool RenderWorker::run(const std::string& address) {
+  tasks_done = 0;
+
+  socket_connection connection;
+  render_job job;
+  if (!connection.connect(address) ||
+      !send_message(connection, message_type::hello, &protocol_version,
+                    sizeof(protocol_version)) ||
+      !receive_fixed(connection, message_type::job, job) || job.width <= 0 ||
+      job.height <= 0) {
+    TraceLog(LOG_ERROR, "Could not join the render of %s", address.c_str());
+    return false;
+  }
+
+  hittable_list world = make_scene(job.scene);
+  HeadlessRenderer renderer(job.width, job.height, job.max_depth);
+  renderer.set_world(&world);
+  renderer.set_threads(threads);
+  renderer.set_russian_roulette_depth(job.rr_depth);
+  renderer.set_packet_size(job.packet_size);
+  renderer.set_sampler(job.sampling);
+  renderer.set_deterministic(job.deterministic != 0, job.seed);
+
+  const accumulation_buffer& accum = renderer.get_accumulation();
+  const tile_scheduler& scheduler = renderer.get_scheduler();
+
+  size_t received = 0;
+  while (true) {
+    message_type type;
+    std::vector<unsigned char> payload;
+    if (!receive_message(connection, type, payload)) return false;
+    if (type == message_type::done) return true;
+
+    task_message task;
+    if (type != message_type::task || payload.size() != sizeof(task))
+      return false;
+    memcpy(&task, payload.data(), sizeof(task));
+    if (task.first_tile + task.tile_count > scheduler.tile_count())
+      return false;
+
+    if (drop_after > 0 && ++received >= drop_after) return false;
+
+    renderer.render_tiles(task.first_tile, task.tile_count,
+                          task.first_sample, task.samples);
+
+    // One plane per channel, then byte shuffled, see shuffle()
+    size_t count = 0;
+    for (uint32_t t = task.first_tile; t < task.first_tile + task.tile_count;
+         t++)
+      count += scheduler.get_tile(t).pixel_count();
+    std::vector<uint32_t> words(words_per_pixel * count);
+    size_t p = 0;
+    for_each_task_pixel(
+        scheduler, task.first_tile, task.tile_count,
+        [&](const int x, const int y) {
+          const int index = y * job.width + x;
+          const vec3& sum = accum.get_sum(index);
+          words[p] = float_bits(sum.r());
+          words[count + p] = float_bits(sum.g());
+          words[2 * count + p] = float_bits(sum.b());
+          words[3 * count + p] =
+              float_bits(accum.get_luminance_sq_sum(index));
+          words[4 * count + p] = accum.get_samples(index);
+          p++;
+        });
+
+    const std::vector<unsigned char> raw = shuffle(words);
+    int compressed_size = 0;
+    unsigned char* compressed =
+        CompressData(raw.data(), (int)raw.size(), &compressed_size);
+    const bool use_compressed =
+        compressed && (size_t)compressed_size < raw.size();
+
+    const result_message header = {task.index, (uint32_t)raw.size(),
+                                   use_compressed ? 1u : 0u};
+    std::vector<unsigned char> message(sizeof(header));
+    memcpy(message.data(), &header, sizeof(header));
+    if (use_compressed)
+      message.insert(message.end(), compressed, compressed + compressed_size);
+    else
+      message.insert(message.end(), raw.begin(), raw.end());
+    if (compressed) MemFree(compressed);
+
+    if (!send_message(connection, message_type::result, message.data(),
+                      message.size()))
+      return false;
+    tasks_done++;
+  }
+}
@@ -0,0 +1,347 @@
+/**
+ * @file HeadlessRenderer.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the HeadlessRenderer class
+ * @version 0.1
+ * @date 2024-10-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "HeadlessRenderer.hpp"
+
+#include <atomic>
+#include <numeric>
+
+#include "objects/bvh.hpp"
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+HeadlessRenderer::HeadlessRenderer(const int screen_width,
+                                   const int screen_height,
+                                   const size_t max_depth)
+    : screen_width(screen_width),
+      screen_height(screen_height),
+      world(nullptr),
+      cam(screen_width, screen_height, max_depth),
+      scheduler(screen_width, screen_height, 16, tile_order::scanline),
+      accum(screen_width, screen_height),
+      features(screen_width, screen_height),
+      aovs(screen_width, screen_height) {}
+
+void HeadlessRenderer::set_threads(const int threads) {
+#ifdef USE_OPENMP
+  if (threads > 0) omp_set_num_threads(threads);
+#endif
+}
+
+void HeadlessRenderer::set_adaptive(const float error_threshold,
+                                    const uint32_t min_samples,
+                                    const uint32_t max_samples) {
+  adaptive_enabled = error_threshold > 0;
+  adaptive.set_error_threshold(error_threshold);
+  adaptive.set_min_samples(min_samples < 2 ? 2 : min_samples);
+  adaptive.set_max_samples(max_samples);
+}
+
+void HeadlessRenderer::set_aovs(const aov_set passes) {
+  aovs.set_passes(passes);
+  bvh_counts_visits() = aovs.has(aov_type::bvh_visits);
+}
+
+void HeadlessRenderer::set_checkpoint(const std::string& path,
+                                      const uint64_t scene_key,
+                                      const float interval_seconds) {
+  checkpoint_path = path;
+  checkpoint_scene = scene_key;
+  checkpoint_interval = interval_seconds;
+}
+
+void HeadlessRenderer::render(const int samples_per_pixel) {
+  const auto start_time = Clock::now();
+
+  accum.reset();
+  features.reset();
+  aovs.reset();
+  scheduler.activate_all_tiles();
+  rays_sent = 0;
+  rays_traced = 0;
+  denoise_duration = 0;
+  resumed_samples = 0;
+
+  if (use_wavefront && aovs.any())
+    TraceLog(LOG_WARNING,
+             "The render passes need the path integrator, the wavefront "
+             "integrator is not used");
+
+  if (!checkpoint_path.empty() && adaptive_enabled)
+    TraceLog(LOG_WARNING, "Checkpoints are not used with adaptive sampling");
+
+  if (!checkpoint_path.empty() && !adaptive_enabled) {
+    render_with_checkpoint(samples_per_pixel);
+  } else if (!adaptive_enabled) {
+    render_pass(samples_per_pixel, scheduler.active_tile_count());
+  } else {
+    // The total number of samples is the budget, the adaptive passes move it
+    // from the converged tiles to the noisy ones
+    const size_t budget =
+        (size_t)screen_width * screen_height * samples_per_pixel;
+    const uint32_t first_pass =
+        std::min<uint32_t>(adaptive.get_min_samples(), samples_per_pixel);
+    const uint32_t step = std::max<uint32_t>(1, first_pass / 2);
+
+    render_pass(first_pass, scheduler.active_tile_count());
+
+    while (rays_sent < budget && adaptive.update(scheduler, accum) > 0) {
+      // Only hand out the (noisiest) tiles that fit in the remaining budget
+      const size_t remaining = budget - rays_sent;
+      size_t planned = 0;
+      size_t tiles = 0;
+      while (tiles < scheduler.active_tile_count() && planned < remaining)
+        planned += scheduler.get_active_tile(tiles++).pixel_count() * step;
+
+      render_pass(step, tiles);
+    }
+  }
+
+  if (denoise_enabled) {
+    const auto denoise_start = Clock::now();
+    filter.denoise(accum, features, pixels);
+    denoise_duration = std::chrono::duration_cast<Secondsf>(Clock::now() -
+                                                            denoise_start)
+                           .count();
+  }
+
+  render_duration =
+      std::chrono::duration_cast<Secondsf>(Clock::now() - start_time).count();
+}
+
+void HeadlessRenderer::render_tiles(const size_t first_tile,
+                                    const size_t tile_count,
+                                    const uint32_t first_sample,
+                                    const uint32_t samples_per_pixel) {
+  const auto start_time = Clock::now();
+
+  accum.reset();
+  features.reset();
+  aovs.reset();
+  rays_sent = 0;
+  rays_traced = 0;
+  denoise_duration = 0;
+
+  std::vector<size_t> tiles(tile_count);
+  std::iota(tiles.begin(), tiles.end(), first_tile);
+  scheduler.set_active_tiles(std::move(tiles));
+
+  sample_offset = first_sample;
+  render_pass(samples_per_pixel, tile_count);
+  sample_offset = 0;
+
+  render_duration =
+      std::chrono::duration_cast<Secondsf>(Clock::now() - start_time).count();
+}
+
+void HeadlessRenderer::render_pass(const uint32_t samples_per_pixel,
+                                   const size_t tiles) {
+  // The wavefront integrator numbers the samples from the buffer only
+  if (use_wavefront && !aovs.any() && sample_offset == 0) {
+    render_pass_wavefront(samples_per_pixel, tiles);
+    return;
+  }
+
+  std::atomic<size_t> total_path_length(0);
+  std::atomic<size_t> total_samples(0);
+
+  scheduler.dispatch(0, tiles, [&](const tile& t) {
+    size_t tile_path_length = 0;
+
+    scheduler.for_each_pixel_group(
+        t, packet_size, [&](const int* xs, const int* ys, const int count) {
+          float i[ray_packet::max_size];
+          float j[ray_packet::max_size];
+          sampler samplers[ray_packet::max_size];
+          vec3 samples[ray_packet::max_size];
+          size_t path_lengths[ray_packet::max_size];
+          pixel_features hits[ray_packet::max_size];
+          pixel_features* first_hits =
+              denoise_enabled || aovs.any() ? hits : nullptr;
+
+          vec3 colors[ray_packet::max_size];
+          float luminance_sq[ray_packet::max_size];
+          uint32_t kept[ray_packet::max_size];
+          pixel_features hit_sums[ray_packet::max_size];
+          for (int p = 0; p < count; p++) {
+            samplers[p] = sampler(sampling, seed, deterministic);
+            colors[p] = vec3(0, 0, 0);
+            luminance_sq[p] = 0;
+            kept[p] = 0;
+            hit_sums[p] = pixel_features::zero();
+          }
+
+          for (uint32_t s = 0; s < samples_per_pixel; s++) {
+            for (int p = 0; p < count; p++) {
+              const int index = ys[p] * screen_width + xs[p];
+              samplers[p].start_pixel_sample(
+                  index, sample_offset + accum.get_samples(index) + s);
+
+              float u, v;
+              samplers[p].get_2d(u, v);
+              i[p] = xs[p] + u - 0.5f;
+              j[p] = ys[p] + v - 0.5f;
+            }
+
+            cam.send_packet(world, i, j, count, samplers, samples,
+                            path_lengths, first_hits);
+
+            if (aovs.any()) {
+              for (int p = 0; p < count; p++) {
+                aov_sample sample;
+                sample.first_hit = hits[p];
+                sample.path_length = path_lengths[p];
+                sample.bvh_visits = hits[p].bvh_visits;
+                aovs.add_sample(ys[p] * screen_width + xs[p], sample);
+              }
+            }
+
+            for (int p = 0; p < count; p++) {
+              accumulation_buffer::accumulate(samples[p], colors[p],
+                                              luminance_sq[p], kept[p]);
+              tile_path_length += path_lengths[p];
+            }
+
+            if (denoise_enabled)
+              for (int p = 0; p < count; p++) hit_sums[p] += hits[p];
+          }
+
+          for (int p = 0; p < count; p++) {
+            const int index = ys[p] * screen_width + xs[p];
+            accum.add_samples(index, colors[p], luminance_sq[p], kept[p]);
+            if (denoise_enabled)
+              features.add_samples(index, hit_sums[p], samples_per_pixel);
+          }
+        });
+
+    total_path_length += tile_path_length;
+    total_samples += (size_t)t.pixel_count() * samples_per_pixel;
+  });
+
+  rays_sent += total_samples;
+  rays_traced += total_path_length;
+}
+
+void HeadlessRenderer::render_pass_wavefront(const uint32_t samples_per_pixel,
+                                             const size_t tiles) {
+  // The tiles are flattened into one list of pixels, in the order in which
+  // the tiles would have been rendered
+  std::vector<int> indices;
+  for (size_t pos = 0; pos < tiles; pos++)
+    scheduler.for_each_pixel(scheduler.get_active_tile(pos),
+                             [&](const int x, const int y) {
+                               indices.push_back(y * screen_width + x);
+                             });
+
+  rays_traced += wavefront.render(cam, world, indices, samples_per_pixel,
+                                  accum,
+                                  denoise_enabled ? &features : nullptr);
+  rays_sent += indices.size() * samples_per_pixel;
+}
+
+void HeadlessRenderer::render_with_checkpoint(
+    const uint32_t samples_per_pixel) {
+  checkpoint_file checkpoint;
+  if (!checkpoint.open(checkpoint_path, checkpoint_config_hash(),
+                       screen_width, screen_height)) {
+    TraceLog(LOG_WARNING, "Rendering without a checkpoint");
+    render_pass(samples_per_pixel, scheduler.active_tile_count());
+    return;
+  }
+
+  resumed_samples = checkpoint.get_samples_done();
+  if (resumed_samples > 0) {
+    checkpoint.load(accum, features);
+    TraceLog(LOG_INFO, "Resuming %s at %d samples per pixel",
+             checkpoint_path.c_str(), (int)resumed_samples);
+  }
+
+  // Passes of a fixed number of samples, aligned on multiples of it, so that
+  // the passes do not depend on when the render was interrupted. The
+  // samplers number the samples from the counts of the buffer, a resumed
+  // render carries on with the next sample.
+  const uint32_t pass_samples = 4;
+  auto last_save = Clock::now();
+  for (uint32_t done = resumed_samples; done < samples_per_pixel;) {
+    const uint32_t next = std::min(samples_per_pixel,
+                                   (done / pass_samples + 1) * pass_samples);
+    render_pass(next - done, scheduler.active_tile_count());
+    done = next;
+
+    const bool last = done == samples_per_pixel;
+    if (last) checkpoint.wait();
+    if (last || std::chrono::duration_cast<Secondsf>(Clock::now() - last_save)
+                        .count() >= checkpoint_interval) {
+      // Skipped while the previous save is still being written
+      if (checkpoint.save(accum, features, done)) last_save = Clock::now();
+    }
+  }
+
+  checkpoint.wait();
+}
+
+uint64_t HeadlessRenderer::checkpoint_config_hash() {
+  checkpoint_hash hash;
+  hash.add(checkpoint_scene)
+      .add(screen_width)
+      .add(screen_height)
+      .add(cam.get_max_depth())
+      .add(cam.get_russian_roulette_depth())
+      .add(sampling)
+      .add(seed)
+      .add(deterministic);
+
+  if (world) {
+    const aabb box = world->bounding_box();
+    hash.add(box.x.min).add(box.x.max).add(box.y.min).add(box.y.max);
+    hash.add(box.z.min).add(box.z.max);
+  }
+
+  // The camera rays through two corners pin its position and orientation
+  for (const float corner : {0.0f, 1.0f}) {
+    sampler s(sampling, seed, true);
+    s.start_pixel_sample(0, 0);
+    const ray r = cam.get_ray(corner * screen_width, corner * screen_height, s);
+    hash.add(r.origin().e).add(r.direction().e);
+  }
+
+  return hash.get();
+}
+
+bool HeadlessRenderer::save(const char* filename) {
+  // The denoised image was already resolved by render()
+  if (!denoise_enabled) accum.resolve(pixels);
+
+  Image image = {pixels.data(), screen_width, screen_height, 1,
+                 PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+  return ExportImage(image, filename);
+}
+
+bool HeadlessRenderer::save_heatmap(const char* filename) {
+  std::vector<Color> heatmap;
+  accum.resolve_heatmap(heatmap);
+
+  Image image = {heatmap.data(), screen_width, screen_height, 1,
+                 PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+  return ExportImage(image, filename);
+}
+
+float HeadlessRenderer::get_average_path_length() const {
+  if (rays_sent == 0) return 0;
+  return (float)rays_traced / rays_sent;
+}
+
+float HeadlessRenderer::get_mrays_per_second() const {
+  if (render_duration <= 0) return 0;
+  return rays_traced / render_duration / 1e6f;
+}
@@ -11,23 +11,31 @@
 
 #include "Window.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 
 RaytraceWindow::RaytraceWindow(const int screen_width, const int screen_height,
                                const char* title)
-    : screen_width(screen_width), screen_height(screen_height) {
+    : screen_width(screen_width),
+      screen_height(screen_height),
+      engine(screen_width, screen_height) {
   InitWindow(screen_width, screen_height, title);
   SetTargetFPS(target_fps);
 
-  shuffled_index_array = std::vector<int>(screen_width * screen_height);
-  std::iota(shuffled_index_array.begin(), shuffled_index_array.end(), 0);
-  shuffle_indices(shuffled_index_array, 0);
-
-  reset_pixels();
   cam = camera(screen_width, screen_height, 10);
+  engine.set_target_fps((float)target_fps);
+  engine.set_temporal(true);
+
+  // The texture lives as long as the window, the frames are uploaded into it
+  Image image = GenImageColor(screen_width, screen_height, BLACK);
+  texture = LoadTextureFromImage(image);
+  UnloadImage(image);
 }
 
 RaytraceWindow::~RaytraceWindow() {
+  engine.stop();
+  UnloadTexture(texture);
   CloseWindow();
   cam.~camera();
 }
@@ -35,6 +43,10 @@ RaytraceWindow::~RaytraceWindow() {
 void RaytraceWindow::draw() {
   auto last = Clock::now();
 
+  // The engine traces in the background, this loop only handles the input
+  // and shows the latest published frame
+  engine.start(world, cam);
+
   while (!WindowShouldClose()) {
     // ---- Calculate necessary information ----
 
@@ -42,137 +54,111 @@ void RaytraceWindow::draw() {
     const auto now = Clock::now();
     float dt = std::chrono::duration_cast<Secondsf>(now - last).count();
     last = now;
+    frame_time = dt;
 
     // Activate or deactivate camera movement using the space key
     if (IsKeyPressed(KEY_SPACE)) cam.is_moving = !cam.is_moving;
-    if (IsKeyPressed(KEY_R)) reset_pixels();
+    if (IsKeyPressed(KEY_R)) engine.reset();
     if (IsKeyPressed(KEY_P)) TakeScreenshot("screenshot.png");
-
-    if (cam.update_state(dt)) reset_pixels();
-
-    int rays_to_send = 0;
-    {
-      // Calculate the time it takes to send a ray
-      const float ray_duration = get_ray_random_duration();
-
-      // Calculate how many rays we can send in the time it takes to send one
-      rays_to_send = (int)(1.0 / ray_duration / target_fps);
-
-      // If we can't send at least one ray per frame, send one
-      if (rays_to_send < 1) rays_to_send = 1;
-
-#ifdef USE_OPENMP
-      rays_to_send *= omp_get_max_threads();
-#endif
+    if (IsKeyPressed(KEY_I)) show_stats = !show_stats;
+    if (IsKeyPressed(KEY_H)) {
+      show_heatmap = !show_heatmap;
+      engine.set_heatmap(show_heatmap);
     }
-
-    const bool is_done = current_renders >= max_renders + 1;
-    if (!is_done) {
-      const int end_index =
-          start_index + rays_to_send >= shuffled_index_array.size()
-              ? (int)shuffled_index_array.size()
-              : start_index + rays_to_send;
-// Calculate each pixel color
-// If we are using OpenMP, we can parallelize the loop
-#ifdef USE_OPENMP
-#pragma omp parallel for schedule(dynamic)
-#endif
-      for (int f = start_index; f < end_index; f++) {
-        const int index = shuffled_index_array[f];
-        float j = index / screen_width + random_float() - 0.5f;
-        float i = index % screen_width + random_float() - 0.5f;
-
-        vec3 color = cam.send_ray(world, i, j);
-
-        // We already calculate everything in float, so we just do gamma
-        // correction before putting it integer format
-        // Linear to Gamma: 255 * pow(linearvalue / 255 (if in Color), 1 / 2.2)
-        color.e[0] = pow(color.r(), 1 / 2.2f);
-        color.e[1] = pow(color.g(), 1 / 2.2f);
-        color.e[2] = pow(color.b(), 1 / 2.2f);
-
-        const vec3 old_color =
-            vec3(pixels[index].r, pixels[index].g, pixels[index].b) / 255.0f;
-
-        const float weight = 1.0f / (current_renders + 1);
-        color = (1 - weight) * old_color + weight * color;
-
-        pixels[index] = color.to_color(255);
-      }
-
-      start_index = end_index;
-
-      if (start_index >= shuffled_index_array.size()) {
-        start_index = 0;
-        current_renders++;
-
-        TraceLog(LOG_INFO, "Render %d/%d", current_renders, max_renders);
+    if (IsKeyPressed(KEY_N)) {
+      denoise = !denoise;
+      engine.set_denoise(denoise);
+    }
+    if (IsKeyPressed(KEY_T)) {
+      // Cycle through the tile orders, random gives the old progressive look
+      switch (order) {
+        case tile_order::spiral:
+          order = tile_order::random;
+          break;
+        case tile_order::random:
+          order = tile_order::scanline;
+          break;
+        case tile_order::scanline:
+          order = tile_order::spiral;
+          break;
       }
+      engine.set_tile_order(order);
     }
 
+    if (cam.update_state(dt)) engine.set_camera(cam);
+
     BeginDrawing();
 
     // Clear the screen
     ClearBackground(BLACK);
 
-    // Generate the texture with the newly calculated pixels if the process is
-    // not done or draw the texture if it is
-    !is_done ? draw_pixels() : DrawTexture(texture, 0, 0, WHITE);
+    draw_pixels();
+
+    if (show_stats) draw_stats();
 
     EndDrawing();
   }
+
+  engine.stop();
 }
 
 void RaytraceWindow::draw_pixels() {
-  // Generate an image with a blank (transparent) background
-  Image image = GenImageColor(screen_width, screen_height, BLANK);
-  Color* image_pixels = (Color*)image.data;
-
-  // Loop through each pixel
-  for (int j = 0; j < screen_height; j++)
-    for (int i = 0; i < screen_width; i++)
-      image_pixels[j * screen_width + i] = pixels[j * screen_width + i];
+  // Upload the tiles the engine published since the last frame
+  engine.read_frame([this](const std::vector<Color>& frame,
+                           const std::vector<tile>& dirty) {
+    size_t dirty_pixels = 0;
+    for (const tile& t : dirty) dirty_pixels += t.pixel_count();
+
+    // Past half of the image, one upload is cheaper than many small ones
+    if (2 * dirty_pixels >= frame.size()) {
+      UpdateTexture(texture, frame.data());
+      return;
+    }
 
-  SetTraceLogLevel(LOG_NONE);  // Disable logging as it will be spammed
-  // Load texture from the updated image data
-  if (texture.id > 0)
-    UnloadTexture(texture);  // Unload previous texture if exists
+    for (const tile& t : dirty) {
+      // The rows of a tile are not contiguous in the frame
+      const int width = t.x1 - t.x0;
+      staging.resize(t.pixel_count());
+      for (int y = t.y0; y < t.y1; y++)
+        std::copy(frame.begin() + y * screen_width + t.x0,
+                  frame.begin() + y * screen_width + t.x1,
+                  staging.begin() + (y - t.y0) * width);
+
+      const Rectangle rec = {(float)t.x0, (float)t.y0, (float)width,
+                             (float)(t.y1 - t.y0)};
+      UpdateTextureRec(texture, rec, staging.data());
+    }
+  });
 
-  texture = LoadTextureFromImage(image);
-  // Unload image from CPU memory
-  UnloadImage(image);
   // Draw the texture on the screen
   DrawTexture(texture, 0, 0, WHITE);
-  SetTraceLogLevel(LOG_ALL);  // Reset log level
 }
 
-void RaytraceWindow::reset_pixels() {
-  const int total_pixels = screen_width * screen_height;
-  // All pixels related to the window
-  if (pixels.size() != total_pixels) pixels.resize(total_pixels);
-
-  // Make every pixel black
-  for (int i = 0; i < total_pixels; i++) pixels[i] = Color{0, 0, 0, 255};
-
-  start_index = 0;
-  current_renders = 0;
-}
-
-float RaytraceWindow::get_ray_random_duration() {
-  auto start_time = Clock::now();
-  cam.send_ray(world, (float)GetRandomValue(0, screen_width),
-               (float)GetRandomValue(0, screen_height));
-  return std::chrono::duration_cast<Secondsf>(Clock::now() - start_time)
-      .count();
-}
-
-void RaytraceWindow::shuffle_indices(std::vector<int>& indices,
-                                     int start_index) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-
-  for (size_t i = start_index; i < indices.size(); ++i) {
-    std::uniform_int_distribution<> dis((int)i, (int)indices.size() - 1);
-    std::swap(indices[i], indices[dis(gen)]);
-  }
+void RaytraceWindow::draw_stats() {
+  const render_stats stats = engine.get_stats();
+  char lines[7][64];
+  snprintf(lines[0], sizeof(lines[0]), "Frame: %.1f ms (%.0f fps)",
+           frame_time * 1000, frame_time > 0 ? 1 / frame_time : 0.0f);
+  snprintf(lines[1], sizeof(lines[1]), "Budget: %zu rays", stats.budget);
+  snprintf(lines[2], sizeof(lines[2]), "Sent: %zu rays in %.1f ms",
+           stats.achieved_rays, stats.batch_time * 1000);
+  snprintf(lines[3], sizeof(lines[3]), "Throughput: %.2f Mrays/s",
+           stats.rays_per_second / 1e6f);
+  snprintf(lines[4], sizeof(lines[4]), "Threads busy: %.0f%%",
+           stats.thread_utilization * 100);
+  if (stats.preview_scale > 0)
+    snprintf(lines[5], sizeof(lines[5]), "Preview at 1/%d resolution",
+             stats.preview_scale);
+  else
+    snprintf(lines[5], sizeof(lines[5]), "Pass %d, %zu/%zu tiles%s",
+             stats.passes, stats.active_tiles, stats.tile_count,
+             stats.done ? " (done)" : "");
+  if (denoise)
+    snprintf(lines[6], sizeof(lines[6]), "Denoise: %.1f ms",
+             stats.denoise_time * 1000);
+  else
+    snprintf(lines[6], sizeof(lines[6]), "Denoise: off (N)");
+
+  DrawRectangle(5, 5, 250, 7 * 20 + 10, Fade(BLACK, 0.6f));
+  for (int i = 0; i < 7; i++) DrawText(lines[i], 10, 10 + 20 * i, 18, WHITE);
 }
@@ -1,5 +1,7 @@
 #include "camera.hpp"
 
+#include "objects/bvh.hpp"
+
 camera::camera() {
   screen_height = 100;
   screen_width = 100;
@@ -16,36 +18,157 @@ camera::camera(const int screen_width, const int screen_height,
 }
 
 vec3 camera::send_ray(hittable_list* world, const float pixel_width,
-                      const float pixel_height) {
+                      const float pixel_height, sampler& s,
+                      size_t* path_length, pixel_features* features) {
+  size_t length = 0;
+  const vec3 color = ray_color(get_ray(pixel_width, pixel_height, s), world,
+                               s, length, features);
+  if (path_length) *path_length = length;
+  return color;
+}
+
+void camera::send_packet(hittable_list* world, const float* pixel_width,
+                         const float* pixel_height, const int count,
+                         sampler* samplers, vec3* colors,
+                         size_t* path_lengths, pixel_features* features) {
+  // A single ray gains nothing from the packet machinery
+  if (count == 1) {
+    colors[0] = send_ray(world, pixel_width[0], pixel_height[0], samplers[0],
+                         path_lengths ? &path_lengths[0] : nullptr,
+                         features);
+    return;
+  }
+
+  ray_packet packet;
+  for (int i = 0; i < count; i++)
+    packet.add(get_ray(pixel_width[i], pixel_height[i], samplers[i]));
+  packet.pad();
+
+  // The trees credit every ray with the nodes it was tested against
+  size_t* visits = bvh_ray_visit_counters();
+  std::fill(visits, visits + ray_packet::max_size, 0);
+
+  // Find the first hit of the whole packet, then follow every path alone
+  hit_record recs[ray_packet::max_size];
+  const uint32_t hits =
+      world->hit_packet(packet, packet.full_mask(), .0001f, recs);
+
+  for (int i = 0; i < count; i++) {
+    if (features) {
+      features[i] = first_hit_features(packet.rays[i], (hits >> i) & 1u,
+                                       recs[i]);
+      features[i].bvh_visits = visits[i];
+    }
+
+    size_t length = 0;
+    colors[i] = continue_path(packet.rays[i], (hits >> i) & 1u, recs[i],
+                              world, samplers[i], length);
+    if (path_lengths) path_lengths[i] = length;
+  }
+}
+
+ray camera::get_ray(const float pixel_width, const float pixel_height,
+                    sampler& s) const {
   auto pixel_center = pixel00_loc + (pixel_width * pixel_delta_u) +
                       (pixel_height * pixel_delta_v);
   auto ray_origin =
-      (defocus_angle <= 0) ? camera_position : defocus_disk_sample();
+      (defocus_angle <= 0) ? camera_position : defocus_disk_sample(s);
   auto ray_direction = pixel_center - camera_position;
-  ray r(ray_origin, ray_direction);
-  return ray_color(r, world, max_depth);
+  return ray(ray_origin, ray_direction);
+}
+
+bool camera::project_direction(const vec3& direction, float& pixel_width,
+                               float& pixel_height) const {
+  // Only directions in front of the camera cross the viewport
+  const float forward = dot(direction, w);
+  if (forward >= 0) return false;
+
+  // Where the direction crosses the viewport, relative to pixel 0, 0
+  const vec3 on_viewport =
+      camera_position + (-focus_dist / forward) * direction;
+  const vec3 offset = on_viewport - pixel00_loc;
+  pixel_width = dot(offset, pixel_delta_u) / pixel_delta_u.length_squared();
+  pixel_height = dot(offset, pixel_delta_v) / pixel_delta_v.length_squared();
+
+  return pixel_width >= -0.5f && pixel_width < screen_width - 0.5f &&
+         pixel_height >= -0.5f && pixel_height < screen_height - 0.5f;
+}
+
+vec3 camera::background(const ray& r) {
+  vec3 unit_direction = unit_vector(r.direction());
+  float t = 0.5f * (unit_direction.y() + 1.0f);
+  return (1.0f - t) * vec3(1.0f, 1.0f, 1.0f) + t * vec3(0.5f, 0.7f, 1.0f);
 }
 
-vec3 camera::ray_color(ray& r, hittable_list* world, const size_t depth) {
-  if (depth <= 0) {
-    return vec3(0, 0, 0);
+pixel_features camera::first_hit_features(const ray& r, const bool hit,
+                                          const hit_record& rec) {
+  pixel_features features;
+  if (hit) {
+    features.albedo = rec.mat_ptr->albedo(rec);
+    features.normal = rec.normal;
+    features.depth = rec.t * r.direction().length();
+    features.object = rec.object;
+    features.mat = rec.mat_ptr;
+  } else {
+    features.albedo = background(r);
+    features.normal = -unit_vector(r.direction());
   }
+  return features;
+}
+
+bool camera::russian_roulette(vec3& throughput, const size_t depth,
+                              sampler& s) const {
+  if (depth < rr_min_depth) return true;
+
+  const float survival = clamp(
+      std::max(throughput.r(), std::max(throughput.g(), throughput.b())),
+      0.05f, 1.0f);
+  if (survival >= 1.0f) return true;
+  s.start_bounce(depth, sampler::roulette_dimension);
+  if (s.get_1d() >= survival) return false;
 
+  throughput /= survival;
+  return true;
+}
+
+vec3 camera::ray_color(const ray& r, hittable_list* world, sampler& s,
+                       size_t& path_length, pixel_features* features) const {
   hit_record rec;
-  if (world->hit(r, interval(.0001f, infinity), rec)) {
+  const size_t visits = bvh_visit_counter();
+  const bool hit = world->hit(r, interval(.0001f, infinity), rec);
+  if (features) {
+    *features = first_hit_features(r, hit, rec);
+    features->bvh_visits = bvh_visit_counter() - visits;
+  }
+  return continue_path(r, hit, rec, world, s, path_length);
+}
+
+vec3 camera::continue_path(ray r, bool hit, hit_record rec,
+                           hittable_list* world, sampler& s,
+                           size_t& path_length) const {
+  vec3 throughput(1.0f, 1.0f, 1.0f);
+
+  for (size_t depth = 1; depth <= max_depth; depth++) {
+    path_length = depth;
+
+    // The ray escaped, so it picks up the sky color
+    if (!hit) return throughput * background(r);
+
     ray scattered;
     vec3 attenuation;
-    // If the ray scatters, recursively call the function
-    if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-      return attenuation * ray_color(scattered, world, depth - 1);
+    // If the ray does not scatter, it is absorbed
+    s.start_bounce(depth);
+    if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered, s)) break;
+
+    throughput *= attenuation;
+    r = scattered;
 
-    // If the ray does not scatter, return black
-    vec3(0, 0, 0);
+    if (!russian_roulette(throughput, depth, s)) break;
+
+    if (depth < max_depth) hit = world->hit(r, interval(.0001f, infinity), rec);
   }
 
-  vec3 unit_direction = unit_vector(r.direction());
-  float t = 0.5f * (unit_direction.y() + 1.0f);
-  return (1.0f - t) * vec3(1.0f, 1.0f, 1.0f) + t * vec3(0.5f, 0.7f, 1.0f);
+  return vec3(0, 0, 0);
 }
 
 void camera::initialize() {
@@ -140,7 +263,9 @@ bool camera::update_camera_orientation() {
   return true;
 }
 
-vec3 camera::defocus_disk_sample() const {
-  auto p = random_in_unit_disk();
+vec3 camera::defocus_disk_sample(sampler& s) const {
+  float u1, u2;
+  s.get_2d(u1, u2);
+  auto p = sample_in_unit_disk(u1, u2);
   return camera_position + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
 }
\ No newline at end of file
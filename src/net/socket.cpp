@@ -0,0 +1,290 @@
+/**
+ * @file socket.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the socket_connection and socket_listener classes
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "net/socket.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include "raylib.h"
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+
+namespace {
+
+const char unix_prefix[] = "unix:";
+
+bool is_unix_address(const std::string& address) {
+  return address.compare(0, sizeof(unix_prefix) - 1, unix_prefix) == 0;
+}
+
+// Fill a Unix socket address, false if the path does not fit
+bool unix_address(const std::string& address, sockaddr_un& result) {
+  const std::string path = address.substr(sizeof(unix_prefix) - 1);
+  if (path.empty() || path.size() >= sizeof(result.sun_path)) {
+    TraceLog(LOG_ERROR, "Invalid socket path %s", path.c_str());
+    return false;
+  }
+
+  memset(&result, 0, sizeof(result));
+  result.sun_family = AF_UNIX;
+  memcpy(result.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+// Resolve "host:port", the caller frees the list
+addrinfo* resolve(const std::string& address, const bool passive) {
+  const size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    TraceLog(LOG_ERROR, "Invalid address %s, expected host:port",
+             address.c_str());
+    return nullptr;
+  }
+
+  std::string host = address.substr(0, colon);
+  const std::string port = address.substr(colon + 1);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+    host = host.substr(1, host.size() - 2);
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (passive) hints.ai_flags = AI_PASSIVE;
+
+  addrinfo* result = nullptr;
+  const bool any_host = host.empty() || host == "*";
+  const int error = getaddrinfo(any_host ? nullptr : host.c_str(),
+                                port.c_str(), &hints, &result);
+  if (error != 0) {
+    TraceLog(LOG_ERROR, "Could not resolve %s: %s", address.c_str(),
+             gai_strerror(error));
+    return nullptr;
+  }
+  return result;
+}
+
+// Send small messages right away instead of waiting for more data
+void set_no_delay(const int descriptor) {
+  const int enabled = 1;
+  setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+}
+
+}  // namespace
+
+socket_connection::socket_connection(socket_connection&& other) noexcept
+    : descriptor(other.descriptor) {
+  other.descriptor = -1;
+}
+
+socket_connection& socket_connection::operator=(
+    socket_connection&& other) noexcept {
+  if (this != &other) {
+    close();
+    descriptor = other.descriptor;
+    other.descriptor = -1;
+  }
+  return *this;
+}
+
+bool socket_connection::connect(const std::string& address) {
+  close();
+
+  if (is_unix_address(address)) {
+    sockaddr_un target;
+    if (!unix_address(address, target)) return false;
+
+    descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (descriptor >= 0 &&
+        ::connect(descriptor, (const sockaddr*)&target, sizeof(target)) == 0)
+      return true;
+  } else {
+    addrinfo* candidates = resolve(address, false);
+    for (addrinfo* a = candidates; a; a = a->ai_next) {
+      descriptor = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (descriptor < 0) continue;
+      if (::connect(descriptor, a->ai_addr, a->ai_addrlen) == 0) break;
+      close();
+    }
+    if (candidates) freeaddrinfo(candidates);
+
+    if (descriptor >= 0) {
+      set_no_delay(descriptor);
+      return true;
+    }
+  }
+
+  TraceLog(LOG_ERROR, "Could not connect to %s: %s", address.c_str(),
+           strerror(errno));
+  close();
+  return false;
+}
+
+bool socket_connection::set_timeout(const float seconds) {
+  if (descriptor < 0) return false;
+
+  timeval timeout;
+  timeout.tv_sec = (time_t)seconds;
+  timeout.tv_usec = (suseconds_t)((seconds - (float)timeout.tv_sec) * 1e6f);
+  return setsockopt(descriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                    sizeof(timeout)) == 0 &&
+         setsockopt(descriptor, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                    sizeof(timeout)) == 0;
+}
+
+bool socket_connection::send_all(const void* data, const size_t size) {
+  // A peer that went away must not kill the process with SIGPIPE
+#ifdef MSG_NOSIGNAL
+  const int flags = MSG_NOSIGNAL;
+#else
+  const int flags = 0;
+  const int enabled = 1;
+  setsockopt(descriptor, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+
+  const char* bytes = (const char*)data;
+  size_t sent = 0;
+  while (sent < size) {
+    const ssize_t count = send(descriptor, bytes + sent, size - sent, flags);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    sent += (size_t)count;
+  }
+  return true;
+}
+
+bool socket_connection::receive_all(void* data, const size_t size) {
+  char* bytes = (char*)data;
+  size_t received = 0;
+  while (received < size) {
+    const ssize_t count = recv(descriptor, bytes + received, size - received,
+                               0);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    received += (size_t)count;
+  }
+  return true;
+}
+
+void socket_connection::close() {
+  if (descriptor < 0) return;
+  ::close(descriptor);
+  descriptor = -1;
+}
+
+bool socket_listener::listen(const std::string& new_address) {
+  close();
+
+  if (is_unix_address(new_address)) {
+    sockaddr_un local;
+    if (!unix_address(new_address, local)) return false;
+
+    unlink(local.sun_path);
+    descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (descriptor >= 0 &&
+        bind(descriptor, (const sockaddr*)&local, sizeof(local)) == 0)
+      unix_path = local.sun_path;
+    else
+      close();
+  } else {
+    addrinfo* candidates = resolve(new_address, true);
+    for (addrinfo* a = candidates; a; a = a->ai_next) {
+      descriptor = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (descriptor < 0) continue;
+
+      // Restarting the coordinator must not wait for the old port
+      const int enabled = 1;
+      setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &enabled,
+                 sizeof(enabled));
+      if (bind(descriptor, a->ai_addr, a->ai_addrlen) == 0) break;
+      close();
+    }
+    if (candidates) freeaddrinfo(candidates);
+  }
+
+  if (descriptor < 0 || ::listen(descriptor, 64) != 0) {
+    TraceLog(LOG_ERROR, "Could not listen on %s: %s", new_address.c_str(),
+             strerror(errno));
+    close();
+    return false;
+  }
+
+  address = new_address;
+  return true;
+}
+
+bool socket_listener::accept(socket_connection& connection,
+                             const int timeout_ms) {
+  if (descriptor < 0) return false;
+
+  pollfd waiting = {descriptor, POLLIN, 0};
+  if (poll(&waiting, 1, timeout_ms) <= 0) return false;
+
+  const int accepted = ::accept(descriptor, nullptr, nullptr);
+  if (accepted < 0) return false;
+
+  if (unix_path.empty()) set_no_delay(accepted);
+  connection = socket_connection(accepted);
+  return true;
+}
+
+void socket_listener::close() {
+  if (descriptor >= 0) ::close(descriptor);
+  descriptor = -1;
+
+  if (!unix_path.empty()) unlink(unix_path.c_str());
+  unix_path.clear();
+}
+
+#else  // _WIN32
+
+socket_connection::socket_connection(socket_connection&& other) noexcept
+    : descriptor(other.descriptor) {
+  other.descriptor = -1;
+}
+
+socket_connection& socket_connection::operator=(
+    socket_connection&& other) noexcept {
+  descriptor = other.descriptor;
+  other.descriptor = -1;
+  return *this;
+}
+
+bool socket_connection::connect(const std::string& address) {
+  TraceLog(LOG_ERROR, "Sockets are not supported on this platform");
+  return false;
+}
+
+bool socket_connection::set_timeout(const float) { return false; }
+bool socket_connection::send_all(const void*, const size_t) { return false; }
+bool socket_connection::receive_all(void*, const size_t) { return false; }
+void socket_connection::close() { descriptor = -1; }
+
+bool socket_listener::listen(const std::string& address) {
+  TraceLog(LOG_ERROR, "Sockets are not supported on this platform");
+  return false;
+}
+
+bool socket_listener::accept(socket_connection&, const int) { return false; }
+void socket_listener::close() { descriptor = -1; }
+
+#endif  // _WIN32
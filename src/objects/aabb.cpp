@@ -11,7 +11,115 @@
 
 #include "objects/aabb.hpp"
 
-const aabb aabb::empty =
-    aabb(interval::empty, interval::empty, interval::empty);
-const aabb aabb::universe =
-    aabb(interval::universe, interval::universe, interval::universe);
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Built from the bounds rather than from interval::empty and
+// interval::universe, which live in another translation unit and may not be
+// initialized yet
+const aabb aabb::empty = aabb(interval(+infinity, -infinity),
+                              interval(+infinity, -infinity),
+                              interval(+infinity, -infinity));
+const aabb aabb::universe = aabb(interval(-infinity, +infinity),
+                                 interval(-infinity, +infinity),
+                                 interval(-infinity, +infinity));
+
+uint32_t aabb::hit_packet(const ray_packet& packet, const uint32_t mask,
+                          const float t_min) const {
+  const float box_min[3] = {x.min, y.min, z.min};
+  const float box_max[3] = {x.max, y.max, z.max};
+  return hit_packet(box_min, box_max, packet, mask, t_min);
+}
+
+uint32_t aabb::hit_packet(const float box_min[3], const float box_max[3],
+                          const ray_packet& packet, const uint32_t mask,
+                          const float t_min) {
+  uint32_t result = 0;
+
+#if defined(__AVX__)
+  const __m256 lo[3] = {_mm256_set1_ps(box_min[0]),
+                        _mm256_set1_ps(box_min[1]),
+                        _mm256_set1_ps(box_min[2])};
+  const __m256 hi[3] = {_mm256_set1_ps(box_max[0]),
+                        _mm256_set1_ps(box_max[1]),
+                        _mm256_set1_ps(box_max[2])};
+
+  for (int lane = 0; lane < packet.size; lane += 8) {
+    if (!((mask >> lane) & 0xFFu)) continue;
+
+    __m256 t_near = _mm256_set1_ps(t_min);
+    __m256 t_far = _mm256_loadu_ps(packet.t_max + lane);
+    for (int axis = 0; axis < 3; axis++) {
+      const __m256 origin = _mm256_load_ps(packet.origin[axis] + lane);
+      const __m256 inv_dir = _mm256_load_ps(packet.inv_direction[axis] + lane);
+      const __m256 negative =
+          _mm256_cmp_ps(inv_dir, _mm256_setzero_ps(), _CMP_LT_OQ);
+      const __m256 near_plane = _mm256_blendv_ps(lo[axis], hi[axis], negative);
+      const __m256 far_plane = _mm256_blendv_ps(hi[axis], lo[axis], negative);
+      const __m256 t0 =
+          _mm256_mul_ps(_mm256_sub_ps(near_plane, origin), inv_dir);
+      const __m256 t1 =
+          _mm256_mul_ps(_mm256_sub_ps(far_plane, origin), inv_dir);
+      // maxps and minps return their second operand if one is a NaN
+      t_near = _mm256_max_ps(t0, t_near);
+      t_far = _mm256_min_ps(t1, t_far);
+    }
+
+    const int hits =
+        _mm256_movemask_ps(_mm256_cmp_ps(t_near, t_far, _CMP_LT_OQ));
+    result |= (uint32_t)hits << lane;
+  }
+#elif defined(__SSE2__)
+  const __m128 lo[3] = {_mm_set1_ps(box_min[0]), _mm_set1_ps(box_min[1]),
+                        _mm_set1_ps(box_min[2])};
+  const __m128 hi[3] = {_mm_set1_ps(box_max[0]), _mm_set1_ps(box_max[1]),
+                        _mm_set1_ps(box_max[2])};
+
+  for (int lane = 0; lane < packet.size; lane += 4) {
+    if (!((mask >> lane) & 0xFu)) continue;
+
+    __m128 t_near = _mm_set1_ps(t_min);
+    __m128 t_far = _mm_loadu_ps(packet.t_max + lane);
+    for (int axis = 0; axis < 3; axis++) {
+      const __m128 origin = _mm_load_ps(packet.origin[axis] + lane);
+      const __m128 inv_dir = _mm_load_ps(packet.inv_direction[axis] + lane);
+      const __m128 negative = _mm_cmplt_ps(inv_dir, _mm_setzero_ps());
+      const __m128 near_plane = _mm_or_ps(_mm_and_ps(negative, hi[axis]),
+                                          _mm_andnot_ps(negative, lo[axis]));
+      const __m128 far_plane = _mm_or_ps(_mm_and_ps(negative, lo[axis]),
+                                         _mm_andnot_ps(negative, hi[axis]));
+      const __m128 t0 = _mm_mul_ps(_mm_sub_ps(near_plane, origin), inv_dir);
+      const __m128 t1 = _mm_mul_ps(_mm_sub_ps(far_plane, origin), inv_dir);
+      // maxps and minps return their second operand if one is a NaN
+      t_near = _mm_max_ps(t0, t_near);
+      t_far = _mm_min_ps(t1, t_far);
+    }
+
+    const int hits = _mm_movemask_ps(_mm_cmplt_ps(t_near, t_far));
+    result |= (uint32_t)hits << lane;
+  }
+#else
+  for (int lane = 0; lane < packet.size; lane++) {
+    if (!(mask & (1u << lane))) continue;
+
+    float t_near = t_min;
+    float t_far = packet.t_max[lane];
+    for (int axis = 0; axis < 3; axis++) {
+      const float origin = packet.origin[axis][lane];
+      const float inv_dir = packet.inv_direction[axis][lane];
+      const bool negative = inv_dir < 0;
+      const float t0 =
+          ((negative ? box_max : box_min)[axis] - origin) * inv_dir;
+      const float t1 =
+          ((negative ? box_min : box_max)[axis] - origin) * inv_dir;
+      t_near = t0 > t_near ? t0 : t_near;
+      t_far = t1 < t_far ? t1 : t_far;
+    }
+
+    if (t_near < t_far) result |= 1u << lane;
+  }
+#endif
+
+  return result & mask;
+}
@@ -0,0 +1,535 @@
+/**
+ * @file bvh4.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the bvh4 class
+ * @version 0.1
+ * @date 2024-12-06
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "objects/bvh4.hpp"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Slab test of one ray against the four children of a node
+ *
+ * @param t_near Set to where the ray enters the box of every child
+ * @return int The mask of the children the ray enters between t_min and
+ * t_max
+ */
+inline int hit_children(const bvh4_node& node, const ray& r,
+                        const float t_min, const float t_max,
+                        float t_near[4]) {
+  const vec3& origin = r.origin();
+  const vec3& inv_dir = r.inv_direction();
+  int hits = 0;
+
+#if defined(__SSE2__)
+  __m128 t_enter = _mm_set1_ps(t_min);
+  __m128 t_exit = _mm_set1_ps(t_max);
+  for (int axis = 0; axis < 3; axis++) {
+    // The sign of the ray picks the near and far planes of all the children
+    const bool negative = r.is_negative(axis);
+    const float* near_plane =
+        negative ? node.bounds_max[axis] : node.bounds_min[axis];
+    const float* far_plane =
+        negative ? node.bounds_min[axis] : node.bounds_max[axis];
+    const __m128 o = _mm_set1_ps(origin[axis]);
+    const __m128 inv = _mm_set1_ps(inv_dir[axis]);
+    const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(near_plane), o), inv);
+    const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(far_plane), o), inv);
+    // maxps and minps return their second operand if one is a NaN
+    t_enter = _mm_max_ps(t0, t_enter);
+    t_exit = _mm_min_ps(t1, t_exit);
+  }
+  _mm_storeu_ps(t_near, t_enter);
+  hits = _mm_movemask_ps(_mm_cmplt_ps(t_enter, t_exit));
+#else
+  for (int c = 0; c < bvh4_node::width; c++) {
+    float t_enter = t_min;
+    float t_exit = t_max;
+    for (int axis = 0; axis < 3; axis++) {
+      const bool negative = r.is_negative(axis);
+      const float t0 =
+          ((negative ? node.bounds_max : node.bounds_min)[axis][c] -
+           origin[axis]) *
+          inv_dir[axis];
+      const float t1 =
+          ((negative ? node.bounds_min : node.bounds_max)[axis][c] -
+           origin[axis]) *
+          inv_dir[axis];
+      t_enter = t0 > t_enter ? t0 : t_enter;
+      t_exit = t1 < t_exit ? t1 : t_exit;
+    }
+    t_near[c] = t_enter;
+    if (t_enter < t_exit) hits |= 1 << c;
+  }
+#endif
+
+  // The unused children hold empty boxes, the mask drops them anyway
+  return hits & ((1 << node.child_count) - 1);
+}
+
+/**
+ * @brief Order the children a ray hits from the farthest to the nearest
+ *
+ * @param hits The mask of the children
+ * @param key The distance of every child
+ * @param order Set to the children, farthest first
+ * @return int The number of children
+ */
+inline int far_to_near(const int hits, const float key[4], int order[4]) {
+  int count = 0;
+  for (int c = 0; c < bvh4_node::width; c++) {
+    if (!(hits & (1 << c))) continue;
+
+    // Insertion sort, there are at most four
+    int i = count++;
+    while (i > 0 && key[order[i - 1]] < key[c]) {
+      order[i] = order[i - 1];
+      i--;
+    }
+    order[i] = c;
+  }
+  return count;
+}
+
+float surface_area(const float bounds_min[3], const float bounds_max[3]) {
+  const float dx = bounds_max[0] - bounds_min[0];
+  const float dy = bounds_max[1] - bounds_min[1];
+  const float dz = bounds_max[2] - bounds_min[2];
+  return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+}  // namespace
+
+bvh4::bvh4(const hittable_list& list, const bvh_build_options& options)
+    : options(options) {
+  build_tree(list);
+}
+
+void bvh4::build_tree(const hittable_list& list) {
+  nodes.clear();
+  primitives.clear();
+  parents.clear();
+  object_child.clear();
+  moved_children.clear();
+
+  const linear_bvh binary(list, options);
+  const std::vector<linear_bvh_node>& binary_nodes = binary.get_nodes();
+  object_index = binary.get_object_indices();
+  if (binary_nodes.empty()) return;
+
+  primitives = binary.get_primitives();
+  bbox = binary.bounding_box();
+  nodes.reserve(binary_nodes.size() / 2 + 1);
+
+  if (!binary_nodes[0].is_leaf()) {
+    collapse(binary_nodes, 0);
+  } else {
+    // A single leaf, under a root with one child
+    bvh4_node root;
+    for (int axis = 0; axis < 3; axis++) {
+      for (int c = 0; c < bvh4_node::width; c++) {
+        root.bounds_min[axis][c] = binary_nodes[0].bounds_min[axis];
+        root.bounds_max[axis][c] = binary_nodes[0].bounds_max[axis];
+      }
+    }
+    for (int c = 0; c < bvh4_node::width; c++) {
+      root.child[c] = binary_nodes[0].offset;
+      root.count[c] = binary_nodes[0].count;
+    }
+    root.child_count = 1;
+    nodes.push_back(root);
+  }
+
+  // What the refits need: the parent of every node, the child holding every
+  // object and the weighted area of the children
+  parents.assign(nodes.size(), 0);
+  object_child.assign(primitives.size(), 0);
+  weighted_area = 0;
+  for (uint32_t i = 0; i < (uint32_t)nodes.size(); i++) {
+    const bvh4_node& node = nodes[i];
+    for (uint32_t c = 0; c < node.child_count; c++) {
+      const float child_min[3] = {node.bounds_min[0][c], node.bounds_min[1][c],
+                                  node.bounds_min[2][c]};
+      const float child_max[3] = {node.bounds_max[0][c], node.bounds_max[1][c],
+                                  node.bounds_max[2][c]};
+      weighted_area +=
+          surface_area(child_min, child_max) * child_cost(node, c);
+      if (node.count[c] > 0) {
+        for (uint32_t p = 0; p < node.count[c]; p++)
+          object_child[object_index[node.child[c] + p]] =
+              i * bvh4_node::width + c;
+      } else {
+        parents[node.child[c]] = i;
+      }
+    }
+  }
+  float bounds_min[3], bounds_max[3];
+  root_bounds(bounds_min, bounds_max);
+  built_cost = (float)(options.traversal_cost +
+                       weighted_area / surface_area(bounds_min, bounds_max));
+}
+
+uint32_t bvh4::collapse(const std::vector<linear_bvh_node>& binary,
+                        const uint32_t node) {
+  // Start from the two children and open the largest inner child until
+  // there are four, the large boxes are the ones most rays enter
+  uint32_t gathered[bvh4_node::width] = {node + 1, binary[node].offset};
+  int count = 2;
+  while (count < bvh4_node::width) {
+    int largest = -1;
+    float largest_area = -1.0f;
+    for (int i = 0; i < count; i++) {
+      const linear_bvh_node& candidate = binary[gathered[i]];
+      if (candidate.is_leaf()) continue;
+
+      float extent[3];
+      for (int axis = 0; axis < 3; axis++)
+        extent[axis] = candidate.bounds_max[axis] - candidate.bounds_min[axis];
+      const float area = extent[0] * extent[1] + extent[1] * extent[2] +
+                         extent[2] * extent[0];
+      if (area > largest_area) {
+        largest_area = area;
+        largest = i;
+      }
+    }
+    if (largest < 0) break;
+
+    const uint32_t opened = gathered[largest];
+    gathered[largest] = opened + 1;
+    gathered[count++] = binary[opened].offset;
+  }
+
+  const uint32_t index = (uint32_t)nodes.size();
+  nodes.emplace_back();
+
+  // Filled aside, the recursion may move the nodes
+  bvh4_node wide;
+  for (int c = 0; c < bvh4_node::width; c++) {
+    for (int axis = 0; axis < 3; axis++) {
+      wide.bounds_min[axis][c] = +infinity;
+      wide.bounds_max[axis][c] = -infinity;
+    }
+    wide.child[c] = 0;
+    wide.count[c] = 0;
+  }
+  wide.child_count = count;
+
+  for (int c = 0; c < count; c++) {
+    const linear_bvh_node& child = binary[gathered[c]];
+    for (int axis = 0; axis < 3; axis++) {
+      wide.bounds_min[axis][c] = child.bounds_min[axis];
+      wide.bounds_max[axis][c] = child.bounds_max[axis];
+    }
+    if (child.is_leaf()) {
+      wide.child[c] = child.offset;
+      wide.count[c] = child.count;
+    } else {
+      wide.child[c] = collapse(binary, gathered[c]);
+    }
+  }
+
+  nodes[index] = wide;
+  return index;
+}
+
+void bvh4::root_bounds(float bounds_min[3], float bounds_max[3]) const {
+  const bvh4_node& root = nodes[0];
+  for (int axis = 0; axis < 3; axis++) {
+    bounds_min[axis] = +infinity;
+    bounds_max[axis] = -infinity;
+    for (uint32_t c = 0; c < root.child_count; c++) {
+      bounds_min[axis] = std::min(bounds_min[axis], root.bounds_min[axis][c]);
+      bounds_max[axis] = std::max(bounds_max[axis], root.bounds_max[axis][c]);
+    }
+  }
+}
+
+float bvh4::get_sah_cost() const {
+  if (nodes.empty()) return 0;
+
+  // The root is always visited, then every child a ray enters
+  float bounds_min[3], bounds_max[3];
+  root_bounds(bounds_min, bounds_max);
+  const float area = surface_area(bounds_min, bounds_max);
+  double cost = options.traversal_cost;
+  for (const bvh4_node& node : nodes) {
+    for (uint32_t c = 0; c < node.child_count; c++) {
+      const float child_min[3] = {node.bounds_min[0][c], node.bounds_min[1][c],
+                                  node.bounds_min[2][c]};
+      const float child_max[3] = {node.bounds_max[0][c], node.bounds_max[1][c],
+                                  node.bounds_max[2][c]};
+      cost += surface_area(child_min, child_max) / area * child_cost(node, c);
+    }
+  }
+  return (float)cost;
+}
+
+float bvh4::get_degradation() const {
+  if (nodes.empty()) return 1.0f;
+
+  float bounds_min[3], bounds_max[3];
+  root_bounds(bounds_min, bounds_max);
+  const float area = surface_area(bounds_min, bounds_max);
+  // A tree of flat or point objects has no area to compare
+  if (!(area > 0) || !(built_cost > 0)) return 1.0f;
+  return (float)(options.traversal_cost + weighted_area / area) / built_cost;
+}
+
+void bvh4::move(const vec3& offset) {
+  for (const shared_ptr<hittable>& primitive : primitives)
+    primitive->move(offset);
+
+  // Children come after their parent
+  for (size_t node = nodes.size(); node-- > 0;)
+    for (uint32_t c = 0; c < nodes[node].child_count; c++)
+      refit_child((uint32_t)node, c);
+  moved_children.clear();
+  finish_refit();
+}
+
+void bvh4::rotate(const vec3& axis, float angle) {
+  for (const shared_ptr<hittable>& primitive : primitives)
+    primitive->rotate(axis, angle);
+
+  for (size_t node = nodes.size(); node-- > 0;)
+    for (uint32_t c = 0; c < nodes[node].child_count; c++)
+      refit_child((uint32_t)node, c);
+  moved_children.clear();
+  finish_refit();
+}
+
+void bvh4::mark_moved(const size_t index) {
+  if (index < object_child.size())
+    moved_children.push_back(object_child[index]);
+}
+
+bool bvh4::refit() {
+  for (const uint32_t moved : moved_children) {
+    uint32_t node = moved / bvh4_node::width;
+    int c = moved % bvh4_node::width;
+
+    // Up to the root, or to the first child that keeps its box
+    while (refit_child(node, c) && node != 0) {
+      const bvh4_node& parent = nodes[parents[node]];
+      c = 0;
+      while (parent.count[c] > 0 || parent.child[c] != node) c++;
+      node = parents[node];
+    }
+  }
+  moved_children.clear();
+  return finish_refit();
+}
+
+void bvh4::rebuild() {
+  // The objects in the order of the list, so that they keep their indices
+  hittable_list list;
+  list.objects.resize(primitives.size());
+  for (size_t i = 0; i < primitives.size(); i++)
+    list.objects[object_index[i]] = primitives[i];
+
+  build_tree(list);
+}
+
+bool bvh4::refit_child(const uint32_t index, const int c) {
+  bvh4_node& node = nodes[index];
+
+  float bounds_min[3] = {+infinity, +infinity, +infinity};
+  float bounds_max[3] = {-infinity, -infinity, -infinity};
+  if (node.count[c] > 0) {
+    for (uint32_t i = 0; i < node.count[c]; i++) {
+      const aabb box = primitives[node.child[c] + i]->bounding_box();
+      for (int axis = 0; axis < 3; axis++) {
+        bounds_min[axis] =
+            std::min(bounds_min[axis], box.axis_interval(axis).min);
+        bounds_max[axis] =
+            std::max(bounds_max[axis], box.axis_interval(axis).max);
+      }
+    }
+  } else {
+    const bvh4_node& child = nodes[node.child[c]];
+    for (int axis = 0; axis < 3; axis++) {
+      for (uint32_t g = 0; g < child.child_count; g++) {
+        bounds_min[axis] =
+            std::min(bounds_min[axis], child.bounds_min[axis][g]);
+        bounds_max[axis] =
+            std::max(bounds_max[axis], child.bounds_max[axis][g]);
+      }
+    }
+  }
+
+  float old_min[3], old_max[3];
+  bool same = true;
+  for (int axis = 0; axis < 3; axis++) {
+    old_min[axis] = node.bounds_min[axis][c];
+    old_max[axis] = node.bounds_max[axis][c];
+    same = same && bounds_min[axis] == old_min[axis] &&
+           bounds_max[axis] == old_max[axis];
+  }
+  if (same) return false;
+
+  weighted_area +=
+      (surface_area(bounds_min, bounds_max) - surface_area(old_min, old_max)) *
+      child_cost(node, c);
+  for (int axis = 0; axis < 3; axis++) {
+    node.bounds_min[axis][c] = bounds_min[axis];
+    node.bounds_max[axis][c] = bounds_max[axis];
+  }
+  return true;
+}
+
+bool bvh4::finish_refit() {
+  if (nodes.empty()) return false;
+
+  float bounds_min[3], bounds_max[3];
+  root_bounds(bounds_min, bounds_max);
+  bbox = aabb(interval(bounds_min[0], bounds_max[0]),
+              interval(bounds_min[1], bounds_max[1]),
+              interval(bounds_min[2], bounds_max[2]));
+
+  const float degradation = get_degradation();
+  if (options.rebuild_threshold <= 0 ||
+      !(degradation > options.rebuild_threshold))
+    return false;
+
+  rebuild();
+  TraceLog(LOG_DEBUG, "BVH4: rebuilt, refits had made it %.2fx as costly",
+           degradation);
+  return true;
+}
+
+bool bvh4::hit(const ray& r, const interval& ray_t, hit_record& rec) const {
+  if (nodes.empty()) return false;
+  return hit_subtree(r, ray_t, rec, {0, 0, ray_t.min});
+}
+
+bool bvh4::hit_subtree(const ray& r, const interval& ray_t, hit_record& rec,
+                       const stack_entry& root) const {
+  stack_entry stack[max_stack];
+  int stack_size = 0;
+  stack[stack_size++] = root;
+  float closest = ray_t.max;
+  bool hit_anything = false;
+  size_t visits = 0;
+
+  while (stack_size > 0) {
+    const stack_entry entry = stack[--stack_size];
+    // Behind the closest hit found since it was pushed
+    if (entry.t_near >= closest) continue;
+
+    if (entry.count > 0) {
+      for (uint32_t i = 0; i < entry.count; i++) {
+        if (primitives[entry.child + i]->hit(r, interval(ray_t.min, closest),
+                                             rec)) {
+          hit_anything = true;
+          closest = rec.t;
+        }
+      }
+      continue;
+    }
+
+    const bvh4_node& node = nodes[entry.child];
+    visits++;
+
+    float t_near[bvh4_node::width];
+    const int hits =
+        hit_children(node, r, ray_t.min, closest, t_near);
+
+    // The nearest child ends on top of the stack
+    int order[bvh4_node::width];
+    const int count = far_to_near(hits, t_near, order);
+    for (int i = 0; i < count; i++) {
+      const int c = order[i];
+      stack[stack_size++] = {node.child[c], node.count[c], t_near[c]};
+    }
+  }
+
+  if (bvh_counts_visits()) bvh_visit_counter() += visits;
+  return hit_anything;
+}
+
+uint32_t bvh4::hit_packet(ray_packet& packet, uint32_t mask, const float t_min,
+                          hit_record* recs) const {
+  if (nodes.empty() || !mask) return 0;
+
+  // The rays of a packet are coherent, the first one orders the children
+  const ray& first = packet.rays[ray_packet::first_ray(mask)];
+
+  struct packet_entry {
+    stack_entry entry;
+    uint32_t mask;
+  };
+  packet_entry stack[max_stack];
+  int stack_size = 0;
+  stack[stack_size++] = {{0, 0, t_min}, mask};
+  uint32_t hits = 0;
+  const bool count_visits = bvh_counts_visits();
+
+  while (stack_size > 0) {
+    const packet_entry top = stack[--stack_size];
+    const stack_entry& entry = top.entry;
+
+    if (!(top.mask & (top.mask - 1))) {
+      // Once the packet has diverged down to a single ray, trace it on its
+      // own
+      const int i = ray_packet::first_ray(top.mask);
+      const size_t visits = bvh_visit_counter();
+      hit_record rec;
+      if (hit_subtree(packet.rays[i], interval(t_min, packet.t_max[i]), rec,
+                      entry)) {
+        recs[i] = rec;
+        packet.t_max[i] = rec.t;
+        hits |= top.mask;
+      }
+      if (count_visits)
+        bvh_ray_visit_counters()[i] += bvh_visit_counter() - visits;
+      continue;
+    }
+
+    if (entry.count > 0) {
+      for (uint32_t i = 0; i < entry.count; i++)
+        hits |= primitives[entry.child + i]->hit_packet(packet, top.mask,
+                                                        t_min, recs);
+      continue;
+    }
+
+    const bvh4_node& node = nodes[entry.child];
+    if (count_visits) count_packet_visit(top.mask);
+
+    uint32_t child_masks[bvh4_node::width];
+    int entered = 0;
+    for (uint32_t c = 0; c < node.child_count; c++) {
+      const float box_min[3] = {node.bounds_min[0][c], node.bounds_min[1][c],
+                                node.bounds_min[2][c]};
+      const float box_max[3] = {node.bounds_max[0][c], node.bounds_max[1][c],
+                                node.bounds_max[2][c]};
+      child_masks[c] =
+          aabb::hit_packet(box_min, box_max, packet, top.mask, t_min);
+      if (child_masks[c]) entered |= 1 << c;
+    }
+
+    // The first ray orders the children by where it enters their boxes
+    float t_near[bvh4_node::width] = {0, 0, 0, 0};
+    if (entered & (entered - 1))
+      hit_children(node, first, -infinity, infinity, t_near);
+
+    int order[bvh4_node::width];
+    const int count = far_to_near(entered, t_near, order);
+    for (int i = 0; i < count; i++) {
+      const int c = order[i];
+      stack[stack_size++] = {{node.child[c], node.count[c], t_min},
+                             child_masks[c]};
+    }
+  }
+
+  return hits;
+}
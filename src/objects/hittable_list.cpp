@@ -11,7 +11,8 @@
 
 #include "objects/hittable_list.hpp"
 
-hittable_list::hittable_list() {}
+// The box grows from an empty one, a default aabb is the whole space
+hittable_list::hittable_list() : bbox(aabb::empty) {}
 
 hittable_list::~hittable_list() { objects.clear(); }
 
@@ -20,7 +21,10 @@ void hittable_list::add(std::shared_ptr<hittable> object) {
   bbox = aabb(bbox, object->bounding_box());
 }
 
-void hittable_list::clear() { objects.clear(); }
+void hittable_list::clear() {
+  objects.clear();
+  bbox = aabb::empty;
+}
 
 bool hittable_list::hit(const ray& r, const interval& interval,
                         hit_record& rec) const {
@@ -41,10 +45,29 @@ bool hittable_list::hit(const ray& r, const interval& interval,
   return hit_anything;
 }
 
+uint32_t hittable_list::hit_packet(ray_packet& packet, const uint32_t mask,
+                                   const float t_min, hit_record* recs) const {
+  // The packet keeps the closest hit of every ray, so the objects can simply
+  // be intersected one after the other
+  uint32_t hits = 0;
+  for (const auto& object : objects)
+    hits |= object->hit_packet(packet, mask, t_min, recs);
+
+  return hits;
+}
+
 void hittable_list::move(const vec3& offset) {
-  // TODO: Implement this
+  bbox = aabb::empty;
+  for (const auto& object : objects) {
+    object->move(offset);
+    bbox = aabb(bbox, object->bounding_box());
+  }
 }
 
 void hittable_list::rotate(const vec3& axis, float angle) {
-  // TODO: Implement this
+  bbox = aabb::empty;
+  for (const auto& object : objects) {
+    object->rotate(axis, angle);
+    bbox = aabb(bbox, object->bounding_box());
+  }
 }
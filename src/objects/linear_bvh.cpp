@@ -0,0 +1,673 @@
+/**
+ * @file linear_bvh.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the linear_bvh class
+ * @version 0.1
+ * @date 2024-12-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "objects/linear_bvh.hpp"
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Slab test of one ray against the bounds of a node, the same as
+ * aabb::hit
+ *
+ * @return true if the ray enters the box between t_min and t_max
+ */
+inline bool hit_node(const linear_bvh_node& node, const ray& r, float t_min,
+                     float t_max) {
+  const vec3& origin = r.origin();
+  const vec3& inv_dir = r.inv_direction();
+  for (int axis = 0; axis < 3; axis++) {
+    const bool negative = r.is_negative(axis);
+    const float t0 =
+        ((negative ? node.bounds_max : node.bounds_min)[axis] - origin[axis]) *
+        inv_dir[axis];
+    const float t1 =
+        ((negative ? node.bounds_min : node.bounds_max)[axis] - origin[axis]) *
+        inv_dir[axis];
+    t_min = t0 > t_min ? t0 : t_min;
+    t_max = t1 < t_max ? t1 : t_max;
+  }
+  return t_min < t_max;
+}
+
+float surface_area(const float bounds_min[3], const float bounds_max[3]) {
+  const float dx = bounds_max[0] - bounds_min[0];
+  const float dy = bounds_max[1] - bounds_min[1];
+  const float dz = bounds_max[2] - bounds_min[2];
+  return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+void grow_bounds(float bounds_min[3], float bounds_max[3],
+                 const float other_min[3], const float other_max[3]) {
+  for (int axis = 0; axis < 3; axis++) {
+    bounds_min[axis] = std::min(bounds_min[axis], other_min[axis]);
+    bounds_max[axis] = std::max(bounds_max[axis], other_max[axis]);
+  }
+}
+
+// The primitives whose centroids fall in a slice of a node. Not
+// initialized, the arrays of bins are reset as far as they are used.
+struct sah_bin {
+  float bounds_min[3];
+  float bounds_max[3];
+  size_t count;
+
+  void reset() {
+    for (int axis = 0; axis < 3; axis++) {
+      bounds_min[axis] = +infinity;
+      bounds_max[axis] = -infinity;
+    }
+    count = 0;
+  }
+
+  void add(const float other_min[3], const float other_max[3],
+           const size_t other_count) {
+    grow_bounds(bounds_min, bounds_max, other_min, other_max);
+    count += other_count;
+  }
+
+  float area() const { return surface_area(bounds_min, bounds_max); }
+};
+
+// The bin of a centroid, the same for the binning and the partition
+inline int bin_index(const float centroid, const float centroid_min,
+                     const float scale, const int bin_count) {
+  const int b = (int)((centroid - centroid_min) * scale);
+  return std::min(std::max(b, 0), bin_count - 1);
+}
+
+}  // namespace
+
+linear_bvh::linear_bvh(const hittable_list& list,
+                       const bvh_build_options& options)
+    : options(options) {
+  this->options.bin_count = std::min(std::max(options.bin_count, 2), max_bins);
+  this->options.max_leaf_size =
+      std::min(std::max(options.max_leaf_size, (size_t)1), (size_t)UINT16_MAX);
+
+  build_tree(list);
+  if (nodes.empty()) return;
+
+  TraceLog(LOG_DEBUG, "BVH: %zu primitives, %zu nodes, SAH cost %.2f",
+           primitives.size(), nodes.size(), get_sah_cost());
+}
+
+void linear_bvh::build_tree(const hittable_list& list) {
+  nodes.clear();
+  primitives.clear();
+  moved_leaves.clear();
+
+  const size_t count = list.objects.size();
+  if (count == 0) {
+    parents.clear();
+    object_index.clear();
+    object_leaf.clear();
+    return;
+  }
+
+#ifdef USE_OPENMP
+  const int threads =
+      count < task_span ? 1
+                        : (options.threads > 0 ? options.threads
+                                               : omp_get_max_threads());
+#endif
+
+  // The virtual bounding_box() is called once per primitive
+  std::vector<build_primitive> items(count);
+#ifdef USE_OPENMP
+#pragma omp parallel for num_threads(threads)
+#endif
+  for (long i = 0; i < (long)count; i++) {
+    const aabb box = list.objects[i]->bounding_box();
+    for (int axis = 0; axis < 3; axis++) {
+      items[i].bounds_min[axis] = box.axis_interval(axis).min;
+      items[i].bounds_max[axis] = box.axis_interval(axis).max;
+      items[i].centroid[axis] =
+          0.5f * (items[i].bounds_min[axis] + items[i].bounds_max[axis]);
+    }
+    items[i].index = (uint32_t)i;
+  }
+
+  nodes.reserve(2 * count);
+#ifdef USE_OPENMP
+  // The subtrees become tasks of this team
+#pragma omp parallel num_threads(threads)
+#pragma omp single
+#endif
+  build(items, 0, count, 0, nodes);
+
+  primitives.reserve(count);
+  object_index.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    primitives.push_back(list.objects[items[i].index]);
+    object_index[i] = items[i].index;
+  }
+
+  // What the refits need: the parent of every node, the leaf of every
+  // object and the weighted area of the nodes
+  parents.assign(nodes.size(), 0);
+  object_leaf.assign(count, 0);
+  weighted_area = 0;
+  for (uint32_t i = 0; i < (uint32_t)nodes.size(); i++) {
+    const linear_bvh_node& node = nodes[i];
+    weighted_area +=
+        surface_area(node.bounds_min, node.bounds_max) * node_cost(node);
+    if (node.is_leaf()) {
+      for (uint32_t p = 0; p < node.count; p++)
+        object_leaf[object_index[node.offset + p]] = i;
+    } else {
+      parents[i + 1] = i;
+      parents[node.offset] = i;
+    }
+  }
+  const linear_bvh_node& root = nodes[0];
+  built_cost =
+      (float)(weighted_area / surface_area(root.bounds_min, root.bounds_max));
+  bbox = aabb(interval(root.bounds_min[0], root.bounds_max[0]),
+              interval(root.bounds_min[1], root.bounds_max[1]),
+              interval(root.bounds_min[2], root.bounds_max[2]));
+}
+
+size_t linear_bvh::chunk_count(const size_t span) {
+#ifdef USE_OPENMP
+  if (span >= parallel_binning_span && omp_get_num_threads() > 1)
+    return std::min(span / (parallel_binning_span / 8),
+                    (size_t)(4 * omp_get_num_threads()));
+#endif
+  return 1;
+}
+
+void linear_bvh::span_bounds(const std::vector<build_primitive>& items,
+                             const size_t start, const size_t end,
+                             linear_bvh_node& node, float centroid_min[3],
+                             float centroid_max[3]) {
+  // The primitives and their centroids, one pair of boxes per chunk
+  const size_t chunks = chunk_count(end - start);
+  const size_t chunk_size = (end - start + chunks - 1) / chunks;
+  sah_bin local[2];
+  std::vector<sah_bin> shared(chunks > 1 ? 2 * chunks : 0);
+  sah_bin* partial = chunks > 1 ? shared.data() : local;
+  for (size_t i = 0; i < 2 * chunks; i++) partial[i].reset();
+
+  for (size_t c = 0; c < chunks; c++) {
+#ifdef USE_OPENMP
+#pragma omp task default(shared) firstprivate(c) if (chunks > 1)
+#endif
+    {
+      const size_t first = start + c * chunk_size;
+      const size_t last = std::min(end, first + chunk_size);
+      for (size_t i = first; i < last; i++) {
+        partial[2 * c].add(items[i].bounds_min, items[i].bounds_max, 1);
+        partial[2 * c + 1].add(items[i].centroid, items[i].centroid, 1);
+      }
+    }
+  }
+#ifdef USE_OPENMP
+#pragma omp taskwait
+#endif
+
+  sah_bin bounds, centroids;
+  bounds.reset();
+  centroids.reset();
+  for (size_t c = 0; c < chunks; c++) {
+    bounds.add(partial[2 * c].bounds_min, partial[2 * c].bounds_max, 0);
+    centroids.add(partial[2 * c + 1].bounds_min,
+                  partial[2 * c + 1].bounds_max, 0);
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    node.bounds_min[axis] = bounds.bounds_min[axis];
+    node.bounds_max[axis] = bounds.bounds_max[axis];
+    centroid_min[axis] = centroids.bounds_min[axis];
+    centroid_max[axis] = centroids.bounds_max[axis];
+  }
+}
+
+uint32_t linear_bvh::build(std::vector<build_primitive>& items,
+                           const size_t start, const size_t end,
+                           const int depth,
+                           std::vector<linear_bvh_node>& out) const {
+  linear_bvh_node node;
+  float centroid_min[3], centroid_max[3];
+  span_bounds(items, start, end, node, centroid_min, centroid_max);
+
+  const uint32_t index = (uint32_t)out.size();
+  const size_t span = end - start;
+  size_t mid = start;
+  int axis = 0;
+  bool split = false;
+
+  if (span == 1 || depth == max_depth - 1) {
+    split = false;
+  } else if (options.split == bvh_split::sah && depth < max_depth / 2) {
+    split = split_sah(items, start, end, node, centroid_min, centroid_max,
+                      mid, axis);
+  } else if (span > options.max_leaf_size) {
+    // Deep down the median split bounds the depth of a degenerate tree
+    float longest = -1.0f;
+    for (int a = 0; a < 3; a++) {
+      if (node.bounds_max[a] - node.bounds_min[a] > longest) {
+        longest = node.bounds_max[a] - node.bounds_min[a];
+        axis = a;
+      }
+    }
+    mid = start + span / 2;
+    std::nth_element(items.begin() + start, items.begin() + mid,
+                     items.begin() + end,
+                     [axis](const build_primitive& a,
+                            const build_primitive& b) {
+                       return a.centroid[axis] < b.centroid[axis];
+                     });
+    split = true;
+  }
+
+  if (!split) {
+    node.offset = (uint32_t)start;
+    node.count = (uint16_t)span;
+    node.axis = 0;
+    out.push_back(node);
+    return index;
+  }
+
+  node.count = 0;
+  node.axis = (uint16_t)axis;
+  out.push_back(node);
+
+#ifdef USE_OPENMP
+  if (span >= task_span && omp_get_num_threads() > 1) {
+    // The children own disjoint runs of the items, each is built into its
+    // own array by a task and copied after the parent in depth-first order
+    std::vector<linear_bvh_node> first, second;
+#pragma omp task default(shared)
+    build(items, start, mid, depth + 1, first);
+    build(items, mid, end, depth + 1, second);
+#pragma omp taskwait
+
+    append_subtree(out, first);
+    out[index].offset = (uint32_t)out.size();
+    append_subtree(out, second);
+    return index;
+  }
+#endif
+
+  // The first child follows its parent, the vector may grow in between
+  build(items, start, mid, depth + 1, out);
+  out[index].offset = build(items, mid, end, depth + 1, out);
+  return index;
+}
+
+void linear_bvh::append_subtree(std::vector<linear_bvh_node>& out,
+                                const std::vector<linear_bvh_node>& subtree) {
+  // The children of the subtree were numbered from its root
+  const uint32_t base = (uint32_t)out.size();
+  out.reserve(out.size() + subtree.size());
+  for (linear_bvh_node node : subtree) {
+    if (!node.is_leaf()) node.offset += base;
+    out.push_back(node);
+  }
+}
+
+bool linear_bvh::split_sah(std::vector<build_primitive>& items,
+                           const size_t start, const size_t end,
+                           const linear_bvh_node& node,
+                           const float centroid_min[3],
+                           const float centroid_max[3], size_t& mid,
+                           int& axis) const {
+  const size_t span = end - start;
+  const int bin_count = options.bin_count;
+
+  // The bins divide the bounds of the centroids, not of the primitives
+  float scale[3];
+  for (int a = 0; a < 3; a++) {
+    const float extent = centroid_max[a] - centroid_min[a];
+    scale[a] = extent > 0 ? bin_count / extent : 0;
+  }
+
+  // The bins of the three axes, one set per chunk of the span
+  const size_t chunks = chunk_count(span);
+  const size_t chunk_size = (span + chunks - 1) / chunks;
+  sah_bin local[3 * max_bins];
+  std::vector<sah_bin> shared(chunks > 1 ? chunks * 3 * bin_count : 0);
+  sah_bin* partial = chunks > 1 ? shared.data() : local;
+  for (size_t i = 0; i < chunks * 3 * bin_count; i++) partial[i].reset();
+
+  for (size_t c = 0; c < chunks; c++) {
+#ifdef USE_OPENMP
+#pragma omp task default(shared) firstprivate(c) if (chunks > 1)
+#endif
+    {
+      sah_bin* bins = &partial[c * 3 * bin_count];
+      const size_t first = start + c * chunk_size;
+      const size_t last = std::min(end, first + chunk_size);
+      for (size_t i = first; i < last; i++) {
+        for (int a = 0; a < 3; a++) {
+          if (scale[a] == 0) continue;
+          const int b = bin_index(items[i].centroid[a], centroid_min[a],
+                                  scale[a], bin_count);
+          bins[a * bin_count + b].add(items[i].bounds_min,
+                                      items[i].bounds_max, 1);
+        }
+      }
+    }
+  }
+#ifdef USE_OPENMP
+#pragma omp taskwait
+#endif
+
+  const float node_area = surface_area(node.bounds_min, node.bounds_max);
+  float best_cost = infinity;
+  int best_axis = -1;
+  int best_bin = 0;
+
+  sah_bin bins[max_bins];
+  float right_area[max_bins];
+  size_t right_count[max_bins];
+
+  for (int a = 0; a < 3; a++) {
+    if (scale[a] == 0) continue;
+
+    for (int b = 0; b < bin_count; b++) {
+      bins[b] = partial[a * bin_count + b];
+      for (size_t c = 1; c < chunks; c++) {
+        const sah_bin& other = partial[(c * 3 + a) * bin_count + b];
+        bins[b].add(other.bounds_min, other.bounds_max, other.count);
+      }
+    }
+
+    // Sweep from the right, then try every plane sweeping from the left
+    sah_bin right;
+    right.reset();
+    for (int b = bin_count - 1; b > 0; b--) {
+      right.add(bins[b].bounds_min, bins[b].bounds_max, bins[b].count);
+      right_area[b] = right.area();
+      right_count[b] = right.count;
+    }
+
+    sah_bin left;
+    left.reset();
+    for (int b = 0; b < bin_count - 1; b++) {
+      left.add(bins[b].bounds_min, bins[b].bounds_max, bins[b].count);
+      if (left.count == 0 || right_count[b + 1] == 0) continue;
+
+      const float cost = options.traversal_cost +
+                         (left.area() * left.count +
+                          right_area[b + 1] * right_count[b + 1]) /
+                             node_area;
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = a;
+        best_bin = b;
+      }
+    }
+  }
+
+  if (best_axis < 0) {
+    // Every centroid is in the same place, only the leaf size matters
+    if (span <= options.max_leaf_size) return false;
+    mid = start + span / 2;
+    axis = 0;
+    return true;
+  }
+
+  // Intersecting every primitive of the span costs one per primitive
+  if (span <= options.max_leaf_size && (float)span <= best_cost) return false;
+
+  auto second = std::partition(
+      items.begin() + start, items.begin() + end,
+      [&](const build_primitive& item) {
+        return bin_index(item.centroid[best_axis], centroid_min[best_axis],
+                         scale[best_axis], bin_count) <= best_bin;
+      });
+  mid = second - items.begin();
+  axis = best_axis;
+  return true;
+}
+
+float linear_bvh::get_sah_cost() const {
+  if (nodes.empty()) return 0;
+
+  const float root_area =
+      surface_area(nodes[0].bounds_min, nodes[0].bounds_max);
+  double cost = 0;
+  for (const linear_bvh_node& node : nodes) {
+    const float chance =
+        surface_area(node.bounds_min, node.bounds_max) / root_area;
+    cost += chance * (node.is_leaf() ? node.count : options.traversal_cost);
+  }
+  return (float)cost;
+}
+
+float linear_bvh::get_degradation() const {
+  if (nodes.empty()) return 1.0f;
+
+  const float root_area =
+      surface_area(nodes[0].bounds_min, nodes[0].bounds_max);
+  // A tree of flat or point objects has no area to compare
+  if (!(root_area > 0) || !(built_cost > 0)) return 1.0f;
+  return (float)(weighted_area / root_area) / built_cost;
+}
+
+void linear_bvh::move(const vec3& offset) {
+  for (const shared_ptr<hittable>& primitive : primitives)
+    primitive->move(offset);
+
+  // Refitted rather than moved by the offset, which could round the boxes of
+  // the nodes inside the boxes of the objects. Children come after their
+  // parent.
+  for (size_t node = nodes.size(); node-- > 0;) refit_node((uint32_t)node);
+  moved_leaves.clear();
+  finish_refit();
+}
+
+void linear_bvh::rotate(const vec3& axis, float angle) {
+  for (const shared_ptr<hittable>& primitive : primitives)
+    primitive->rotate(axis, angle);
+
+  for (size_t node = nodes.size(); node-- > 0;) refit_node((uint32_t)node);
+  moved_leaves.clear();
+  finish_refit();
+}
+
+void linear_bvh::mark_moved(const size_t index) {
+  if (index < object_leaf.size()) moved_leaves.push_back(object_leaf[index]);
+}
+
+bool linear_bvh::refit() {
+  for (const uint32_t leaf : moved_leaves) {
+    // Up to the root, or to the first node that keeps its box. The nodes
+    // above it are still up to date.
+    uint32_t node = leaf;
+    while (refit_node(node) && node != 0) node = parents[node];
+  }
+  moved_leaves.clear();
+  return finish_refit();
+}
+
+void linear_bvh::rebuild() {
+  // The objects in the order of the list, so that they keep their indices
+  hittable_list list;
+  list.objects.resize(primitives.size());
+  for (size_t i = 0; i < primitives.size(); i++)
+    list.objects[object_index[i]] = primitives[i];
+
+  build_tree(list);
+}
+
+bool linear_bvh::refit_node(const uint32_t index) {
+  linear_bvh_node& node = nodes[index];
+
+  float bounds_min[3] = {+infinity, +infinity, +infinity};
+  float bounds_max[3] = {-infinity, -infinity, -infinity};
+  if (node.is_leaf()) {
+    for (uint32_t i = 0; i < node.count; i++) {
+      const aabb box = primitives[node.offset + i]->bounding_box();
+      for (int axis = 0; axis < 3; axis++) {
+        bounds_min[axis] =
+            std::min(bounds_min[axis], box.axis_interval(axis).min);
+        bounds_max[axis] =
+            std::max(bounds_max[axis], box.axis_interval(axis).max);
+      }
+    }
+  } else {
+    const linear_bvh_node& first = nodes[index + 1];
+    const linear_bvh_node& second = nodes[node.offset];
+    grow_bounds(bounds_min, bounds_max, first.bounds_min, first.bounds_max);
+    grow_bounds(bounds_min, bounds_max, second.bounds_min, second.bounds_max);
+  }
+
+  bool same = true;
+  for (int axis = 0; axis < 3; axis++)
+    same = same && bounds_min[axis] == node.bounds_min[axis] &&
+           bounds_max[axis] == node.bounds_max[axis];
+  if (same) return false;
+
+  weighted_area += (surface_area(bounds_min, bounds_max) -
+                    surface_area(node.bounds_min, node.bounds_max)) *
+                   node_cost(node);
+  for (int axis = 0; axis < 3; axis++) {
+    node.bounds_min[axis] = bounds_min[axis];
+    node.bounds_max[axis] = bounds_max[axis];
+  }
+  return true;
+}
+
+bool linear_bvh::finish_refit() {
+  if (nodes.empty()) return false;
+
+  const linear_bvh_node& root = nodes[0];
+  bbox = aabb(interval(root.bounds_min[0], root.bounds_max[0]),
+              interval(root.bounds_min[1], root.bounds_max[1]),
+              interval(root.bounds_min[2], root.bounds_max[2]));
+
+  const float degradation = get_degradation();
+  if (options.rebuild_threshold <= 0 ||
+      !(degradation > options.rebuild_threshold))
+    return false;
+
+  rebuild();
+  TraceLog(LOG_DEBUG, "BVH: rebuilt, refits had made it %.2fx as costly",
+           degradation);
+  return true;
+}
+
+bool linear_bvh::hit(const ray& r, const interval& ray_t,
+                     hit_record& rec) const {
+  if (nodes.empty()) return false;
+  return hit_subtree(r, ray_t, rec, 0);
+}
+
+bool linear_bvh::hit_subtree(const ray& r, const interval& ray_t,
+                             hit_record& rec, uint32_t node) const {
+  uint32_t stack[max_depth];
+  int stack_size = 0;
+  float closest = ray_t.max;
+  bool hit_anything = false;
+  size_t visits = 0;
+
+  while (true) {
+    const linear_bvh_node& current = nodes[node];
+    visits++;
+
+    if (hit_node(current, r, ray_t.min, closest)) {
+      if (current.is_leaf()) {
+        for (uint32_t i = 0; i < current.count; i++) {
+          if (primitives[current.offset + i]->hit(
+                  r, interval(ray_t.min, closest), rec)) {
+            hit_anything = true;
+            closest = rec.t;
+          }
+        }
+      } else {
+        // Visit the child on the side the ray comes from first, its hits
+        // shorten the interval of the other one
+        if (r.is_negative(current.axis)) {
+          stack[stack_size++] = node + 1;
+          node = current.offset;
+        } else {
+          stack[stack_size++] = current.offset;
+          node = node + 1;
+        }
+        continue;
+      }
+    }
+
+    if (stack_size == 0) break;
+    node = stack[--stack_size];
+  }
+
+  if (bvh_counts_visits()) bvh_visit_counter() += visits;
+  return hit_anything;
+}
+
+uint32_t linear_bvh::hit_packet(ray_packet& packet, uint32_t mask,
+                                const float t_min, hit_record* recs) const {
+  if (nodes.empty() || !mask) return 0;
+
+  // The rays of a packet are coherent, the first one orders the children
+  const ray& first = packet.rays[ray_packet::first_ray(mask)];
+
+  struct stack_entry {
+    uint32_t node;
+    uint32_t mask;
+  };
+  stack_entry stack[max_depth];
+  int stack_size = 0;
+  uint32_t node = 0;
+  uint32_t hits = 0;
+  const bool count_visits = bvh_counts_visits();
+
+  while (true) {
+    const linear_bvh_node& current = nodes[node];
+    if (count_visits) count_packet_visit(mask);
+    mask = aabb::hit_packet(current.bounds_min, current.bounds_max, packet,
+                            mask, t_min);
+
+    if (mask) {
+      if (!(mask & (mask - 1))) {
+        // Once the packet has diverged down to a single ray, trace it on its
+        // own
+        const int i = ray_packet::first_ray(mask);
+        const size_t visits = bvh_visit_counter();
+        hit_record rec;
+        if (hit_subtree(packet.rays[i], interval(t_min, packet.t_max[i]), rec,
+                        node)) {
+          recs[i] = rec;
+          packet.t_max[i] = rec.t;
+          hits |= mask;
+        }
+        if (count_visits)
+          bvh_ray_visit_counters()[i] += bvh_visit_counter() - visits;
+      } else if (current.is_leaf()) {
+        for (uint32_t i = 0; i < current.count; i++)
+          hits |= primitives[current.offset + i]->hit_packet(packet, mask,
+                                                             t_min, recs);
+      } else {
+        if (first.is_negative(current.axis)) {
+          stack[stack_size++] = {node + 1, mask};
+          node = current.offset;
+        } else {
+          stack[stack_size++] = {current.offset, mask};
+          node = node + 1;
+        }
+        continue;
+      }
+    }
+
+    if (stack_size == 0) break;
+    node = stack[stack_size - 1].node;
+    mask = stack[stack_size - 1].mask;
+    stack_size--;
+  }
+
+  return hits;
+}
@@ -53,7 +53,8 @@ bool quad::hit(const ray& r, const interval& ray_t, hit_record& rec) const {
   // Ray hits the 2D shape; set the rest of the hit record and return true.
   rec.t = t;
   rec.p = intersection;
-  rec.mat_ptr = mat;
+  rec.mat_ptr = mat.get();
+  rec.object = this;
   rec.set_face_normal(r, normal);
 
   return true;
@@ -73,10 +74,10 @@ bool quad::is_interior(double a, double b, hit_record& rec) const {
 }
 
 void quad::move(const vec3& offset) {
+  // u and v are the edges from Q, only the corner and the plane move
   Q += offset;
-  u += offset;
-  v += offset;
-  set_bounding_box();  // Recalculate bounding box if needed
+  D = dot(normal, Q);
+  set_bounding_box();
 }
 
 void quad::rotate(const vec3& axis, float angle) {
@@ -42,7 +42,8 @@ bool sphere::hit(const ray& r, const interval& interval,
       rec.p = r.at(rec.t);
       vec3 outward_normal = (rec.p - center) / radius;
       rec.set_face_normal(r, outward_normal);
-      rec.mat_ptr = mat;
+      rec.mat_ptr = mat.get();
+      rec.object = this;
       get_sphere_uv(outward_normal, rec.u, rec.v);
       return true;
     }
@@ -54,7 +55,8 @@ bool sphere::hit(const ray& r, const interval& interval,
       vec3 outward_normal = (rec.p - center) / radius;
       rec.set_face_normal(r, outward_normal);
       get_sphere_uv(outward_normal, rec.u, rec.v);
-      rec.mat_ptr = mat;
+      rec.mat_ptr = mat.get();
+      rec.object = this;
       return true;
     }
   }
@@ -17,20 +17,25 @@ void hit_record::set_face_normal(const ray& r, const vec3& outward_normal) {
 }
 
 ray ray::reflect(const vec3& normal, const vec3& intersection_point,
-                 const float& fuzz) const {
-  return ray(intersection_point, dir - 2 * dot(dir, normal) * normal +
-                                     fuzz * random_in_unit_sphere());
+                 const float& fuzz, sampler& s) const {
+  const vec3 reflected = dir - 2 * dot(dir, normal) * normal;
+  if (fuzz == 0) return ray(intersection_point, reflected);
+
+  float u1, u2;
+  s.get_2d(u1, u2);
+  return ray(intersection_point,
+             reflected + fuzz * sample_in_unit_sphere(u1, u2, s.get_1d()));
 }
 
 ray ray::refract(const vec3& normal, const vec3& intersection_point,
-                 float etai_over_etat) const {
+                 float etai_over_etat, sampler& s) const {
   vec3 unit_direction = unit_vector(dir);
   float cos_theta = (float)fmin(dot(-unit_direction, normal), 1.0);
   float sin_theta = (float)sqrt(1.0 - cos_theta * cos_theta);
 
   if (etai_over_etat * sin_theta > 1.0 ||
-      random_float() < schlick(cos_theta, etai_over_etat))
-    return reflect(normal, intersection_point, 0.0);
+      s.get_1d() < schlick(cos_theta, etai_over_etat))
+    return reflect(normal, intersection_point, 0.0, s);
 
   vec3 r_out_perp = etai_over_etat * (unit_direction + cos_theta * normal);
   vec3 r_out_parallel = -(float)sqrt(fabs(1.0 - r_out_perp.length_squared())) * normal;
@@ -0,0 +1,103 @@
+/**
+ * @file accumulation_buffer.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the accumulation_buffer class
+ * @version 0.1
+ * @date 2024-10-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/accumulation_buffer.hpp"
+
+#include <algorithm>
+
+accumulation_buffer::accumulation_buffer(const int width, const int height)
+    : width(width),
+      height(height),
+      sum(width * height, vec3(0, 0, 0)),
+      sum_sq(width * height, 0.0f),
+      samples(width * height, 0) {}
+
+void accumulation_buffer::reset() {
+  std::fill(sum.begin(), sum.end(), vec3(0, 0, 0));
+  std::fill(sum_sq.begin(), sum_sq.end(), 0.0f);
+  std::fill(samples.begin(), samples.end(), 0);
+}
+
+float accumulation_buffer::get_relative_error(const int index) const {
+  const uint32_t n = samples[index];
+  if (n < 2) return infinity;
+
+  const float mean = luminance(sum[index]) / n;
+  const float standard_error = std::sqrt(get_variance(index));
+
+  // Keep very dark pixels from needing an unbounded number of samples
+  return standard_error / std::max(mean, 0.01f);
+}
+
+float accumulation_buffer::get_variance(const int index) const {
+  const uint32_t n = samples[index];
+  if (n < 2) return infinity;
+
+  const float mean = luminance(sum[index]) / n;
+  // Unbiased sample variance of the luminance, over n for the mean
+  return std::max(0.0f, (sum_sq[index] - mean * mean * n) / (n - 1)) / n;
+}
+
+void accumulation_buffer::copy_pixel(const int index,
+                                     const accumulation_buffer& from,
+                                     const int from_index,
+                                     const uint32_t max_samples) {
+  const uint32_t count = from.samples[from_index];
+  const float scale =
+      count > max_samples ? (float)max_samples / count : 1.0f;
+
+  sum[index] = from.sum[from_index] * scale;
+  sum_sq[index] = from.sum_sq[from_index] * scale;
+  samples[index] = std::min(count, max_samples);
+}
+
+Color accumulation_buffer::resolve_color(const vec3& linear) const {
+  vec3 color = linear * exposure;
+
+  for (int c = 0; c < 3; c++) {
+    float value = color.e[c];
+    if (tonemap == tonemap_operator::reinhard) value = value / (1.0f + value);
+
+    // Linear to Gamma
+    color.e[c] = pow(clamp(value, 0.0f, 1.0f), 1 / 2.2f);
+  }
+
+  return color.to_color(255);
+}
+
+void accumulation_buffer::resolve(std::vector<Color>& pixels) const {
+  const int total_pixels = width * height;
+  if (pixels.size() != (size_t)total_pixels) pixels.resize(total_pixels);
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < total_pixels; i++) pixels[i] = resolve(i);
+}
+
+void accumulation_buffer::resolve_heatmap(std::vector<Color>& pixels) const {
+  const int total_pixels = width * height;
+  if (pixels.size() != (size_t)total_pixels) pixels.resize(total_pixels);
+
+  const uint32_t max_samples =
+      std::max(1u, *std::max_element(samples.begin(), samples.end()));
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < total_pixels; i++) {
+    // Blue -> green -> red
+    const float t = (float)samples[i] / max_samples;
+    const vec3 color = t < 0.5f ? vec3(0, 2 * t, 1 - 2 * t)
+                                : vec3(2 * t - 1, 2 - 2 * t, 0);
+    pixels[i] = color.to_color(255);
+  }
+}
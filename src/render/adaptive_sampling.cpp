@@ -0,0 +1,61 @@
+/**
+ * @file adaptive_sampling.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the adaptive_sampling class
+ * @version 0.1
+ * @date 2024-10-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/adaptive_sampling.hpp"
+
+size_t adaptive_sampling::update(tile_scheduler& scheduler,
+                                 const accumulation_buffer& accum) {
+  const int tile_count = (int)scheduler.tile_count();
+  std::vector<float> errors(tile_count);
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0; i < tile_count; i++)
+    errors[i] = tile_error(scheduler.get_tile(i), accum);
+
+  std::vector<size_t> active;
+  for (int i = 0; i < tile_count; i++)
+    if (errors[i] >= 0) active.push_back(i);
+
+  // Spend the budget on the noisiest tiles first
+  std::stable_sort(active.begin(), active.end(),
+                   [&errors](const size_t a, const size_t b) {
+                     return errors[a] > errors[b];
+                   });
+
+  max_error = active.empty() ? 0.0f : errors[active.front()];
+  scheduler.set_active_tiles(active);
+  return active.size();
+}
+
+float adaptive_sampling::tile_error(const tile& t,
+                                    const accumulation_buffer& accum) const {
+  const int width = accum.get_width();
+  float error = 0;
+  bool done = true;
+
+  for (int y = t.y0; y < t.y1; y++) {
+    for (int x = t.x0; x < t.x1; x++) {
+      const int index = y * width + x;
+      const uint32_t samples = accum.get_samples(index);
+
+      if (max_samples > 0 && samples >= max_samples) continue;
+      if (samples < min_samples) return infinity;
+
+      const float pixel_error = accum.get_relative_error(index);
+      error = std::max(error, pixel_error);
+      if (pixel_error >= error_threshold) done = false;
+    }
+  }
+
+  return done ? -1.0f : error;
+}
@@ -0,0 +1,322 @@
+/**
+ * @file aov_buffer.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the aov_buffer class
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/aov_buffer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+const aov_type aov_buffer::all_types[7] = {
+    aov_type::depth,       aov_type::normal,      aov_type::albedo,
+    aov_type::object_id,   aov_type::material_id, aov_type::path_length,
+    aov_type::bvh_visits};
+
+namespace {
+
+// Portable float map, the raw values of a pass. The rows are stored from the
+// bottom up, a negative scale marks little endian data.
+bool write_pfm(const std::string& filename, const int width,
+               const int height, const int channel_count,
+               const std::vector<float>& values) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file) return false;
+
+  file << (channel_count == 3 ? "PF" : "Pf") << "\n"
+       << width << " " << height << "\n-1.0\n";
+  for (int y = height - 1; y >= 0; y--)
+    file.write(reinterpret_cast<const char*>(
+                   &values[(size_t)y * width * channel_count]),
+               sizeof(float) * width * channel_count);
+
+  return (bool)file;
+}
+
+// A distinct, stable color for every id
+Color id_color(const uint32_t id) {
+  if (id == 0) return Color{0, 0, 0, 255};
+
+  uint32_t h = id * 0x9E3779B9u;
+  h ^= h >> 16;
+  h *= 0x7FEB352Du;
+  h ^= h >> 15;
+  return Color{(unsigned char)(64 + (h & 0xBF)),
+               (unsigned char)(64 + ((h >> 8) & 0xBF)),
+               (unsigned char)(64 + ((h >> 16) & 0xBF)), 255};
+}
+
+}  // namespace
+
+aov_buffer::aov_buffer(const int width, const int height,
+                       const aov_set passes)
+    : width(width), height(height) {
+  set_passes(passes);
+}
+
+void aov_buffer::set_passes(const aov_set new_passes) {
+  passes = new_passes;
+  const size_t total_pixels = (size_t)width * height;
+
+  // Free the passes that are not kept
+  auto allocate = [&](auto& buffer, const bool keep) {
+    buffer.clear();
+    buffer.shrink_to_fit();
+    if (keep) buffer.resize(total_pixels);
+  };
+
+  allocate(samples, any());
+  allocate(depth_sum, has(aov_type::depth));
+  allocate(hit_samples, has(aov_type::depth));
+  allocate(normal_sum, has(aov_type::normal));
+  allocate(albedo_sum, has(aov_type::albedo));
+  allocate(objects, has(aov_type::object_id));
+  allocate(materials, has(aov_type::material_id));
+  allocate(path_length_sum, has(aov_type::path_length));
+  allocate(bvh_visits_sum, has(aov_type::bvh_visits));
+  reset();
+}
+
+void aov_buffer::reset() {
+  std::fill(samples.begin(), samples.end(), 0);
+  std::fill(depth_sum.begin(), depth_sum.end(), 0.0f);
+  std::fill(hit_samples.begin(), hit_samples.end(), 0);
+  std::fill(normal_sum.begin(), normal_sum.end(), vec3(0, 0, 0));
+  std::fill(albedo_sum.begin(), albedo_sum.end(), vec3(0, 0, 0));
+  std::fill(objects.begin(), objects.end(), nullptr);
+  std::fill(materials.begin(), materials.end(), nullptr);
+  std::fill(path_length_sum.begin(), path_length_sum.end(), 0.0f);
+  std::fill(bvh_visits_sum.begin(), bvh_visits_sum.end(), 0.0f);
+}
+
+void aov_buffer::add_sample(const int index, const aov_sample& sample) {
+  const pixel_features& hit = sample.first_hit;
+
+  if (!depth_sum.empty() && hit.object) {
+    depth_sum[index] += hit.depth;
+    hit_samples[index]++;
+  }
+  if (!normal_sum.empty()) normal_sum[index] += hit.normal;
+  if (!albedo_sum.empty()) albedo_sum[index] += hit.albedo;
+  if (samples[index] == 0) {
+    if (!objects.empty()) objects[index] = hit.object;
+    if (!materials.empty()) materials[index] = hit.mat;
+  }
+  if (!path_length_sum.empty())
+    path_length_sum[index] += (float)sample.path_length;
+  if (!bvh_visits_sum.empty())
+    bvh_visits_sum[index] += (float)sample.bvh_visits;
+
+  samples[index]++;
+}
+
+float aov_buffer::get_depth(const int index) const {
+  if (hit_samples[index] == 0) return infinity;
+  return depth_sum[index] / hit_samples[index];
+}
+
+vec3 aov_buffer::get_normal(const int index) const {
+  const vec3& n = normal_sum[index];
+  return n.near_zero() ? n : unit_vector(n);
+}
+
+vec3 aov_buffer::get_albedo(const int index) const {
+  if (samples[index] == 0) return vec3(0, 0, 0);
+  return albedo_sum[index] / (float)samples[index];
+}
+
+float aov_buffer::get_path_length(const int index) const {
+  if (samples[index] == 0) return 0;
+  return path_length_sum[index] / samples[index];
+}
+
+float aov_buffer::get_bvh_visits(const int index) const {
+  if (samples[index] == 0) return 0;
+  return bvh_visits_sum[index] / samples[index];
+}
+
+std::vector<uint32_t> aov_buffer::get_ids(const aov_type type) const {
+  const int total_pixels = width * height;
+  std::vector<uint32_t> ids(total_pixels, 0);
+  std::unordered_map<const void*, uint32_t> known;
+
+  for (int i = 0; i < total_pixels; i++) {
+    const void* key = type == aov_type::object_id
+                          ? (const void*)objects[i]
+                          : (const void*)materials[i];
+    if (!key) continue;
+
+    auto found = known.find(key);
+    if (found == known.end())
+      found = known.emplace(key, (uint32_t)known.size() + 1).first;
+    ids[i] = found->second;
+  }
+
+  return ids;
+}
+
+std::vector<float> aov_buffer::channels(const aov_type type,
+                                        int& channel_count) const {
+  const int total_pixels = width * height;
+  const bool color = type == aov_type::normal || type == aov_type::albedo;
+  channel_count = color ? 3 : 1;
+
+  std::vector<float> values((size_t)total_pixels * channel_count);
+  std::vector<uint32_t> ids;
+  if (type == aov_type::object_id || type == aov_type::material_id)
+    ids = get_ids(type);
+
+  for (int i = 0; i < total_pixels; i++) {
+    switch (type) {
+      case aov_type::depth:
+        values[i] = get_depth(i);
+        break;
+      case aov_type::normal:
+      case aov_type::albedo: {
+        const vec3 v =
+            type == aov_type::normal ? get_normal(i) : get_albedo(i);
+        for (int c = 0; c < 3; c++) values[3 * i + c] = v.e[c];
+        break;
+      }
+      case aov_type::object_id:
+      case aov_type::material_id:
+        values[i] = (float)ids[i];
+        break;
+      case aov_type::path_length:
+        values[i] = get_path_length(i);
+        break;
+      case aov_type::bvh_visits:
+        values[i] = get_bvh_visits(i);
+        break;
+    }
+  }
+
+  return values;
+}
+
+bool aov_buffer::save(const aov_type type, const std::string& filename) const {
+  if (!has(type)) return false;
+
+  int channel_count = 1;
+  const std::vector<float> values = channels(type, channel_count);
+
+  const size_t dot_position = filename.rfind('.');
+  if (dot_position != std::string::npos &&
+      filename.substr(dot_position) == ".pfm")
+    return write_pfm(filename, width, height, channel_count, values);
+
+  // Scale the values for viewing
+  const int total_pixels = width * height;
+  float max_value = 0;
+  if (channel_count == 1)
+    for (const float v : values)
+      if (std::isfinite(v)) max_value = std::max(max_value, v);
+  if (max_value <= 0) max_value = 1;
+
+  std::vector<Color> pixels(total_pixels);
+  for (int i = 0; i < total_pixels; i++) {
+    switch (type) {
+      case aov_type::depth: {
+        // Near is white, the sky is black
+        const float v =
+            std::isfinite(values[i]) ? 1 - values[i] / max_value : 0;
+        pixels[i] = vec3(v, v, v).to_color(255);
+        break;
+      }
+      case aov_type::normal:
+        pixels[i] = (0.5f * vec3(values[3 * i], values[3 * i + 1],
+                                 values[3 * i + 2]) +
+                     vec3(.5f, .5f, .5f))
+                        .to_color(255);
+        break;
+      case aov_type::albedo: {
+        vec3 v;
+        for (int c = 0; c < 3; c++)
+          v.e[c] = pow(clamp(values[3 * i + c], 0.0f, 1.0f), 1 / 2.2f);
+        pixels[i] = v.to_color(255);
+        break;
+      }
+      case aov_type::object_id:
+      case aov_type::material_id:
+        pixels[i] = id_color((uint32_t)values[i]);
+        break;
+      case aov_type::path_length:
+      case aov_type::bvh_visits: {
+        const float v = values[i] / max_value;
+        pixels[i] = vec3(v, v, v).to_color(255);
+        break;
+      }
+    }
+  }
+
+  Image image = {pixels.data(), width, height, 1,
+                 PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+  return ExportImage(image, filename.c_str());
+}
+
+bool aov_buffer::save_all(const std::string& prefix,
+                          const std::string& extension) const {
+  bool written = true;
+  for (const aov_type type : all_types) {
+    if (!has(type)) continue;
+
+    const std::string filename = prefix + "_" + name(type) + "." + extension;
+    if (!save(type, filename)) {
+      TraceLog(LOG_WARNING, "Could not write %s", filename.c_str());
+      written = false;
+    }
+  }
+  return written;
+}
+
+const char* aov_buffer::name(const aov_type type) {
+  switch (type) {
+    case aov_type::depth:
+      return "depth";
+    case aov_type::normal:
+      return "normal";
+    case aov_type::albedo:
+      return "albedo";
+    case aov_type::object_id:
+      return "object";
+    case aov_type::material_id:
+      return "material";
+    case aov_type::path_length:
+      return "path";
+    case aov_type::bvh_visits:
+      return "visits";
+  }
+  return "";
+}
+
+bool aov_buffer::parse(const std::string& list, aov_set& parsed) {
+  parsed = 0;
+
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (item == "all") {
+      for (const aov_type type : all_types) parsed |= aov_bit(type);
+      continue;
+    }
+
+    bool known = false;
+    for (const aov_type type : all_types) {
+      if (item == name(type)) {
+        parsed |= aov_bit(type);
+        known = true;
+      }
+    }
+    if (!known) return false;
+  }
+
+  return parsed != 0;
+}
@@ -0,0 +1,245 @@
+/**
+ * @file checkpoint_file.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the checkpoint_file class
+ * @version 0.1
+ * @date 2024-11-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/checkpoint_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const uint32_t checkpoint_magic = 0x43505246;  // "FRPC"
+const uint32_t checkpoint_version = 1;
+
+struct checkpoint_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t config_hash;
+  int32_t width;
+  int32_t height;
+  uint32_t current_slot;     // 0 before the first save, else 1 + the slot
+  uint32_t samples_done[2];  // Samples per pixel of each slot
+};
+
+struct checkpoint_pixel {
+  float sum[3];
+  float luminance_sq;
+  uint32_t samples;
+  float albedo[3];
+  float normal[3];
+  float depth;
+  uint32_t feature_samples;
+};
+
+}  // namespace
+
+#ifndef _WIN32
+
+bool checkpoint_file::open(const std::string& path,
+                           const uint64_t config_hash, const int width,
+                           const int height) {
+  close();
+
+  const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  auto page_align = [&](const size_t size) {
+    return (size + page - 1) / page * page;
+  };
+  pixel_count = (size_t)width * height;
+  slot_offset = page_align(sizeof(checkpoint_header));
+  slot_size = page_align(pixel_count * sizeof(checkpoint_pixel));
+  mapping_size = slot_offset + 2 * slot_size;
+
+  const int descriptor = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  struct stat status;
+  if (descriptor < 0 || fstat(descriptor, &status) != 0) {
+    TraceLog(LOG_ERROR, "Could not open the checkpoint %s: %s", path.c_str(),
+             strerror(errno));
+    if (descriptor >= 0) ::close(descriptor);
+    return false;
+  }
+
+  // Anything that is not a checkpoint of this render is started over
+  bool valid = (size_t)status.st_size == mapping_size;
+  if (valid) {
+    checkpoint_header header;
+    valid = pread(descriptor, &header, sizeof(header), 0) ==
+                (ssize_t)sizeof(header) &&
+            header.magic == checkpoint_magic &&
+            header.version == checkpoint_version &&
+            header.config_hash == config_hash && header.width == width &&
+            header.height == height && header.current_slot <= 2;
+    if (!valid && status.st_size > 0)
+      TraceLog(LOG_WARNING,
+               "The checkpoint %s belongs to another render, starting over",
+               path.c_str());
+  }
+  if (!valid && (ftruncate(descriptor, 0) != 0 ||
+                 ftruncate(descriptor, (off_t)mapping_size) != 0)) {
+    TraceLog(LOG_ERROR, "Could not resize the checkpoint %s: %s",
+             path.c_str(), strerror(errno));
+    ::close(descriptor);
+    return false;
+  }
+
+  void* mapped = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, descriptor, 0);
+  ::close(descriptor);  // The mapping keeps the file open
+  if (mapped == MAP_FAILED) {
+    TraceLog(LOG_ERROR, "Could not map the checkpoint %s: %s", path.c_str(),
+             strerror(errno));
+    return false;
+  }
+  mapping = (unsigned char*)mapped;
+
+  if (!valid) {
+    checkpoint_header header = {checkpoint_magic, checkpoint_version,
+                                config_hash, width, height, 0, {0, 0}};
+    memcpy(mapping, &header, sizeof(header));
+    msync(mapping, slot_offset, MS_SYNC);
+  }
+
+  stopping = false;
+  writing = false;
+  writer = std::thread(&checkpoint_file::write_slots, this);
+  return true;
+}
+
+void checkpoint_file::close() {
+  if (!mapping) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    changed.notify_all();
+  }
+  writer.join();
+
+  munmap(mapping, mapping_size);
+  mapping = nullptr;
+}
+
+void checkpoint_file::write_slots() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    changed.wait(lock, [&] { return writing || stopping; });
+    if (!writing) return;
+
+    const uint32_t index = written_slot;
+    const uint32_t samples = written_samples;
+    lock.unlock();
+
+    // The slot reaches the disk before the header points to it
+    msync(slot(index), slot_size, MS_SYNC);
+    checkpoint_header* header = (checkpoint_header*)mapping;
+    header->samples_done[index] = samples;
+    header->current_slot = index + 1;
+    msync(mapping, slot_offset, MS_SYNC);
+
+    lock.lock();
+    writing = false;
+    changed.notify_all();
+  }
+}
+
+#else  // _WIN32
+
+bool checkpoint_file::open(const std::string& path, const uint64_t,
+                           const int, const int) {
+  TraceLog(LOG_ERROR, "Checkpoints are not supported on this platform");
+  return false;
+}
+
+void checkpoint_file::close() {}
+void checkpoint_file::write_slots() {}
+
+#endif  // _WIN32
+
+uint32_t checkpoint_file::get_samples_done() const {
+  if (!mapping) return 0;
+
+  const checkpoint_header* header = (const checkpoint_header*)mapping;
+  if (header->current_slot == 0) return 0;
+  return header->samples_done[header->current_slot - 1];
+}
+
+void checkpoint_file::load(accumulation_buffer& accum,
+                           feature_buffer& features) const {
+  accum.reset();
+  features.reset();
+  if (get_samples_done() == 0) return;
+
+  const checkpoint_header* header = (const checkpoint_header*)mapping;
+  const checkpoint_pixel* pixels =
+      (const checkpoint_pixel*)slot(header->current_slot - 1);
+  for (size_t i = 0; i < pixel_count; i++) {
+    const checkpoint_pixel& p = pixels[i];
+    accum.add_samples((int)i, vec3(p.sum[0], p.sum[1], p.sum[2]),
+                      p.luminance_sq, p.samples);
+
+    pixel_features sum;
+    sum.albedo = vec3(p.albedo[0], p.albedo[1], p.albedo[2]);
+    sum.normal = vec3(p.normal[0], p.normal[1], p.normal[2]);
+    sum.depth = p.depth;
+    features.add_samples((int)i, sum, p.feature_samples);
+  }
+}
+
+bool checkpoint_file::save(const accumulation_buffer& accum,
+                           const feature_buffer& features,
+                           const uint32_t samples_done) {
+  if (!mapping) return false;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  if (writing) return false;
+  lock.unlock();
+
+  // The slot that is not current, no one else touches it
+  const checkpoint_header* header = (const checkpoint_header*)mapping;
+  const uint32_t index = header->current_slot == 1 ? 1 : 0;
+  checkpoint_pixel* pixels = (checkpoint_pixel*)slot(index);
+
+#ifdef USE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < (int)pixel_count; i++) {
+    checkpoint_pixel& p = pixels[i];
+    const vec3& sum = accum.get_sum(i);
+    const pixel_features hit_sum = features.get_sum(i);
+    for (int c = 0; c < 3; c++) {
+      p.sum[c] = sum.e[c];
+      p.albedo[c] = hit_sum.albedo.e[c];
+      p.normal[c] = hit_sum.normal.e[c];
+    }
+    p.luminance_sq = accum.get_luminance_sq_sum(i);
+    p.samples = accum.get_samples(i);
+    p.depth = hit_sum.depth;
+    p.feature_samples = features.get_samples(i);
+  }
+
+  lock.lock();
+  writing = true;
+  written_slot = index;
+  written_samples = samples_done;
+  changed.notify_all();
+  return true;
+}
+
+void checkpoint_file::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [&] { return !writing; });
+}
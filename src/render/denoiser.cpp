@@ -0,0 +1,257 @@
+/**
+ * @file denoiser.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the denoiser class
+ * @version 0.1
+ * @date 2024-11-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/denoiser.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// The B3 spline, the 1D kernel of every iteration
+const float kernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+
+// Albedo below this is clamped before dividing, black surfaces have no
+// lighting to recover anyway
+const float min_albedo = 0.01f;
+
+vec3 demodulate(const vec3& color, const vec3& albedo) {
+  return vec3(color.r() / std::max(albedo.r(), min_albedo),
+              color.g() / std::max(albedo.g(), min_albedo),
+              color.b() / std::max(albedo.b(), min_albedo));
+}
+
+vec3 remodulate(const vec3& irradiance, const vec3& albedo) {
+  return vec3(irradiance.r() * std::max(albedo.r(), min_albedo),
+              irradiance.g() * std::max(albedo.g(), min_albedo),
+              irradiance.b() * std::max(albedo.b(), min_albedo));
+}
+
+// x^exponent for the normal weight, without a call to pow for the usual
+// power of two exponents
+float normal_weight(const float cosine, const float exponent) {
+  if (cosine <= 0) return 0;
+  if (exponent != 128.0f) return std::pow(cosine, exponent);
+
+  float x = cosine;
+  for (int i = 0; i < 7; i++) x *= x;
+  return x;
+}
+
+}  // namespace
+
+void denoiser::denoise(const accumulation_buffer& accum,
+                       const feature_buffer& features,
+                       std::vector<vec3>& output) {
+  prepare(accum, features);
+
+  for (int i = 0; i < iterations; i++) {
+    blur_variance();
+    filter(1 << i);
+  }
+
+  const int total_pixels = width * height;
+  output.resize(total_pixels);
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < total_pixels; i++)
+    output[i] = valid[i] ? remodulate(irradiance[i], albedo[i])
+                         : accum.get_average(i);
+}
+
+void denoiser::denoise(const accumulation_buffer& accum,
+                       const feature_buffer& features,
+                       std::vector<Color>& pixels) {
+  std::vector<vec3> colors;
+  denoise(accum, features, colors);
+
+  const int total_pixels = width * height;
+  pixels.resize(total_pixels);
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < total_pixels; i++)
+    pixels[i] = accum.resolve_color(colors[i]);
+}
+
+void denoiser::prepare(const accumulation_buffer& accum,
+                       const feature_buffer& features) {
+  width = accum.get_width();
+  height = accum.get_height();
+  const int total_pixels = width * height;
+
+  albedo.resize(total_pixels);
+  normal.resize(total_pixels);
+  depth.resize(total_pixels);
+  depth_dx.resize(total_pixels);
+  depth_dy.resize(total_pixels);
+  valid.resize(total_pixels);
+  irradiance.resize(total_pixels);
+  next_irradiance.resize(total_pixels);
+  variance.resize(total_pixels);
+  next_variance.resize(total_pixels);
+  blurred_variance.resize(total_pixels);
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < total_pixels; i++) {
+    valid[i] = accum.get_samples(i) > 0 && features.get_samples(i) > 0;
+    albedo[i] = features.get_albedo(i);
+    // The mean normal of a silhouette pixel is shorter than one
+    const vec3 n = features.get_normal(i);
+    normal[i] = n.near_zero() ? n : unit_vector(n);
+    depth[i] = features.get_depth(i);
+    irradiance[i] = demodulate(accum.get_average(i), albedo[i]);
+
+    // A single sample says nothing about the noise, assume the worst: a
+    // standard deviation as large as the pixel itself
+    const float l = accumulation_buffer::luminance(irradiance[i]);
+    const float a = std::max(accumulation_buffer::luminance(albedo[i]),
+                             min_albedo);
+    const float v = accum.get_variance(i);
+    variance[i] = std::isfinite(v) ? v / (a * a) : l * l + 1.0f;
+  }
+
+  // The depth derivatives, from the neighbour closest in depth so that the
+  // silhouettes do not count as slopes
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      const int i = y * width + x;
+      const float left = x > 0 ? depth[i] - depth[i - 1] : infinity;
+      const float right = x < width - 1 ? depth[i + 1] - depth[i] : infinity;
+      const float up = y > 0 ? depth[i] - depth[i - width] : infinity;
+      const float down =
+          y < height - 1 ? depth[i + width] - depth[i] : infinity;
+
+      const float dx = std::abs(left) < std::abs(right) ? left : right;
+      const float dy = std::abs(up) < std::abs(down) ? up : down;
+      depth_dx[i] = std::isfinite(dx) ? dx : 0.0f;
+      depth_dy[i] = std::isfinite(dy) ? dy : 0.0f;
+    }
+  }
+}
+
+void denoiser::blur_variance() {
+  // 3x3 Gaussian, the variance of a single pixel is too noisy to be trusted
+  const float gaussian[2] = {1.0f / 2, 1.0f / 4};
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      const int i = y * width + x;
+      if (!valid[i]) {
+        blurred_variance[i] = variance[i];
+        continue;
+      }
+
+      float sum = 0;
+      float weight_sum = 0;
+      for (int dy = -1; dy <= 1; dy++) {
+        const int qy = y + dy;
+        if (qy < 0 || qy >= height) continue;
+        for (int dx = -1; dx <= 1; dx++) {
+          const int qx = x + dx;
+          if (qx < 0 || qx >= width) continue;
+
+          const int q = qy * width + qx;
+          if (!valid[q]) continue;
+
+          const float w = gaussian[std::abs(dx)] * gaussian[std::abs(dy)];
+          sum += w * variance[q];
+          weight_sum += w;
+        }
+      }
+      blurred_variance[i] = sum / weight_sum;
+    }
+  }
+}
+
+void denoiser::filter(const int step) {
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      const int p = y * width + x;
+      if (!valid[p]) {
+        next_irradiance[p] = irradiance[p];
+        next_variance[p] = variance[p];
+        continue;
+      }
+
+      const vec3& normal_p = normal[p];
+      const float depth_p = depth[p];
+      const float luminance_p = accumulation_buffer::luminance(irradiance[p]);
+      const float luminance_scale =
+          1.0f / (sigma_luminance * std::sqrt(blurred_variance[p]) + 1e-4f);
+      // Flat regions facing the camera have no depth gradient, allow a
+      // small relative difference there
+      const float depth_epsilon = 1e-3f * depth_p;
+
+      vec3 color_sum(0, 0, 0);
+      float variance_sum = 0;
+      float weight_sum = 0;
+
+      for (int ky = -2; ky <= 2; ky++) {
+        const int qy = y + ky * step;
+        if (qy < 0 || qy >= height) continue;
+
+        for (int kx = -2; kx <= 2; kx++) {
+          const int qx = x + kx * step;
+          if (qx < 0 || qx >= width) continue;
+
+          const int q = qy * width + qx;
+          if (!valid[q]) continue;
+
+          const float expected_depth = std::abs(
+              depth_dx[p] * (kx * step) + depth_dy[p] * (ky * step));
+          const float depth_distance =
+              std::abs(depth_p - depth[q]) /
+              (sigma_depth * expected_depth + depth_epsilon);
+          const float luminance_distance =
+              std::abs(luminance_p -
+                       accumulation_buffer::luminance(irradiance[q])) *
+              luminance_scale;
+
+          const float w =
+              kernel[kx + 2] * kernel[ky + 2] *
+              normal_weight(dot(normal_p, normal[q]), sigma_normal) *
+              std::exp(-depth_distance - luminance_distance);
+
+          color_sum += w * irradiance[q];
+          variance_sum += w * w * variance[q];
+          weight_sum += w;
+        }
+      }
+
+      // The center tap always has a weight, unless its normal is degenerate
+      if (weight_sum <= 0) {
+        next_irradiance[p] = irradiance[p];
+        next_variance[p] = variance[p];
+        continue;
+      }
+
+      next_irradiance[p] = color_sum / weight_sum;
+      next_variance[p] = variance_sum / (weight_sum * weight_sum);
+    }
+  }
+
+  irradiance.swap(next_irradiance);
+  variance.swap(next_variance);
+}
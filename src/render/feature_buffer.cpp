@@ -0,0 +1,29 @@
+/**
+ * @file feature_buffer.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the feature_buffer class
+ * @version 0.1
+ * @date 2024-11-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/feature_buffer.hpp"
+
+#include <algorithm>
+
+feature_buffer::feature_buffer(const int width, const int height)
+    : width(width),
+      height(height),
+      albedo(width * height, vec3(0, 0, 0)),
+      normal(width * height, vec3(0, 0, 0)),
+      depth(width * height, 0.0f),
+      samples(width * height, 0) {}
+
+void feature_buffer::reset() {
+  std::fill(albedo.begin(), albedo.end(), vec3(0, 0, 0));
+  std::fill(normal.begin(), normal.end(), vec3(0, 0, 0));
+  std::fill(depth.begin(), depth.end(), 0.0f);
+  std::fill(samples.begin(), samples.end(), 0);
+}
@@ -0,0 +1,97 @@
+/**
+ * @file frame_budget.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the frame_budget class
+ * @version 0.1
+ * @date 2024-11-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/frame_budget.hpp"
+
+#include <algorithm>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+// Weight of the newest measurement in the moving average of the ray cost
+static const float smoothing = 0.3f;
+
+frame_budget::frame_budget(const float target_fps, const size_t initial_budget)
+    : budget(std::max<size_t>(1, initial_budget)) {
+  set_target_fps(target_fps);
+
+#ifdef USE_OPENMP
+  threads.resize(omp_get_max_threads());
+#else
+  threads.resize(1);
+#endif
+}
+
+void frame_budget::set_target_fps(const float target_fps) {
+  target_frame_time = 1.0f / std::max(1.0f, target_fps);
+}
+
+void frame_budget::begin_batch() {
+  // The number of threads may have changed since the last batch
+#ifdef USE_OPENMP
+  threads.assign(omp_get_max_threads(), thread_stats());
+#else
+  threads.assign(1, thread_stats());
+#endif
+  batch_start = Clock::now();
+}
+
+void frame_budget::end_batch(const size_t rays) {
+  batch_time =
+      std::chrono::duration_cast<Secondsf>(Clock::now() - batch_start).count();
+  achieved_rays = rays;
+  if (rays == 0 || batch_time <= 0) return;
+
+  const float measured = batch_time / rays;
+  seconds_per_ray = seconds_per_ray == 0
+                        ? measured
+                        : smoothing * measured +
+                              (1 - smoothing) * seconds_per_ray;
+
+  // Fill the render share of the next frame, but never change the budget by
+  // more than a factor of two at once so that one odd batch (a camera cut,
+  // a frame of sky) cannot make it swing
+  const float target = render_share * target_frame_time / seconds_per_ray;
+  const float limited = clamp(target, budget / 2.0f, budget * 2.0f);
+  budget = std::max<size_t>(1, (size_t)limited);
+}
+
+void frame_budget::end_frame() {
+  const auto now = Clock::now();
+  const bool first_frame =
+      frame_start == std::chrono::time_point<Clock>();
+  frame_time = first_frame
+                   ? 0
+                   : std::chrono::duration_cast<Secondsf>(now - frame_start)
+                         .count();
+  frame_start = now;
+  if (first_frame) return;
+
+  // The rest of the frame (events, upload, drawing) is not measured, so
+  // back off quickly when the frames run late and win the time back slowly
+  if (frame_time > 1.1f * target_frame_time)
+    render_share = std::max(0.2f, render_share * 0.9f);
+  else
+    render_share = std::min(0.9f, render_share + 0.01f);
+}
+
+float frame_budget::get_rays_per_second() const {
+  return seconds_per_ray > 0 ? 1.0f / seconds_per_ray : 0.0f;
+}
+
+float frame_budget::get_thread_utilization() const {
+  if (batch_time <= 0) return 0;
+
+  float busy = 0;
+  for (const thread_stats& stats : threads) busy += stats.busy_time;
+  return std::min(1.0f, busy / (batch_time * threads.size()));
+}
@@ -0,0 +1,486 @@
+/**
+ * @file render_engine.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the render_engine class
+ * @version 0.1
+ * @date 2024-11-12
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/render_engine.hpp"
+
+#include <algorithm>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+render_engine::render_engine(const int screen_width, const int screen_height)
+    : screen_width(screen_width),
+      screen_height(screen_height),
+      accum(screen_width, screen_height),
+      scheduler(screen_width, screen_height),
+      pixels(screen_width * screen_height, Color{0, 0, 0, 255}),
+      geometry(screen_width, screen_height),
+      previous_geometry(screen_width, screen_height),
+      history(screen_width, screen_height),
+      features(screen_width, screen_height),
+      history_features(screen_width, screen_height),
+      front(screen_width * screen_height, Color{0, 0, 0, 255}) {}
+
+render_engine::~render_engine() { stop(); }
+
+void render_engine::start(hittable_list* world, const camera& cam) {
+  stop();
+
+  this->world = world;
+  this->cam = cam;
+  stopping = false;
+  restart();
+
+  worker = std::thread(&render_engine::run, this);
+}
+
+void render_engine::stop() {
+  if (!worker.joinable()) return;
+
+  {
+    std::lock_guard<std::mutex> lock(command_mutex);
+    stopping = true;
+  }
+  interrupted = true;
+  command_ready.notify_one();
+  worker.join();
+}
+
+void render_engine::post(const render_command& command) {
+  {
+    std::lock_guard<std::mutex> lock(command_mutex);
+    // Under the lock, so that the worker cannot take the command and clear
+    // the flag before it is set, which would abort the next batch
+    if (command.restarts()) interrupted = true;
+    commands.push_back(command);
+  }
+  command_ready.notify_one();
+}
+
+void render_engine::set_camera(const camera& cam) {
+  render_command command;
+  command.type = render_command_type::set_camera;
+  command.cam = cam;
+  post(command);
+}
+
+void render_engine::reset() {
+  render_command command;
+  command.type = render_command_type::reset;
+  post(command);
+}
+
+void render_engine::set_deterministic(const bool enabled,
+                                      const uint32_t seed) {
+  deterministic = enabled;
+  this->seed = seed;
+  if (enabled) {
+    scheduler.set_shuffle_seed(seed);
+    scheduler.set_order(scheduler.get_order());
+  }
+}
+
+void render_engine::set_tile_order(const tile_order order) {
+  render_command command;
+  command.type = render_command_type::set_tile_order;
+  command.order = order;
+  post(command);
+}
+
+void render_engine::set_heatmap(const bool enabled) {
+  render_command command;
+  command.type = render_command_type::set_heatmap;
+  command.enabled = enabled;
+  post(command);
+}
+
+void render_engine::set_denoise(const bool enabled) {
+  render_command command;
+  command.type = render_command_type::set_denoise;
+  command.enabled = enabled;
+  post(command);
+}
+
+render_stats render_engine::get_stats() {
+  std::lock_guard<std::mutex> lock(frame_mutex);
+  return stats;
+}
+
+void render_engine::run() {
+  std::vector<render_command> pending;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(command_mutex);
+      if (previewing && preview_rendered) {
+        // Keep the preview until the camera moves again or stands still
+        // long enough
+        command_ready.wait_until(lock, preview_deadline, [this] {
+          return stopping || !commands.empty();
+        });
+      } else {
+        // Sleep once the image is done, until the UI asks for something
+        command_ready.wait(lock, [this] {
+          return stopping || !commands.empty() || !is_done();
+        });
+      }
+      if (stopping) return;
+
+      pending.swap(commands);
+      interrupted = false;
+    }
+
+    apply(pending);
+    pending.clear();
+
+    if (previewing && !preview_rendered) {
+      render_preview();
+      preview_rendered = true;
+    } else if (previewing && Clock::now() >= preview_deadline) {
+      // The camera stopped, the full resolution passes replace the preview
+      // tile by tile
+      previewing = false;
+    } else if (!previewing && !is_done()) {
+      render_batch();
+      // The filter spreads every new sample over its neighbours, so the
+      // whole image changes
+      if (denoising && !show_heatmap && !interrupted) resolve_frame();
+    }
+    publish();
+  }
+}
+
+void render_engine::apply(const std::vector<render_command>& pending) {
+  const camera previous = cam;
+  bool camera_moved = false;
+  bool restart_needed = false;
+
+  for (const render_command& command : pending) {
+    switch (command.type) {
+      case render_command_type::set_camera:
+        cam = command.cam;
+        camera_moved = true;
+        break;
+      case render_command_type::reset:
+        restart_needed = true;
+        previewing = false;
+        break;
+      case render_command_type::set_tile_order:
+        scheduler.set_order(command.order);
+        restart_needed = true;
+        previewing = false;
+        break;
+      case render_command_type::set_heatmap:
+        show_heatmap = command.enabled;
+        if (!show_heatmap) resolve_frame();
+        full_frame = true;
+        break;
+      case render_command_type::set_denoise:
+        denoising = command.enabled;
+        denoise_time = 0;
+        if (!show_heatmap && !previewing) resolve_frame();
+        break;
+    }
+  }
+
+  // A burst of camera moves only restarts (or reprojects) the image once
+  float kept = 0;
+  if (camera_moved && !restart_needed && temporal)
+    kept = reproject(previous);
+  else if (camera_moved || restart_needed)
+    restart();
+
+  // Show the preview when most of the image has to be traced again
+  if (camera_moved && kept < 0.5f && preview_scale != 1) {
+    previewing = true;
+    preview_rendered = false;
+    preview_deadline =
+        Clock::now() +
+        std::chrono::duration_cast<Clock::duration>(Secondsf(preview_hold));
+  } else if (camera_moved) {
+    previewing = false;
+  }
+}
+
+void render_engine::restart() {
+  std::fill(pixels.begin(), pixels.end(), Color{0, 0, 0, 255});
+  accum.reset();
+  features.reset();
+  restart_passes();
+
+  if (temporal)
+    geometry.build(cam, world);
+  else
+    geometry.invalidate();
+}
+
+void render_engine::restart_passes() {
+  scheduler.activate_all_tiles();
+
+  start_index = 0;
+  passes = 0;
+  converged = false;
+  full_frame = true;
+  finished.clear();
+}
+
+float render_engine::reproject(const camera& previous) {
+  if (!geometry.is_valid()) {
+    restart();
+    return 0;
+  }
+
+  // The current buffers become the history of the new view
+  std::swap(geometry, previous_geometry);
+  std::swap(accum, history);
+  std::swap(features, history_features);
+  geometry.build(cam, world);
+  accum.reset();
+  features.reset();
+
+  const size_t kept =
+      reprojection.reproject(previous, previous_geometry, history, cam,
+                             geometry, accum, &history_features, &features);
+  TraceLog(LOG_DEBUG, "Reprojected %zu/%d pixels", kept,
+           screen_width * screen_height);
+
+  // Every tile gets new samples again, starting from the history
+  resolve_frame();
+  restart_passes();
+
+  return (float)kept / (screen_width * screen_height);
+}
+
+void render_engine::resolve_frame() {
+  if (denoising) {
+    const auto start = Clock::now();
+    filter.denoise(accum, features, pixels);
+    denoise_time =
+        std::chrono::duration_cast<Secondsf>(Clock::now() - start).count();
+  } else {
+    accum.resolve(pixels);
+  }
+  full_frame = true;
+}
+
+void render_engine::render_batch() {
+  // Round the budget up to whole tiles
+  const size_t rays_to_send = budget.get_budget();
+  const int tile_pixels = scheduler.get_tile_size() * scheduler.get_tile_size();
+  const size_t tiles_to_send = (rays_to_send + tile_pixels - 1) / tile_pixels;
+  const size_t end_index =
+      std::min(start_index + tiles_to_send, scheduler.active_tile_count());
+
+  // The tiles that were traced, an interrupted batch skips the others
+  size_t rays_sent = 0;
+  std::mutex finished_mutex;
+
+  budget.begin_batch();
+
+  // Calculate each pixel color, tile by tile
+  scheduler.dispatch(start_index, end_index, [&](const tile& t) {
+    // A command that restarts the image is waiting, the rest of the batch
+    // would be thrown away
+    if (interrupted.load(std::memory_order_relaxed)) return;
+
+    const auto tile_start = Clock::now();
+
+    scheduler.for_each_pixel_group(
+        t, packet_size, [&](const int* xs, const int* ys, int count) {
+          float i[ray_packet::max_size] = {};
+          float j[ray_packet::max_size] = {};
+          sampler samplers[ray_packet::max_size];
+          vec3 colors[ray_packet::max_size];
+          pixel_features hits[ray_packet::max_size];
+          for (int p = 0; p < count; p++) {
+            const int index = ys[p] * screen_width + xs[p];
+            samplers[p] = sampler(sampling, seed, deterministic);
+            samplers[p].start_pixel_sample(index, accum.get_samples(index));
+
+            float u, v;
+            samplers[p].get_2d(u, v);
+            i[p] = xs[p] + u - 0.5f;
+            j[p] = ys[p] + v - 0.5f;
+          }
+
+          // The features are always gathered, so that the denoiser can be
+          // turned on at any time
+          cam.send_packet(world, i, j, count, samplers, colors, nullptr,
+                          hits);
+
+          for (int p = 0; p < count; p++) {
+            const int index = ys[p] * screen_width + xs[p];
+            accum.add_sample(index, colors[p]);
+            features.add_sample(index, hits[p]);
+          }
+        });
+
+    // Tonemap the tile once, after all of its samples are in. The denoiser
+    // resolves the whole image after the batch instead.
+    if (!denoising)
+      for (int y = t.y0; y < t.y1; y++)
+        for (int x = t.x0; x < t.x1; x++)
+          pixels[y * screen_width + x] = accum.resolve(y * screen_width + x);
+
+#ifdef USE_OPENMP
+    const int thread = omp_get_thread_num();
+#else
+    const int thread = 0;
+#endif
+    budget.add_thread_work(
+        thread, t.pixel_count(),
+        std::chrono::duration_cast<Secondsf>(Clock::now() - tile_start)
+            .count());
+
+    std::lock_guard<std::mutex> lock(finished_mutex);
+    finished.push_back(t);
+    rays_sent += t.pixel_count();
+  });
+
+  budget.end_batch(rays_sent);
+  budget.end_frame();
+
+  // The image restarts before the next batch anyway. Otherwise the batch
+  // counts as done: the tiles it skipped get their sample in the next pass
+  // rather than the traced ones a second sample in this one.
+  if (interrupted && restart_pending()) return;
+  start_index = end_index;
+
+  if (start_index >= scheduler.active_tile_count()) {
+    start_index = 0;
+    passes++;
+
+    // Once every pixel has enough samples to estimate its error, only keep
+    // sampling the tiles that have not converged yet
+    if (passes >= (int)adaptive.get_min_samples()) {
+      converged = adaptive.update(scheduler, accum) == 0;
+      TraceLog(LOG_INFO, "Render %d/%d, %zu/%zu tiles left", passes,
+               max_passes, scheduler.active_tile_count(),
+               scheduler.tile_count());
+    } else {
+      TraceLog(LOG_INFO, "Render %d/%d", passes, max_passes);
+    }
+  }
+}
+
+bool render_engine::restart_pending() {
+  std::lock_guard<std::mutex> lock(command_mutex);
+  if (stopping) return true;
+  for (const render_command& command : commands)
+    if (command.restarts()) return true;
+  return false;
+}
+
+void render_engine::render_preview() {
+  // The finest scale whose rays fit in the budget of one frame
+  int scale = preview_scale;
+  if (scale < 2) {
+    const size_t rays = budget.get_budget();
+    scale = 2;
+    while (scale < 8 &&
+           (size_t)(screen_width / scale) * (screen_height / scale) > rays)
+      scale *= 2;
+  }
+  last_preview_scale = scale;
+
+  const int preview_width = (screen_width + scale - 1) / scale;
+  const int preview_height = (screen_height + scale - 1) / scale;
+  preview_colors.resize(preview_width * preview_height);
+
+  // Short paths are enough to find your way around the scene
+  camera preview_cam = cam;
+  preview_cam.set_max_depth(std::min(preview_depth, cam.get_max_depth()));
+
+  // One ray through the center of every block of scale x scale pixels
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int y = 0; y < preview_height; y++) {
+    for (int x = 0; x < preview_width; x++) {
+      const float px = std::min((x + 0.5f) * scale, (float)screen_width) - .5f;
+      const float py =
+          std::min((y + 0.5f) * scale, (float)screen_height) - .5f;
+
+      sampler s(sampling, seed, deterministic);
+      s.start_pixel_sample((int)py * screen_width + (int)px, 0);
+
+      preview_colors[y * preview_width + x] =
+          preview_cam.send_ray(world, px, py, s);
+    }
+  }
+
+  // Bilinear upsample of the linear colors to the back buffer
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int y = 0; y < screen_height; y++) {
+    const float fy = clamp((y + 0.5f) / scale - 0.5f, 0.0f,
+                           (float)(preview_height - 1));
+    const int y0 = (int)fy;
+    const int y1 = std::min(y0 + 1, preview_height - 1);
+    const float ty = fy - y0;
+
+    for (int x = 0; x < screen_width; x++) {
+      const float fx = clamp((x + 0.5f) / scale - 0.5f, 0.0f,
+                             (float)(preview_width - 1));
+      const int x0 = (int)fx;
+      const int x1 = std::min(x0 + 1, preview_width - 1);
+      const float tx = fx - x0;
+
+      const vec3 top = (1 - tx) * preview_colors[y0 * preview_width + x0] +
+                       tx * preview_colors[y0 * preview_width + x1];
+      const vec3 bottom = (1 - tx) * preview_colors[y1 * preview_width + x0] +
+                          tx * preview_colors[y1 * preview_width + x1];
+      pixels[y * screen_width + x] =
+          accum.resolve_color((1 - ty) * top + ty * bottom);
+    }
+  }
+
+  full_frame = true;
+}
+
+void render_engine::publish() {
+  if (show_heatmap) {
+    accum.resolve_heatmap(pixels);
+    full_frame = true;
+  }
+
+  std::lock_guard<std::mutex> lock(frame_mutex);
+
+  if (full_frame || dirty.size() + finished.size() > scheduler.tile_count()) {
+    // Cheaper to send the whole image than a long list of tiles
+    front = pixels;
+    dirty.assign(1, tile{0, 0, screen_width, screen_height});
+  } else {
+    for (const tile& t : finished) {
+      for (int y = t.y0; y < t.y1; y++)
+        std::copy(pixels.begin() + y * screen_width + t.x0,
+                  pixels.begin() + y * screen_width + t.x1,
+                  front.begin() + y * screen_width + t.x0);
+      dirty.push_back(t);
+    }
+  }
+  full_frame = false;
+  finished.clear();
+
+  stats.budget = budget.get_budget();
+  stats.achieved_rays = budget.get_achieved_rays();
+  stats.batch_time = budget.get_batch_time();
+  stats.rays_per_second = budget.get_rays_per_second();
+  stats.thread_utilization = budget.get_thread_utilization();
+  stats.passes = passes;
+  stats.active_tiles = scheduler.active_tile_count();
+  stats.tile_count = scheduler.tile_count();
+  stats.done = !previewing && is_done();
+  stats.preview_scale = previewing ? last_preview_scale : 0;
+  stats.denoise_time = denoising ? denoise_time : 0;
+}
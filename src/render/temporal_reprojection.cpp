@@ -0,0 +1,113 @@
+/**
+ * @file temporal_reprojection.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the geometry_buffer and temporal_reprojection classes
+ * @version 0.1
+ * @date 2024-11-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/temporal_reprojection.hpp"
+
+geometry_buffer::geometry_buffer(const int width, const int height)
+    : width(width),
+      height(height),
+      distance(width * height, infinity),
+      normal(width * height),
+      direction(width * height) {}
+
+void geometry_buffer::build(const camera& cam, hittable_list* world) {
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int y = 0; y < height; y++) {
+    // Only the defocus blur draws from the sampler, the centers are fixed
+    sampler s;
+    for (int x = 0; x < width; x++) {
+      const int index = y * width + x;
+      s.start_pixel_sample(index, 0);
+      const ray r = cam.get_ray((float)x, (float)y, s);
+      const float length = r.direction().length();
+      direction[index] = r.direction() / length;
+
+      hit_record rec;
+      if (world->hit(r, interval(.0001f, infinity), rec)) {
+        distance[index] = rec.t * length;
+        normal[index] = rec.normal;
+      } else {
+        distance[index] = infinity;
+        normal[index] = vec3(0, 0, 0);
+      }
+    }
+  }
+
+  valid = true;
+}
+
+temporal_reprojection::temporal_reprojection(const uint32_t max_history,
+                                             const float depth_tolerance,
+                                             const float normal_tolerance)
+    : max_history(max_history),
+      depth_tolerance(depth_tolerance),
+      normal_tolerance(normal_tolerance) {}
+
+size_t temporal_reprojection::reproject(
+    const camera& previous, const geometry_buffer& previous_geometry,
+    const accumulation_buffer& previous_accum, const camera& current,
+    const geometry_buffer& current_geometry,
+    accumulation_buffer& current_accum,
+    const feature_buffer* previous_features,
+    feature_buffer* current_features) const {
+  const int width = current_geometry.get_width();
+  const int height = current_geometry.get_height();
+  const int previous_width = previous_geometry.get_width();
+  const int total_pixels = width * height;
+  size_t kept = 0;
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : kept)
+#endif
+  for (int i = 0; i < total_pixels; i++) {
+    const float distance = current_geometry.get_distance(i);
+    const bool hit = distance != infinity;
+    const vec3 point =
+        hit ? current.get_position() +
+                  distance * current_geometry.get_direction(i)
+            : vec3(0, 0, 0);
+
+    // Where the previous view saw the same surface (or the same part of the
+    // sky, which only depends on the direction)
+    float px, py;
+    const bool visible =
+        hit ? previous.project(point, px, py)
+            : previous.project_direction(current_geometry.get_direction(i),
+                                         px, py);
+    if (!visible) continue;
+
+    const int j = (int)(py + 0.5f) * previous_width + (int)(px + 0.5f);
+    if (previous_accum.get_samples(j) == 0) continue;
+
+    const float previous_distance = previous_geometry.get_distance(j);
+    if (hit != (previous_distance != infinity)) continue;
+
+    if (hit) {
+      // Something else was in front of the surface before (or the pixel
+      // sees a different surface): a disocclusion
+      const float expected = (point - previous.get_position()).length();
+      if (fabs(previous_distance - expected) > depth_tolerance * expected)
+        continue;
+      if (dot(previous_geometry.get_normal(j),
+              current_geometry.get_normal(i)) < normal_tolerance)
+        continue;
+    }
+
+    current_accum.copy_pixel(i, previous_accum, j, max_history);
+    if (previous_features && current_features)
+      current_features->copy_pixel(i, *previous_features, j);
+    kept++;
+  }
+
+  return kept;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file tile_scheduler.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the tile_scheduler class
+ * @version 0.1
+ * @date 2024-10-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/tile_scheduler.hpp"
+
+#include <algorithm>
+
+tile_scheduler::tile_scheduler(const int screen_width, const int screen_height,
+                               const int tile_size, const tile_order order)
+    : screen_width(screen_width),
+      screen_height(screen_height),
+      tile_size(tile_size < 1 ? 1 : tile_size),
+      order(order) {
+  build_tiles();
+  build_pixel_order();
+}
+
+void tile_scheduler::set_order(const tile_order new_order) {
+  order = new_order;
+  build_tiles();
+}
+
+void tile_scheduler::activate_all_tiles() {
+  active.resize(tiles.size());
+  std::iota(active.begin(), active.end(), 0);
+}
+
+void tile_scheduler::build_tiles() {
+  tiles.clear();
+  for (int y = 0; y < screen_height; y += tile_size)
+    for (int x = 0; x < screen_width; x += tile_size)
+      tiles.push_back({x, y, std::min(x + tile_size, screen_width),
+                       std::min(y + tile_size, screen_height)});
+
+  switch (order) {
+    case tile_order::scanline:
+      break;
+    case tile_order::spiral: {
+      // Sort by the distance of the tile center to the screen center
+      const float cx = screen_width * 0.5f;
+      const float cy = screen_height * 0.5f;
+      auto distance = [cx, cy](const tile& t) {
+        const float dx = (t.x0 + t.x1) * 0.5f - cx;
+        const float dy = (t.y0 + t.y1) * 0.5f - cy;
+        return dx * dx + dy * dy;
+      };
+      std::stable_sort(tiles.begin(), tiles.end(),
+                       [&distance](const tile& a, const tile& b) {
+                         return distance(a) < distance(b);
+                       });
+      break;
+    }
+    case tile_order::random: {
+      // Fisher-Yates with our own generator, std::shuffle differs between
+      // standard libraries
+      rng generator(seeded ? shuffle_seed : std::random_device()());
+      for (size_t i = tiles.size(); i > 1; i--)
+        std::swap(tiles[i - 1], tiles[generator.next_uint((uint32_t)i)]);
+      break;
+    }
+  }
+
+  activate_all_tiles();
+}
+
+void tile_scheduler::build_pixel_order() {
+  // Interleave the bits of x and y to get the Morton code of every offset
+  auto morton = [](uint x, uint y) {
+    uint code = 0;
+    for (uint bit = 0; bit < 16; bit++) {
+      code |= ((x >> bit) & 1u) << (2 * bit);
+      code |= ((y >> bit) & 1u) << (2 * bit + 1);
+    }
+    return code;
+  };
+
+  pixel_order.clear();
+  for (int y = 0; y < tile_size; y++)
+    for (int x = 0; x < tile_size; x++) pixel_order.emplace_back(x, y);
+
+  std::sort(pixel_order.begin(), pixel_order.end(),
+            [&morton](const std::pair<int, int>& a,
+                      const std::pair<int, int>& b) {
+              return morton(a.first, a.second) < morton(b.first, b.second);
+            });
+}
+
+void tile_scheduler::seed_queues(const size_t first, const size_t last,
+                                 const int threads) {
+  if (queue_count != threads) {
+    queues.reset(new work_queue[threads]);
+    queue_count = threads;
+  }
+
+  // Give every thread a contiguous run of tiles so that, for the scanline and
+  // spiral orders, each thread works on its own region of the screen
+  const size_t count = last - first;
+  for (int i = 0; i < threads; i++) {
+    queues[i].begin = first + count * i / threads;
+    queues[i].end = first + count * (i + 1) / threads;
+  }
+}
+
+bool tile_scheduler::next_tile(const int thread, size_t& index) {
+  work_queue& own = queues[thread];
+  {
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (own.begin < own.end) {
+      index = own.begin++;
+      return true;
+    }
+  }
+
+  // Our queue is empty, steal the back half of the first non-empty queue
+  for (int i = 1; i < queue_count; i++) {
+    work_queue& victim = queues[(thread + i) % queue_count];
+
+    size_t stolen_begin, stolen_end;
+    {
+      std::lock_guard<std::mutex> guard(victim.lock);
+      if (victim.begin >= victim.end) continue;
+
+      const size_t remaining = victim.end - victim.begin;
+      stolen_end = victim.end;
+      stolen_begin = victim.end - (remaining + 1) / 2;
+      victim.end = stolen_begin;
+    }
+
+    // Keep the first stolen tile and queue the rest for ourselves
+    std::lock_guard<std::mutex> guard(own.lock);
+    index = stolen_begin;
+    own.begin = stolen_begin + 1;
+    own.end = stolen_end;
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,289 @@
+/**
+ * @file wavefront_integrator.cpp
+ * @author Bogdan Ciurea (ciureabogdanalexandru@gmail.com)
+ * @brief Implementing the wavefront_integrator class
+ * @version 0.1
+ * @date 2024-10-30
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "render/wavefront_integrator.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <typeindex>
+#include <unordered_map>
+
+wavefront_integrator::wavefront_integrator(const size_t batch_size)
+    : batch_size(batch_size < 1 ? 1 : batch_size) {}
+
+size_t wavefront_integrator::render(const camera& cam, hittable_list* world,
+                                    const std::vector<int>& pixels,
+                                    const uint32_t samples_per_pixel,
+                                    accumulation_buffer& accum,
+                                    feature_buffer* features) {
+  const size_t total_samples = pixels.size() * samples_per_pixel;
+  size_t rays_traced = 0;
+
+  // A batch can end in the middle of the samples of a pixel, so the sample
+  // numbers are counted from the state before the first batch
+  first_index.resize(pixels.size());
+  for (size_t p = 0; p < pixels.size(); p++)
+    first_index[p] = accum.get_samples(pixels[p]);
+
+  for (size_t first = 0; first < total_samples; first += batch_size) {
+    const size_t count = std::min(batch_size, total_samples - first);
+
+    generate(cam, pixels, accum.get_width(), samples_per_pixel, first, count);
+
+    // Advance every path of the batch by one bounce until none is left
+    size_t paths = count;
+    bool first_bounce = true;
+    while (paths > 0) {
+      intersect(world, paths);
+      if (features && first_bounce) record_first_hits(paths);
+      first_bounce = false;
+      sort_by_material(paths);
+      shade(cam);
+      paths = compact();
+    }
+
+    // Add the samples to their pixels. The samples of a pixel are next to
+    // each other, so every pixel is written by a single iteration.
+    const int first_pixel = (int)(first / samples_per_pixel);
+    const int last_pixel = (int)((first + count - 1) / samples_per_pixel);
+    size_t batch_rays = 0;
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : batch_rays)
+#endif
+    for (int p = first_pixel; p <= last_pixel; p++) {
+      const size_t begin = std::max((size_t)p * samples_per_pixel, first);
+      const size_t end =
+          std::min((size_t)(p + 1) * samples_per_pixel, first + count);
+
+      vec3 color(0, 0, 0);
+      float luminance_sq = 0;
+      uint32_t kept = 0;
+      for (size_t s = begin; s < end; s++) {
+        accumulation_buffer::accumulate(radiance[s - first], color,
+                                        luminance_sq, kept);
+        batch_rays += path_length[s - first];
+      }
+
+      accum.add_samples(pixels[p], color, luminance_sq, kept);
+
+      if (features) {
+        pixel_features sum = pixel_features::zero();
+        for (size_t s = begin; s < end; s++) sum += first_hit[s - first];
+        features->add_samples(pixels[p], sum, (uint32_t)(end - begin));
+      }
+    }
+
+    rays_traced += batch_rays;
+  }
+
+  return rays_traced;
+}
+
+void wavefront_integrator::generate(const camera& cam,
+                                    const std::vector<int>& pixels,
+                                    const int screen_width,
+                                    const uint32_t samples_per_pixel,
+                                    const size_t first_sample,
+                                    const size_t sample_count) {
+  if (rays.size() < sample_count) {
+    rays.resize(sample_count);
+    throughput.resize(sample_count);
+    slot.resize(sample_count);
+    depth.resize(sample_count);
+    recs.resize(sample_count);
+    hit.resize(sample_count);
+    order.resize(sample_count);
+    next_rays.resize(sample_count);
+    next_throughput.resize(sample_count);
+    next_slot.resize(sample_count);
+    next_depth.resize(sample_count);
+    samplers.resize(sample_count);
+    radiance.resize(sample_count);
+    path_length.resize(sample_count);
+  }
+
+  const int count = (int)sample_count;
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < count; i++) {
+    const size_t p = (first_sample + i) / samples_per_pixel;
+    const uint32_t s = (first_sample + i) % samples_per_pixel;
+    const int pixel = pixels[p];
+
+    samplers[i] = sampler(sampling, sampler_seed, sampler_deterministic);
+    samplers[i].start_pixel_sample(pixel, first_index[p] + s);
+
+    float u, v;
+    samplers[i].get_2d(u, v);
+    const float x = pixel % screen_width + u - 0.5f;
+    const float y = pixel / screen_width + v - 0.5f;
+
+    rays[i] = cam.get_ray(x, y, samplers[i]);
+    throughput[i] = vec3(1.0f, 1.0f, 1.0f);
+    slot[i] = i;
+    depth[i] = 1;
+    radiance[i] = vec3(0, 0, 0);
+    path_length[i] = 0;
+  }
+}
+
+void wavefront_integrator::intersect(hittable_list* world,
+                                     const size_t path_count) {
+  const int count = (int)path_count;
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+  for (int i = 0; i < count; i++) {
+    hit[i] = world->hit(rays[i], interval(.0001f, infinity), recs[i]);
+
+    // The ray escaped, so the path picks up the sky color and ends here
+    if (!hit[i]) {
+      radiance[slot[i]] = throughput[i] * camera::background(rays[i]);
+      path_length[slot[i]] = depth[i];
+    }
+  }
+}
+
+void wavefront_integrator::record_first_hits(const size_t path_count) {
+  if (first_hit.size() < path_count) first_hit.resize(path_count);
+  const int count = (int)path_count;
+
+  // Before the first compaction every path is still in its own slot
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < count; i++)
+    first_hit[slot[i]] =
+        camera::first_hit_features(rays[i], hit[i] != 0, recs[i]);
+}
+
+void wavefront_integrator::sort_by_material(const size_t path_count) {
+  // Give every material seen in this bounce a bucket
+  std::unordered_map<const material*, uint32_t> buckets;
+  std::vector<const material*> materials;
+  std::vector<uint32_t> keys(path_count);
+
+  const material* last_material = nullptr;
+  uint32_t last_bucket = 0;
+  for (size_t i = 0; i < path_count; i++) {
+    if (!hit[i]) continue;
+
+    const material* mat = recs[i].mat_ptr;
+    if (mat != last_material) {
+      auto found = buckets.find(mat);
+      if (found == buckets.end()) {
+        found = buckets.emplace(mat, (uint32_t)materials.size()).first;
+        materials.push_back(mat);
+      }
+      last_material = mat;
+      last_bucket = found->second;
+    }
+    keys[i] = last_bucket;
+  }
+
+  // Put the buckets of the same material type (and so the same scatter and
+  // texture code) next to each other
+  std::vector<uint32_t> bucket_order(materials.size());
+  std::iota(bucket_order.begin(), bucket_order.end(), 0);
+  std::sort(bucket_order.begin(), bucket_order.end(),
+            [&materials](const uint32_t a, const uint32_t b) {
+              const std::type_index type_a(typeid(*materials[a]));
+              const std::type_index type_b(typeid(*materials[b]));
+              if (type_a != type_b) return type_a < type_b;
+              return materials[a] < materials[b];
+            });
+
+  // Counting sort of the paths that hit something by bucket
+  std::vector<size_t> offsets(materials.size() + 1, 0);
+  for (size_t i = 0; i < path_count; i++)
+    if (hit[i]) offsets[keys[i] + 1]++;
+
+  std::vector<size_t> bucket_start(materials.size(), 0);
+  size_t running = 0;
+  for (const uint32_t bucket : bucket_order) {
+    bucket_start[bucket] = running;
+    running += offsets[bucket + 1];
+  }
+
+  hit_count = running;
+  for (size_t i = 0; i < path_count; i++)
+    if (hit[i]) order[bucket_start[keys[i]]++] = (uint32_t)i;
+}
+
+void wavefront_integrator::shade(const camera& cam) {
+  const size_t max_depth = cam.get_max_depth();
+  const int count = (int)hit_count;
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+  for (int k = 0; k < count; k++) {
+    const uint32_t i = order[k];
+
+    sampler& s = samplers[slot[i]];
+    s.start_bounce(depth[i]);
+
+    ray scattered;
+    vec3 attenuation;
+    bool alive = recs[i].mat_ptr->scatter(rays[i], recs[i], attenuation,
+                                          scattered, s);
+    if (alive) {
+      throughput[i] *= attenuation;
+      rays[i] = scattered;
+      alive = depth[i] < max_depth &&
+              cam.russian_roulette(throughput[i], depth[i], s);
+    }
+
+    if (alive) {
+      depth[i]++;
+    } else {
+      // Absorbed, too deep or terminated: the path carries no light
+      path_length[slot[i]] = depth[i];
+      depth[i] = 0;
+    }
+  }
+}
+
+size_t wavefront_integrator::compact() {
+  // Keep the surviving paths, grouped by the octant of their direction so
+  // that the next intersection stage traces similar rays back to back. The
+  // material order is kept inside every octant.
+  size_t octant_count[9] = {0};
+  for (size_t k = 0; k < hit_count; k++) {
+    const uint32_t i = order[k];
+    if (depth[i] == 0) continue;
+    octant_count[octant(rays[i].direction()) + 1]++;
+  }
+  for (int o = 0; o < 8; o++) octant_count[o + 1] += octant_count[o];
+  const size_t survivors = octant_count[8];
+
+  for (size_t k = 0; k < hit_count; k++) {
+    const uint32_t i = order[k];
+    if (depth[i] == 0) continue;
+
+    const size_t j = octant_count[octant(rays[i].direction())]++;
+    next_rays[j] = rays[i];
+    next_throughput[j] = throughput[i];
+    next_slot[j] = slot[i];
+    next_depth[j] = depth[i];
+  }
+
+  rays.swap(next_rays);
+  throughput.swap(next_throughput);
+  slot.swap(next_slot);
+  depth.swap(next_depth);
+
+  return survivors;
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "render/accumulation_buffer.hpp"
+
+class TestAccumulationBuffer : public ::testing::Test {
+ public:
+  TestAccumulationBuffer() {}
+  virtual ~TestAccumulationBuffer() {}
+
+  virtual void SetUp() override {}
+  virtual void TearDown() override {}
+};
+
+TEST_F(TestAccumulationBuffer, TestStartsBlack) {
+  accumulation_buffer accum(4, 2);
+  EXPECT_EQ(accum.get_samples(0), 0u);
+  EXPECT_TRUE(accum.get_average(7) == vec3(0, 0, 0));
+}
+
+TEST_F(TestAccumulationBuffer, TestAverage) {
+  accumulation_buffer accum(4, 2);
+  accum.add_sample(3, vec3(1, 0, 0));
+  accum.add_sample(3, vec3(0, 1, 0));
+  accum.add_samples(3, vec3(0, 0, 2), 0.0144f, 2);
+  EXPECT_EQ(accum.get_samples(3), 4u);
+  EXPECT_NEAR(accum.get_average(3).r(), 0.25f, 1e-6f);
+  EXPECT_NEAR(accum.get_average(3).g(), 0.25f, 1e-6f);
+  EXPECT_NEAR(accum.get_average(3).b(), 0.5f, 1e-6f);
+}
+
+TEST_F(TestAccumulationBuffer, TestManySamplesConverge) {
+  // The old 8-bit blending could not get past a few hundred passes
+  accumulation_buffer accum(1, 1);
+  for (int i = 0; i < 10000; i++)
+    accum.add_sample(0, i % 2 ? vec3(1, 1, 1) : vec3(0, 0, 0));
+  EXPECT_NEAR(accum.get_average(0).r(), 0.5f, 1e-4f);
+}
+
+TEST_F(TestAccumulationBuffer, TestNonFiniteSamplesAreDropped) {
+  accumulation_buffer accum(1, 1);
+  accum.add_sample(0, vec3(1, 1, 1));
+  accum.add_sample(0, vec3(std::nanf(""), 0, 0));
+  accum.add_sample(0, vec3(infinity, 0, 0));
+  EXPECT_EQ(accum.get_samples(0), 1u);
+  EXPECT_TRUE(accum.get_average(0) == vec3(1, 1, 1));
+}
+
+TEST_F(TestAccumulationBuffer, TestNonFiniteSampleKeepsItsBatch) {
+  accumulation_buffer accum(1, 1);
+  vec3 color(0, 0, 0);
+  float luminance_sq = 0;
+  uint32_t count = 0;
+  accumulation_buffer::accumulate(vec3(1, 1, 1), color, luminance_sq, count);
+  accumulation_buffer::accumulate(vec3(std::nanf(""), 0, 0), color,
+                                  luminance_sq, count);
+  accumulation_buffer::accumulate(vec3(3, 3, 3), color, luminance_sq, count);
+  accum.add_samples(0, color, luminance_sq, count);
+  EXPECT_EQ(accum.get_samples(0), 2u);
+  EXPECT_TRUE(accum.get_average(0) == vec3(2, 2, 2));
+}
+
+TEST_F(TestAccumulationBuffer, TestReset) {
+  accumulation_buffer accum(2, 2);
+  accum.add_sample(1, vec3(1, 1, 1));
+  accum.reset();
+  EXPECT_EQ(accum.get_samples(1), 0u);
+  EXPECT_TRUE(accum.get_average(1) == vec3(0, 0, 0));
+}
+
+TEST_F(TestAccumulationBuffer, TestResolveGamma) {
+  accumulation_buffer accum(1, 1);
+  accum.add_sample(0, vec3(0.5f, 0.0f, 4.0f));
+  const Color c = accum.resolve(0);
+  EXPECT_EQ(c.r, (uchar)(pow(0.5f, 1 / 2.2f) * 255));
+  EXPECT_EQ(c.g, 0);
+  EXPECT_EQ(c.b, 255);  // Clamped
+  EXPECT_EQ(c.a, 255);
+}
+
+TEST_F(TestAccumulationBuffer, TestResolveReinhard) {
+  accumulation_buffer accum(1, 1);
+  accum.set_tonemap(tonemap_operator::reinhard);
+  accum.add_sample(0, vec3(1.0f, 0.0f, 0.0f));
+  EXPECT_EQ(accum.resolve(0).r, (uchar)(pow(0.5f, 1 / 2.2f) * 255));
+}
+
+TEST_F(TestAccumulationBuffer, TestRelativeError) {
+  accumulation_buffer accum(2, 1);
+  // A constant pixel has no error, a noisy one does
+  for (int i = 0; i < 16; i++) {
+    accum.add_sample(0, vec3(0.5f, 0.5f, 0.5f));
+    accum.add_sample(1, i % 2 ? vec3(1, 1, 1) : vec3(0, 0, 0));
+  }
+  EXPECT_NEAR(accum.get_relative_error(0), 0.0f, 1e-3f);
+  // std = sqrt(16 / 15 * 0.25), stderr = std / 4, mean = 0.5
+  EXPECT_NEAR(accum.get_relative_error(1), std::sqrt(16.0f / 15 * 0.25f) / 2,
+              1e-3f);
+}
+
+TEST_F(TestAccumulationBuffer, TestRelativeErrorNeedsTwoSamples) {
+  accumulation_buffer accum(1, 1);
+  accum.add_sample(0, vec3(1, 1, 1));
+  EXPECT_EQ(accum.get_relative_error(0), infinity);
+}
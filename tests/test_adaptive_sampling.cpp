@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include "render/adaptive_sampling.hpp"
+
+class TestAdaptiveSampling : public ::testing::Test {
+ public:
+  TestAdaptiveSampling() {}
+  virtual ~TestAdaptiveSampling() {}
+
+  virtual void SetUp() override {}
+  virtual void TearDown() override {}
+};
+
+TEST_F(TestAdaptiveSampling, TestOnlyNoisyTilesStayActive) {
+  // Two 4x4 tiles side by side, the left one is flat, the right one noisy
+  tile_scheduler scheduler(8, 4, 4, tile_order::scanline);
+  accumulation_buffer accum(8, 4);
+  for (int s = 0; s < 16; s++)
+    for (int y = 0; y < 4; y++)
+      for (int x = 0; x < 8; x++)
+        accum.add_sample(y * 8 + x, x < 4 || s % 2 ? vec3(0.5f, 0.5f, 0.5f)
+                                                   : vec3(0, 0, 0));
+
+  adaptive_sampling adaptive(0.05f, 8);
+  EXPECT_EQ(adaptive.update(scheduler, accum), 1u);
+  EXPECT_EQ(scheduler.active_tile_count(), 1u);
+  EXPECT_EQ(scheduler.get_active_tile(0).x0, 4);
+  EXPECT_GT(adaptive.get_max_error(), 0.05f);
+}
+
+TEST_F(TestAdaptiveSampling, TestMinimumSamples) {
+  tile_scheduler scheduler(4, 4, 4);
+  accumulation_buffer accum(4, 4);
+  for (int s = 0; s < 4; s++)
+    for (int i = 0; i < 16; i++) accum.add_sample(i, vec3(1, 1, 1));
+
+  // Flat, but not enough samples yet
+  adaptive_sampling adaptive(0.05f, 8);
+  EXPECT_EQ(adaptive.update(scheduler, accum), 1u);
+
+  adaptive.set_min_samples(4);
+  EXPECT_EQ(adaptive.update(scheduler, accum), 0u);
+}
+
+TEST_F(TestAdaptiveSampling, TestMaximumSamples) {
+  tile_scheduler scheduler(4, 4, 4);
+  accumulation_buffer accum(4, 4);
+  for (int s = 0; s < 8; s++)
+    for (int i = 0; i < 16; i++)
+      accum.add_sample(i, s % 2 ? vec3(1, 1, 1) : vec3(0, 0, 0));
+
+  adaptive_sampling adaptive(0.05f, 2, 16);
+  EXPECT_EQ(adaptive.update(scheduler, accum), 1u);
+
+  // Noisy, but every pixel reached the limit
+  adaptive.set_max_samples(8);
+  EXPECT_EQ(adaptive.update(scheduler, accum), 0u);
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include "camera.hpp"
+#include "objects/bvh.hpp"
+#include "objects/linear_bvh.hpp"
+#include "objects/sphere.hpp"
+#include "render/aov_buffer.hpp"
+
+class TestAovBuffer : public ::testing::Test {
+ public:
+  TestAovBuffer()
+      : a(make_shared<sphere>(vec3(0, 0, -2), 0.5f, mat)),
+        b(make_shared<sphere>(vec3(1, 0, -2), 0.5f, mat)) {}
+  virtual ~TestAovBuffer() {}
+
+  virtual void TearDown() override { bvh_counts_visits() = false; }
+
+  shared_ptr<material> mat = make_shared<lambertian>(vec3(.5f, .5f, .5f));
+  shared_ptr<sphere> a;
+  shared_ptr<sphere> b;
+
+  static aov_sample hit(const hittable* object, const float depth) {
+    aov_sample sample;
+    sample.first_hit.object = object;
+    sample.first_hit.depth = depth;
+    sample.first_hit.normal = vec3(0, 0, 1);
+    sample.path_length = 2;
+    return sample;
+  }
+};
+
+TEST_F(TestAovBuffer, TestParse) {
+  aov_set passes = 0;
+  ASSERT_TRUE(aov_buffer::parse("depth,object", passes));
+  EXPECT_EQ(passes, aov_bit(aov_type::depth) | aov_bit(aov_type::object_id));
+
+  ASSERT_TRUE(aov_buffer::parse("all", passes));
+  for (const aov_type type : aov_buffer::all_types)
+    EXPECT_TRUE(passes & aov_bit(type)) << aov_buffer::name(type);
+
+  EXPECT_FALSE(aov_buffer::parse("depth,colour", passes));
+  EXPECT_FALSE(aov_buffer::parse("", passes));
+}
+
+TEST_F(TestAovBuffer, TestOnlyRequestedPasses) {
+  aov_buffer aovs(4, 4);
+  EXPECT_FALSE(aovs.any());
+
+  aovs.set_passes(aov_bit(aov_type::depth));
+  EXPECT_TRUE(aovs.any());
+  EXPECT_TRUE(aovs.has(aov_type::depth));
+  EXPECT_FALSE(aovs.has(aov_type::normal));
+
+  // A pass that is not kept cannot be written
+  EXPECT_FALSE(aovs.save(aov_type::normal, "normal.pfm"));
+}
+
+TEST_F(TestAovBuffer, TestAverages) {
+  aov_set passes = 0;
+  ASSERT_TRUE(aov_buffer::parse("all", passes));
+  aov_buffer aovs(4, 4, passes);
+
+  // Two hits and a miss: the depth only averages the hits
+  aovs.add_sample(0, hit(a.get(), 2));
+  aovs.add_sample(0, hit(a.get(), 4));
+  aovs.add_sample(0, aov_sample());
+
+  EXPECT_EQ(aovs.get_samples(0), 3u);
+  EXPECT_FLOAT_EQ(aovs.get_depth(0), 3.0f);
+  EXPECT_FLOAT_EQ(aovs.get_path_length(0), 4.0f / 3);
+  EXPECT_NEAR(aovs.get_normal(0).z(), 1.0f, 1e-6f);
+
+  // Only misses
+  aovs.add_sample(1, aov_sample());
+  EXPECT_EQ(aovs.get_depth(1), infinity);
+
+  aovs.reset();
+  EXPECT_EQ(aovs.get_samples(0), 0u);
+}
+
+TEST_F(TestAovBuffer, TestIdsFollowTheImage) {
+  aov_buffer aovs(4, 1, aov_bit(aov_type::object_id));
+
+  // Rendered out of order, the ids still count from the left
+  aovs.add_sample(3, hit(a.get(), 1));
+  aovs.add_sample(1, hit(b.get(), 1));
+  aovs.add_sample(2, hit(b.get(), 1));
+  aovs.add_sample(0, aov_sample());
+
+  const std::vector<uint32_t> ids = aovs.get_ids(aov_type::object_id);
+  EXPECT_EQ(ids, (std::vector<uint32_t>{0, 1, 1, 2}));
+}
+
+TEST_F(TestAovBuffer, TestFirstHitOfTheCamera) {
+  hittable_list list;
+  list.add(a);
+  list.add(b);
+  hittable_list world(make_shared<bvh_node>(list));
+
+  camera cam(32, 32, 4);
+  sampler s;
+  pixel_features features;
+  bvh_counts_visits() = true;
+  const size_t visits = bvh_visit_counter();
+  cam.send_ray(&world, 15.5f, 15.5f, s, nullptr, &features);
+
+  EXPECT_EQ(features.object, a.get());
+  EXPECT_EQ(features.mat, mat.get());
+  // Only the camera ray, not its bounces
+  EXPECT_GT(features.bvh_visits, 0u);
+  EXPECT_LT(features.bvh_visits, bvh_visit_counter() - visits);
+}
+
+TEST_F(TestAovBuffer, TestVisitsOfEveryRayOfAPacket) {
+  hittable_list list;
+  list.add(a);
+  list.add(b);
+  hittable_list world(make_shared<linear_bvh>(list));
+
+  camera cam(32, 32, 1);
+  const int count = 4;
+  const float i[count] = {2.5f, 15.5f, 16.5f, 30.5f};
+  const float j[count] = {2.5f, 15.5f, 16.5f, 30.5f};
+  sampler samplers[count];
+  vec3 colors[count];
+  pixel_features features[count];
+
+  cam.send_packet(&world, i, j, count, samplers, colors, nullptr, features);
+  for (int p = 0; p < count; p++) EXPECT_EQ(features[p].bvh_visits, 0u);
+
+  bvh_counts_visits() = true;
+  cam.send_packet(&world, i, j, count, samplers, colors, nullptr, features);
+  for (int p = 0; p < count; p++) EXPECT_GT(features[p].bvh_visits, 0u) << p;
+}
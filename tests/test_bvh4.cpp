@@ -0,0 +1,269 @@
+#include <gtest/gtest.h>
+
+#include "objects/bvh4.hpp"
+#include "objects/sphere.hpp"
+
+class TestBvh4 : public ::testing::Test {
+ public:
+  TestBvh4() {}
+  virtual ~TestBvh4() {}
+
+  virtual void SetUp() override {
+    // A cloud of small spheres in front of the camera
+    mat = make_shared<lambertian>(vec3(0.5f, 0.5f, 0.5f));
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> position(-4.0f, 4.0f);
+    for (int i = 0; i < 2000; i++)
+      spheres.add(make_shared<sphere>(
+          vec3(position(generator), position(generator),
+               position(generator) - 8.0f),
+          0.12f, mat));
+  }
+  // The tests that count visits turn the count on
+  virtual void TearDown() override { bvh_counts_visits() = false; }
+
+  shared_ptr<material> mat;
+  hittable_list spheres;
+
+  static ray fan_ray(const int i, const int count) {
+    return ray(vec3(0.1f, -0.2f, 0),
+               vec3(-0.6f + 1.2f * i / count, 0.5f - 0.9f * (i % 7) / 7, -1));
+  }
+};
+
+TEST_F(TestBvh4, TestNodeLayout) {
+  EXPECT_EQ(sizeof(bvh4_node), 128u);
+
+  bvh4 wide(spheres);
+  const std::vector<bvh4_node>& nodes = wide.get_nodes();
+
+  // Every primitive is in one leaf and every node but the root has one
+  // parent, which comes before it
+  std::vector<int> seen(wide.get_primitive_count(), 0);
+  std::vector<int> parents(nodes.size(), 0);
+  size_t children = 0;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    ASSERT_GE(nodes[i].child_count, 2u);
+    ASSERT_LE(nodes[i].child_count, 4u);
+    for (uint32_t c = 0; c < nodes[i].child_count; c++) {
+      children++;
+      if (nodes[i].count[c] > 0) {
+        for (uint32_t p = 0; p < nodes[i].count[c]; p++)
+          seen[nodes[i].child[c] + p]++;
+      } else {
+        ASSERT_GT(nodes[i].child[c], i);
+        ASSERT_LT(nodes[i].child[c], nodes.size());
+        parents[nodes[i].child[c]]++;
+      }
+    }
+  }
+  for (int count : seen) EXPECT_EQ(count, 1);
+  for (size_t i = 1; i < parents.size(); i++) EXPECT_EQ(parents[i], 1);
+
+  // The nodes near the leaves may have fewer children
+  EXPECT_GT(children, 5 * nodes.size() / 2);
+}
+
+TEST_F(TestBvh4, TestMatchesBinaryTree) {
+  bvh4 wide(spheres);
+  linear_bvh binary(spheres);
+
+  int hits = 0;
+  size_t wide_visits = 0, binary_visits = 0;
+  bvh_counts_visits() = true;
+  for (int i = 0; i < 500; i++) {
+    const ray r = fan_ray(i, 500);
+    hit_record expected, rec;
+    size_t visits = bvh_visit_counter();
+    const bool hit = binary.hit(r, interval(.001f, infinity), expected);
+    binary_visits += bvh_visit_counter() - visits;
+
+    visits = bvh_visit_counter();
+    ASSERT_EQ(wide.hit(r, interval(.001f, infinity), rec), hit) << i;
+    wide_visits += bvh_visit_counter() - visits;
+    if (!hit) continue;
+
+    hits++;
+    EXPECT_FLOAT_EQ(rec.t, expected.t);
+    EXPECT_EQ(rec.object, expected.object);
+  }
+  EXPECT_GT(hits, 50);
+
+  // Four boxes per step, about half the steps
+  EXPECT_LT(wide_visits, binary_visits * 2 / 3);
+}
+
+TEST_F(TestBvh4, TestPacketMatchesSingleRays) {
+  bvh4 wide(spheres);
+
+  for (int size : {4, 8, 16}) {
+    ray_packet packet;
+    for (int i = 0; i < size; i++) packet.add(fan_ray(i * 31, size * 31));
+    packet.pad();
+
+    hit_record recs[ray_packet::max_size];
+    const uint32_t hits =
+        wide.hit_packet(packet, packet.full_mask(), .001f, recs);
+
+    for (int i = 0; i < size; i++) {
+      hit_record rec;
+      const bool hit =
+          wide.hit(packet.rays[i], interval(.001f, infinity), rec);
+      ASSERT_EQ(hit, ((hits >> i) & 1u) != 0) << "size " << size << " ray "
+                                               << i;
+      if (hit) {
+        EXPECT_FLOAT_EQ(rec.t, recs[i].t);
+      }
+    }
+  }
+}
+
+TEST_F(TestBvh4, TestFrontToBack) {
+  // A row of spheres along the ray, the nearest is found first and the
+  // boxes behind it are skipped
+  hittable_list row;
+  for (int i = 0; i < 64; i++)
+    row.add(make_shared<sphere>(vec3(0, 0, -2.0f - i), 0.3f, mat));
+  bvh4 wide(row);
+
+  hit_record rec;
+  bvh_counts_visits() = true;
+  const size_t visits = bvh_visit_counter();
+  ASSERT_TRUE(wide.hit(ray(vec3(0, 0, 0), vec3(0, 0, -1)),
+                       interval(.001f, infinity), rec));
+  EXPECT_FLOAT_EQ(rec.t, 1.7f);
+  EXPECT_LT(bvh_visit_counter() - visits, 8u);
+
+  // The same from the other side
+  const size_t reverse_visits = bvh_visit_counter();
+  ASSERT_TRUE(wide.hit(ray(vec3(0, 0, -100.0f), vec3(0, 0, 1)),
+                       interval(.001f, infinity), rec));
+  EXPECT_NEAR(rec.t, 100.0f - 65.0f - 0.3f, 1e-4f);
+  EXPECT_LT(bvh_visit_counter() - reverse_visits, 8u);
+}
+
+TEST_F(TestBvh4, TestSmallLists) {
+  hit_record rec;
+  bvh4 empty((hittable_list()));
+  EXPECT_FALSE(empty.hit(fan_ray(0, 1), interval(.001f, infinity), rec));
+
+  hittable_list one;
+  one.add(make_shared<sphere>(vec3(0, 0, -3.0f), 0.5f, mat));
+  bvh4 single(one);
+  ASSERT_EQ(single.get_nodes().size(), 1u);
+  EXPECT_TRUE(single.hit(ray(vec3(0, 0, 0), vec3(0, 0, -1)),
+                         interval(.001f, infinity), rec));
+  EXPECT_FLOAT_EQ(rec.t, 2.5f);
+
+  ray_packet packet;
+  for (int i = 0; i < 4; i++) packet.add(ray(vec3(0, 0, 0), vec3(0, 0, -1)));
+  packet.pad();
+  hit_record recs[ray_packet::max_size];
+  EXPECT_EQ(single.hit_packet(packet, packet.full_mask(), .001f, recs), 0xFu);
+  EXPECT_FLOAT_EQ(recs[3].t, 2.5f);
+}
+
+TEST_F(TestBvh4, TestAxisParallelRays) {
+  // A grid of spheres whose boxes share their planes, with rays along the
+  // axes that start on those planes
+  hittable_list grid;
+  for (int x = 0; x < 8; x++)
+    for (int y = 0; y < 8; y++)
+      for (int z = 0; z < 8; z++)
+        grid.add(make_shared<sphere>(vec3(x, y, -2.0f - z), 0.5f, mat));
+  bvh4 wide(grid);
+  linear_bvh flat(grid);
+
+  int hits = 0;
+  for (int i = 0; i < 16; i++) {
+    for (int j = 0; j < 16; j++) {
+      const float u = 0.5f * i - 0.5f, v = 0.5f * j - 0.5f;
+      const ray rays[] = {ray(vec3(u, v, 0), vec3(0, 0, -1)),
+                          ray(vec3(u, v, -20.0f), vec3(-0.0f, 0, 1)),
+                          ray(vec3(-5.0f, u, -2.0f - v), vec3(1, 0, 0)),
+                          ray(vec3(u, 12.0f, -2.0f - v), vec3(0, -1, -0.0f))};
+      for (const ray& r : rays) {
+        hit_record expected, rec;
+        const bool hit = grid.hit(r, interval(.001f, infinity), expected);
+        ASSERT_EQ(wide.hit(r, interval(.001f, infinity), rec), hit)
+            << i << " " << j;
+        if (hit) {
+          EXPECT_FLOAT_EQ(rec.t, expected.t);
+        }
+        ASSERT_EQ(flat.hit(r, interval(.001f, infinity), rec), hit)
+            << i << " " << j;
+        if (hit) {
+          EXPECT_FLOAT_EQ(rec.t, expected.t);
+        }
+        hits += hit;
+      }
+    }
+  }
+  EXPECT_GT(hits, 100);
+}
+
+TEST_F(TestBvh4, TestRefitAfterMove) {
+  bvh_build_options options;
+  options.rebuild_threshold = 0;
+  bvh4 wide(spheres, options);
+  const float built_cost = wide.get_sah_cost();
+
+  std::mt19937 generator(5);
+  std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+  for (size_t i = 0; i < spheres.objects.size(); i += 40) {
+    spheres.objects[i]->move(vec3(step(generator), 0, step(generator)));
+    wide.mark_moved(i);
+  }
+  EXPECT_FALSE(wide.refit());
+
+  // Every child contains the children of its node
+  const std::vector<bvh4_node>& nodes = wide.get_nodes();
+  for (const bvh4_node& node : nodes) {
+    for (uint32_t c = 0; c < node.child_count; c++) {
+      if (node.count[c] > 0) continue;
+      const bvh4_node& child = nodes[node.child[c]];
+      for (uint32_t g = 0; g < child.child_count; g++)
+        for (int axis = 0; axis < 3; axis++) {
+          EXPECT_LE(node.bounds_min[axis][c], child.bounds_min[axis][g]);
+          EXPECT_GE(node.bounds_max[axis][c], child.bounds_max[axis][g]);
+        }
+    }
+  }
+
+  for (int i = 0; i < 500; i++) {
+    const ray r = fan_ray(i, 500);
+    hit_record expected, rec;
+    const bool hit = spheres.hit(r, interval(.001f, infinity), expected);
+    ASSERT_EQ(wide.hit(r, interval(.001f, infinity), rec), hit) << i;
+    if (hit) {
+      EXPECT_FLOAT_EQ(rec.t, expected.t);
+    }
+  }
+
+  EXPECT_NEAR(wide.get_degradation() * built_cost, wide.get_sah_cost(),
+              1e-3f * built_cost);
+
+  // Scattering the objects rebuilds it, the indices stay valid
+  wide.rebuild();
+  EXPECT_FLOAT_EQ(wide.get_degradation(), 1.0f);
+  options.rebuild_threshold = 1.5f;
+  bvh4 rebuilt(spheres, options);
+  for (size_t i = 0; i < spheres.objects.size(); i += 2) {
+    const interval& x = spheres.objects[i]->bounding_box().x;
+    spheres.objects[i]->move(vec3(-(x.min + x.max), 0, 0));
+    rebuilt.mark_moved(i);
+  }
+  EXPECT_TRUE(rebuilt.refit());
+  EXPECT_FLOAT_EQ(rebuilt.get_sah_cost(), bvh4(spheres).get_sah_cost());
+
+  const aabb box = spheres.objects[1]->bounding_box();
+  spheres.objects[1]->move(vec3(-0.5f * (box.x.min + box.x.max),
+                                -0.5f * (box.y.min + box.y.max),
+                                50.0f - 0.5f * (box.z.min + box.z.max)));
+  rebuilt.mark_moved(1);
+  EXPECT_FALSE(rebuilt.refit());
+  hit_record rec;
+  EXPECT_TRUE(rebuilt.hit(ray(vec3(0, 0, 0), vec3(0, 0, 1)),
+                          interval(.001f, infinity), rec));
+  EXPECT_EQ(rec.object, spheres.objects[1].get());
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#include "HeadlessRenderer.hpp"
+#include "scenes.hpp"
+
+class TestCheckpointFile : public ::testing::Test {
+ public:
+  TestCheckpointFile() : world(make_scene(1)) {
+    remove(path);
+    remove(other_path);
+  }
+  virtual ~TestCheckpointFile() {
+    remove(path);
+    remove(other_path);
+  }
+
+  static const int width = 40;
+  static const int height = 24;
+
+  const char* path = "test_checkpoint.bin";
+  const char* other_path = "test_checkpoint_other.bin";
+  hittable_list world;
+
+  // A render with a checkpoint, as a new process would start it
+  void render(const char* file, const uint64_t scene, const int samples,
+              HeadlessRenderer& renderer) {
+    renderer.set_world(&world);
+    renderer.set_checkpoint(file, scene, 0);
+    renderer.render(samples);
+  }
+};
+
+TEST_F(TestCheckpointFile, TestSaveAndLoad) {
+  accumulation_buffer accum(width, height);
+  feature_buffer features(width, height);
+  pixel_features hit;
+  hit.depth = 3;
+  for (int i = 0; i < width * height; i++) {
+    accum.add_sample(i, vec3(i * .01f, .5f, 1));
+    features.add_sample(i, hit);
+  }
+
+  {
+    checkpoint_file file;
+    ASSERT_TRUE(file.open(path, 42, width, height));
+    EXPECT_EQ(file.get_samples_done(), 0u);
+    ASSERT_TRUE(file.save(accum, features, 1));
+    file.wait();
+  }
+
+  checkpoint_file file;
+  ASSERT_TRUE(file.open(path, 42, width, height));
+  EXPECT_EQ(file.get_samples_done(), 1u);
+
+  accumulation_buffer loaded(width, height);
+  feature_buffer loaded_features(width, height);
+  file.load(loaded, loaded_features);
+  for (int i = 0; i < width * height; i++) {
+    ASSERT_EQ(loaded.get_sum(i).r(), accum.get_sum(i).r());
+    ASSERT_EQ(loaded.get_samples(i), 1u);
+    ASSERT_EQ(loaded_features.get_depth(i), 3.0f);
+  }
+}
+
+TEST_F(TestCheckpointFile, TestOtherRenderStartsOver) {
+  accumulation_buffer accum(width, height);
+  feature_buffer features(width, height);
+  {
+    checkpoint_file file;
+    ASSERT_TRUE(file.open(path, 42, width, height));
+    ASSERT_TRUE(file.save(accum, features, 5));
+  }
+
+  checkpoint_file file;
+  ASSERT_TRUE(file.open(path, 43, width, height));
+  EXPECT_EQ(file.get_samples_done(), 0u);
+  file.close();
+
+  ASSERT_TRUE(file.open(path, 43, width, height / 2));
+  EXPECT_EQ(file.get_samples_done(), 0u);
+}
+
+TEST_F(TestCheckpointFile, TestResumeMatchesUninterrupted) {
+  // Stopped after the first pass (4 samples), then resumed up to 10
+  {
+    HeadlessRenderer first(width, height, 4);
+    render(path, 1, 4, first);
+    EXPECT_EQ(first.get_resumed_samples(), 0u);
+  }
+  HeadlessRenderer resumed(width, height, 4);
+  render(path, 1, 10, resumed);
+  EXPECT_EQ(resumed.get_resumed_samples(), 4u);
+  EXPECT_EQ(resumed.get_rays_sent(), (size_t)width * height * 6);
+
+  HeadlessRenderer uninterrupted(width, height, 4);
+  render(other_path, 1, 10, uninterrupted);
+
+  const accumulation_buffer& a = resumed.get_accumulation();
+  const accumulation_buffer& b = uninterrupted.get_accumulation();
+  for (int i = 0; i < width * height; i++) {
+    ASSERT_EQ(a.get_samples(i), 10u);
+    ASSERT_EQ(a.get_sum(i).r(), b.get_sum(i).r()) << i;
+    ASSERT_EQ(a.get_luminance_sq_sum(i), b.get_luminance_sq_sum(i)) << i;
+  }
+
+  // A finished render is only read back
+  HeadlessRenderer again(width, height, 4);
+  render(path, 1, 10, again);
+  EXPECT_EQ(again.get_resumed_samples(), 10u);
+  EXPECT_EQ(again.get_rays_sent(), 0u);
+}
+
+TEST_F(TestCheckpointFile, TestOtherSceneIsNotResumed) {
+  {
+    HeadlessRenderer first(width, height, 4);
+    render(path, 1, 2, first);
+  }
+
+  HeadlessRenderer other(width, height, 4);
+  render(path, 2, 2, other);
+  EXPECT_EQ(other.get_resumed_samples(), 0u);
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include "camera.hpp"
+#include "objects/sphere.hpp"
+#include "render/denoiser.hpp"
+
+class TestDenoiser : public ::testing::Test {
+ public:
+  TestDenoiser() : accum(width, height), features(width, height) {}
+  virtual ~TestDenoiser() {}
+
+  static const int width = 32;
+  static const int height = 32;
+
+  accumulation_buffer accum;
+  feature_buffer features;
+
+  // A plane facing the camera, split in a left and a right half that can
+  // have different normals. Every pixel gets noisy samples around color.
+  void fill(const vec3& left_color, const vec3& right_color,
+            const vec3& right_normal) {
+    rng generator(7);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        const int index = y * width + x;
+        const bool left = x < width / 2;
+
+        pixel_features f;
+        f.albedo = vec3(1, 1, 1);
+        f.normal = left ? vec3(0, 0, 1) : right_normal;
+        f.depth = 5;
+
+        for (int s = 0; s < 8; s++) {
+          const float noise = 2 * generator.next_float();
+          accum.add_sample(index, (left ? left_color : right_color) * noise);
+          features.add_sample(index, f);
+        }
+      }
+    }
+  }
+
+  static float mean_squared_error(const std::vector<vec3>& colors,
+                                  const int x0, const int x1,
+                                  const vec3& expected) {
+    float error = 0;
+    for (int y = 0; y < height; y++)
+      for (int x = x0; x < x1; x++)
+        error += (colors[y * width + x] - expected).length_squared();
+    return error / ((x1 - x0) * height);
+  }
+};
+
+TEST_F(TestDenoiser, TestFeaturesOfTheFirstHit) {
+  hittable_list world;
+  world.add(make_shared<sphere>(vec3(0, 0, -3), 1.0f,
+                                make_shared<lambertian>(vec3(.2f, .4f, .6f))));
+  camera cam(width, height, 4);
+
+  // Through the center of the image, straight at the sphere
+  sampler s;
+  pixel_features hit;
+  cam.send_ray(&world, width / 2 - .5f, height / 2 - .5f, s, nullptr, &hit);
+  EXPECT_NEAR(hit.albedo.g(), .4f, 1e-5f);
+  EXPECT_NEAR(hit.depth, 2.0f, 0.05f);
+  EXPECT_GT(hit.normal.z(), 0.99f);
+
+  // The corner sees the sky
+  pixel_features miss;
+  cam.send_ray(&world, 0, 0, s, nullptr, &miss);
+  EXPECT_TRUE(miss.depth == pixel_features::miss_depth);
+  EXPECT_GT(miss.albedo.b(), 0.5f);
+}
+
+TEST_F(TestDenoiser, TestFeatureBufferAverages) {
+  pixel_features a, b;
+  a.albedo = vec3(1, 0, 0);
+  a.depth = 2;
+  b.albedo = vec3(0, 1, 0);
+  b.depth = 4;
+  features.add_sample(3, a);
+  features.add_sample(3, b);
+
+  EXPECT_EQ(features.get_samples(3), 2u);
+  EXPECT_FLOAT_EQ(features.get_albedo(3).r(), 0.5f);
+  EXPECT_FLOAT_EQ(features.get_depth(3), 3.0f);
+
+  features.reset();
+  EXPECT_EQ(features.get_samples(3), 0u);
+}
+
+TEST_F(TestDenoiser, TestRemovesNoise) {
+  const vec3 color(.5f, .5f, .5f);
+  fill(color, color, vec3(0, 0, 1));
+
+  std::vector<vec3> noisy(width * height);
+  for (int i = 0; i < width * height; i++) noisy[i] = accum.get_average(i);
+
+  denoiser filter;
+  std::vector<vec3> denoised;
+  filter.denoise(accum, features, denoised);
+  ASSERT_EQ(denoised.size(), (size_t)(width * height));
+
+  const float before = mean_squared_error(noisy, 0, width, color);
+  const float after = mean_squared_error(denoised, 0, width, color);
+  EXPECT_LT(after, before / 10);
+}
+
+TEST_F(TestDenoiser, TestKeepsEdges) {
+  // Same brightness on both sides, so only the normals tell them apart
+  const vec3 red(.6f, .2f, .2f);
+  const vec3 blue(.2f, .2f, .6f);
+  fill(red, blue, vec3(1, 0, 0));
+
+  denoiser filter;
+  std::vector<vec3> denoised;
+  filter.denoise(accum, features, denoised);
+
+  // The column right next to the edge keeps its own color
+  for (int y = 0; y < height; y++) {
+    const vec3& left = denoised[y * width + width / 2 - 1];
+    const vec3& right = denoised[y * width + width / 2];
+    EXPECT_GT(left.r(), 2 * left.b());
+    EXPECT_GT(right.b(), 2 * right.r());
+  }
+}
+
+TEST_F(TestDenoiser, TestPixelsWithoutFeaturesAreKept) {
+  const vec3 color(.5f, .5f, .5f);
+  for (int i = 0; i < width * height; i++)
+    accum.add_sample(i, color * (float)(i % 3));
+
+  denoiser filter;
+  std::vector<vec3> denoised;
+  filter.denoise(accum, features, denoised);
+
+  for (int i = 0; i < width * height; i++)
+    EXPECT_EQ(denoised[i].r(), accum.get_average(i).r());
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include "HeadlessRenderer.hpp"
+#include "scenes.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+class TestDeterministic : public ::testing::Test {
+ public:
+  TestDeterministic() : world(make_scene(1)) {
+#ifdef _OPENMP
+    default_threads = omp_get_max_threads();
+#endif
+  }
+  virtual ~TestDeterministic() {
+#ifdef _OPENMP
+    omp_set_num_threads(default_threads);
+#endif
+  }
+
+  static const int width = 64;
+  static const int height = 48;
+
+  hittable_list world;
+  int default_threads = 1;
+
+  std::vector<vec3> render(const int threads, const bool wavefront,
+                           const uint32_t seed = 0) {
+    HeadlessRenderer renderer(width, height, 6);
+    renderer.set_world(&world);
+    renderer.set_threads(threads);
+    renderer.set_sampler(sampler_type::independent);
+    renderer.set_deterministic(true, seed);
+    renderer.set_wavefront(wavefront);
+    renderer.render(4);
+
+    std::vector<vec3> sums;
+    for (int i = 0; i < width * height; i++)
+      sums.push_back(renderer.get_accumulation().get_sum(i));
+    return sums;
+  }
+
+  static bool identical(const std::vector<vec3>& a,
+                        const std::vector<vec3>& b) {
+    for (size_t i = 0; i < a.size(); i++)
+      for (int c = 0; c < 3; c++)
+        if (a[i].e[c] != b[i].e[c]) return false;
+    return true;
+  }
+};
+
+TEST_F(TestDeterministic, TestSameImageWithAnyThreadCount) {
+  const std::vector<vec3> one = render(1, false);
+  EXPECT_TRUE(identical(one, render(3, false)));
+  EXPECT_TRUE(identical(one, render(8, false)));
+}
+
+TEST_F(TestDeterministic, TestWavefrontSameImageWithAnyThreadCount) {
+  const std::vector<vec3> one = render(1, true);
+  EXPECT_TRUE(identical(one, render(5, true)));
+}
+
+TEST_F(TestDeterministic, TestSeedChangesTheImage) {
+  EXPECT_TRUE(identical(render(2, false, 1), render(2, false, 1)));
+  EXPECT_FALSE(identical(render(2, false, 1), render(2, false, 2)));
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "DistributedRenderer.hpp"
+#include "scenes.hpp"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+class TestDistributed : public ::testing::Test {
+ public:
+  TestDistributed() : world(make_scene(1)), reference(width, height, 4) {
+    job.scene = 1;
+    job.width = width;
+    job.height = height;
+    job.max_depth = 4;
+
+    reference.set_world(&world);
+    reference.render(samples);
+  }
+  virtual ~TestDistributed() {}
+
+  static const int width = 48;
+  static const int height = 40;
+  static const int samples = 4;
+
+  render_job job;
+  hittable_list world;
+  HeadlessRenderer reference;  // The same image, rendered in one process
+
+  static std::string address(const char* name) {
+#ifndef _WIN32
+    return std::string("unix:/tmp/test-distributed-") +
+           std::to_string(getpid()) + "-" + name + ".sock";
+#else
+    return name;
+#endif
+  }
+
+  static std::thread start_worker(const std::string& address,
+                                  bool& finished) {
+    return std::thread([address, &finished] {
+      RenderWorker worker;
+      worker.set_threads(1);
+      finished = worker.run(address);
+    });
+  }
+};
+
+TEST_F(TestDistributed, TestMatchesOneProcess) {
+  RenderCoordinator coordinator(job);
+  coordinator.set_task_size(2, 0);
+  ASSERT_TRUE(coordinator.listen(address("match")));
+
+  bool first = false, second = false;
+  std::thread a = start_worker(address("match"), first);
+  std::thread b = start_worker(address("match"), second);
+
+  HeadlessRenderer renderer(width, height, 4);
+  const bool rendered = coordinator.render(samples, renderer);
+  a.join();
+  b.join();
+  ASSERT_TRUE(rendered);
+  EXPECT_TRUE(first);
+  EXPECT_TRUE(second);
+  EXPECT_EQ(coordinator.get_reassigned_tasks(), 0u);
+  EXPECT_LT(coordinator.get_compressed_bytes(), coordinator.get_raw_bytes());
+
+  // Bit for bit, whichever worker rendered which tile
+  const accumulation_buffer& expected = reference.get_accumulation();
+  const accumulation_buffer& merged = renderer.get_accumulation();
+  for (int i = 0; i < width * height; i++) {
+    ASSERT_EQ(merged.get_samples(i), (uint32_t)samples);
+    ASSERT_EQ(merged.get_sum(i).r(), expected.get_sum(i).r()) << i;
+    ASSERT_EQ(merged.get_sum(i).b(), expected.get_sum(i).b()) << i;
+    ASSERT_EQ(merged.get_luminance_sq_sum(i),
+              expected.get_luminance_sq_sum(i));
+  }
+}
+
+TEST_F(TestDistributed, TestSampleRangesAddUp) {
+  RenderCoordinator coordinator(job);
+  coordinator.set_task_size(4, 1);
+  ASSERT_TRUE(coordinator.listen(address("ranges")));
+  EXPECT_EQ(coordinator.get_task_count(), 0u);
+
+  bool finished = false;
+  std::thread worker = start_worker(address("ranges"), finished);
+
+  HeadlessRenderer renderer(width, height, 4);
+  ASSERT_TRUE(coordinator.render(samples, renderer));
+  worker.join();
+
+  // 9 tiles in runs of 4 (the last one a single tile), every run split in
+  // single samples
+  EXPECT_EQ(coordinator.get_task_count(), 3u * samples);
+
+  // The same samples, summed in another order
+  const accumulation_buffer& expected = reference.get_accumulation();
+  const accumulation_buffer& merged = renderer.get_accumulation();
+  for (int i = 0; i < width * height; i++) {
+    ASSERT_EQ(merged.get_samples(i), (uint32_t)samples);
+    ASSERT_NEAR(merged.get_average(i).g(), expected.get_average(i).g(),
+                1e-5f);
+  }
+}
+
+TEST_F(TestDistributed, TestFailedWorkerTaskIsReassigned) {
+  RenderCoordinator coordinator(job);
+  coordinator.set_task_size(3, 0);
+  coordinator.set_worker_timeout(10);
+  ASSERT_TRUE(coordinator.listen(address("failure")));
+
+  HeadlessRenderer renderer(width, height, 4);
+  bool rendered = false;
+  std::thread render(
+      [&] { rendered = coordinator.render(samples, renderer); });
+
+  // Takes the first task and leaves without an answer
+  RenderWorker crashing;
+  crashing.set_drop_after(1);
+  EXPECT_FALSE(crashing.run(address("failure")));
+  EXPECT_EQ(crashing.get_tasks_done(), 0u);
+
+  bool finished = false;
+  std::thread worker = start_worker(address("failure"), finished);
+  worker.join();
+  render.join();
+
+  ASSERT_TRUE(rendered);
+  EXPECT_TRUE(finished);
+  EXPECT_EQ(coordinator.get_reassigned_tasks(), 1u);
+  EXPECT_EQ(coordinator.get_worker_count(), 2u);
+
+  const accumulation_buffer& expected = reference.get_accumulation();
+  const accumulation_buffer& merged = renderer.get_accumulation();
+  for (int i = 0; i < width * height; i++)
+    ASSERT_EQ(merged.get_sum(i).g(), expected.get_sum(i).g()) << i;
+}
+
+TEST_F(TestDistributed, TestNoWorkerFails) {
+  RenderCoordinator coordinator(job);
+  coordinator.set_worker_timeout(0.2f);
+  ASSERT_TRUE(coordinator.listen(address("none")));
+
+  HeadlessRenderer renderer(width, height, 4);
+  EXPECT_FALSE(coordinator.render(samples, renderer));
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "render/frame_budget.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Pretend to trace rays that each take the given time
+static void trace(frame_budget& budget, const size_t rays,
+                  const float seconds_per_ray) {
+  budget.begin_batch();
+  std::this_thread::sleep_for(Secondsf(rays * seconds_per_ray));
+  budget.add_thread_work(0, rays, rays * seconds_per_ray);
+  budget.end_batch(rays);
+}
+
+TEST(TestFrameBudget, TestBudgetChangesAtMostTwofold) {
+  frame_budget budget(30, 1000);
+  // Rays are far cheaper than expected, the budget still only doubles
+  trace(budget, budget.get_budget(), 1e-7f);
+  EXPECT_EQ(budget.get_budget(), 2000u);
+  EXPECT_EQ(budget.get_achieved_rays(), 1000u);
+}
+
+TEST(TestFrameBudget, TestConvergesToTargetFrameTime) {
+  const float seconds_per_ray = 1e-5f;
+  frame_budget budget(20, 100);
+  for (int i = 0; i < 20; i++)
+    trace(budget, budget.get_budget(), seconds_per_ray);
+
+  // The batches fill the render share of a 50 ms frame
+  const float expected = budget.get_render_share() * 0.05f / seconds_per_ray;
+  EXPECT_NEAR((float)budget.get_budget(), expected, 0.25f * expected);
+  EXPECT_NEAR(budget.get_batch_time(), budget.get_render_share() * 0.05f,
+              0.02f);
+}
+
+TEST(TestFrameBudget, TestLateFramesShrinkRenderShare) {
+  frame_budget budget(100);
+  const float share = budget.get_render_share();
+  budget.end_frame();
+  std::this_thread::sleep_for(Secondsf(0.03f));
+  budget.end_frame();
+
+  EXPECT_GT(budget.get_frame_time(), 0.02f);
+  EXPECT_LT(budget.get_render_share(), share);
+}
+
+TEST(TestFrameBudget, TestThreadStats) {
+  frame_budget budget;
+  trace(budget, 10, 1e-3f);
+  EXPECT_EQ(budget.get_thread_stats()[0].rays, 10u);
+  EXPECT_GT(budget.get_thread_utilization(), 0.0f);
+  EXPECT_LE(budget.get_thread_utilization(), 1.0f);
+
+  // A new batch starts from clean counters
+  budget.begin_batch();
+  EXPECT_EQ(budget.get_thread_stats()[0].rays, 0u);
+}
+
+#ifdef _OPENMP
+TEST(TestFrameBudget, TestThreadsAddedAfterConstruction) {
+  const int threads = omp_get_max_threads();
+  frame_budget budget;
+  omp_set_num_threads(threads + 2);
+  budget.begin_batch();
+  budget.add_thread_work(threads + 1, 10, 1e-3f);
+  omp_set_num_threads(threads);
+
+  EXPECT_EQ(budget.get_thread_stats().size(), (size_t)threads + 2);
+  EXPECT_EQ(budget.get_thread_stats()[threads + 1].rays, 10u);
+}
+#endif
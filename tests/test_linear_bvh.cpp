@@ -0,0 +1,363 @@
+#include <gtest/gtest.h>
+
+#include "objects/linear_bvh.hpp"
+#include "objects/sphere.hpp"
+
+class TestLinearBvh : public ::testing::Test {
+ public:
+  TestLinearBvh() {}
+  virtual ~TestLinearBvh() {}
+
+  virtual void SetUp() override {
+    // A cloud of small spheres in front of the camera
+    auto mat = make_shared<lambertian>(vec3(0.5f, 0.5f, 0.5f));
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> position(-4.0f, 4.0f);
+    for (int i = 0; i < 1000; i++)
+      spheres.add(make_shared<sphere>(
+          vec3(position(generator), position(generator),
+               position(generator) - 8.0f),
+          0.15f, mat));
+  }
+  // The tests that count visits turn the count on
+  virtual void TearDown() override { bvh_counts_visits() = false; }
+
+  hittable_list spheres;
+
+  // Every primitive is in exactly one leaf, the first child of an inner node
+  // follows it and the children are inside their parent
+  static void check_tree(const linear_bvh& bvh, const size_t max_leaf_size) {
+    const std::vector<linear_bvh_node>& nodes = bvh.get_nodes();
+    std::vector<int> seen(bvh.get_primitive_count(), 0);
+    for (size_t i = 0; i < nodes.size(); i++) {
+      if (nodes[i].is_leaf()) {
+        EXPECT_LE(nodes[i].count, max_leaf_size);
+        for (uint32_t p = 0; p < nodes[i].count; p++)
+          seen[nodes[i].offset + p]++;
+        continue;
+      }
+
+      ASSERT_GT(nodes[i].offset, i + 1);
+      ASSERT_LT(nodes[i].offset, nodes.size());
+      for (const size_t child : {i + 1, (size_t)nodes[i].offset})
+        for (int axis = 0; axis < 3; axis++) {
+          EXPECT_LE(nodes[i].bounds_min[axis], nodes[child].bounds_min[axis]);
+          EXPECT_GE(nodes[i].bounds_max[axis], nodes[child].bounds_max[axis]);
+        }
+    }
+    for (int count : seen) EXPECT_EQ(count, 1);
+  }
+
+  static ray fan_ray(const int i, const int count) {
+    return ray(vec3(0.1f, -0.2f, 0),
+               vec3(-0.6f + 1.2f * i / count, 0.5f - 0.9f * (i % 7) / 7, -1));
+  }
+};
+
+TEST_F(TestLinearBvh, TestNodeLayout) {
+  EXPECT_EQ(sizeof(linear_bvh_node), 32u);
+
+  linear_bvh bvh(spheres);
+  EXPECT_EQ(bvh.get_primitive_count(), 1000u);
+  check_tree(bvh, bvh_build_options().max_leaf_size);
+}
+
+TEST_F(TestLinearBvh, TestMatchesPointerTree) {
+  linear_bvh flat(spheres);
+  bvh_node tree(spheres);
+
+  int hits = 0;
+  for (int i = 0; i < 500; i++) {
+    const ray r = fan_ray(i, 500);
+    hit_record expected, rec;
+    const bool hit = tree.hit(r, interval(.001f, infinity), expected);
+    ASSERT_EQ(flat.hit(r, interval(.001f, infinity), rec), hit) << i;
+    if (!hit) continue;
+
+    hits++;
+    EXPECT_FLOAT_EQ(rec.t, expected.t);
+    EXPECT_EQ(rec.object, expected.object);
+  }
+  EXPECT_GT(hits, 50);
+}
+
+TEST_F(TestLinearBvh, TestPacketMatchesSingleRays) {
+  linear_bvh flat(spheres);
+
+  for (int size : {4, 8, 16}) {
+    ray_packet packet;
+    for (int i = 0; i < size; i++) packet.add(fan_ray(i * 31, size * 31));
+    packet.pad();
+
+    hit_record recs[ray_packet::max_size];
+    const uint32_t hits =
+        flat.hit_packet(packet, packet.full_mask(), .001f, recs);
+
+    for (int i = 0; i < size; i++) {
+      hit_record rec;
+      const bool hit =
+          flat.hit(packet.rays[i], interval(.001f, infinity), rec);
+      ASSERT_EQ(hit, ((hits >> i) & 1u) != 0) << "size " << size << " ray "
+                                               << i;
+      if (hit) {
+        EXPECT_FLOAT_EQ(rec.t, recs[i].t);
+      }
+    }
+  }
+}
+
+TEST_F(TestLinearBvh, TestVisitsFewNodes) {
+  linear_bvh flat(spheres);
+  bvh_counts_visits() = true;
+
+  // A ray that misses the cloud stops at the root
+  hit_record rec;
+  size_t visits = bvh_visit_counter();
+  EXPECT_FALSE(flat.hit(ray(vec3(0, 0, 0), vec3(0, 0, 1)),
+                        interval(.001f, infinity), rec));
+  EXPECT_EQ(bvh_visit_counter() - visits, 1u);
+
+  // One that goes through it visits a small part of the tree
+  visits = bvh_visit_counter();
+  flat.hit(fan_ray(250, 500), interval(.001f, infinity), rec);
+  EXPECT_GT(bvh_visit_counter() - visits, 1u);
+  EXPECT_LT(bvh_visit_counter() - visits, flat.get_nodes().size() / 4);
+}
+
+TEST_F(TestLinearBvh, TestEmptyList) {
+  linear_bvh flat((hittable_list()));
+  hit_record rec;
+  EXPECT_FALSE(flat.hit(fan_ray(0, 1), interval(.001f, infinity), rec));
+
+  ray_packet packet;
+  packet.add(fan_ray(0, 1));
+  packet.pad();
+  EXPECT_EQ(flat.hit_packet(packet, packet.full_mask(), .001f, &rec), 0u);
+}
+
+TEST_F(TestLinearBvh, TestSahBeatsMedianOnUnevenScene) {
+  // Small spheres on a huge ground sphere, as in the demo scenes
+  auto mat = make_shared<lambertian>(vec3(0.5f, 0.5f, 0.5f));
+  hittable_list scene;
+  scene.add(make_shared<sphere>(vec3(0, -1000.0f, -8.0f), 999.0f, mat));
+  for (int i = 0; i < 200; i++)
+    scene.add(make_shared<sphere>(
+        vec3(-4.0f + 0.4f * (i % 20), 0.1f * (i % 3), -4.0f - 0.4f * (i / 20)),
+        0.15f, mat));
+
+  bvh_build_options median;
+  median.split = bvh_split::median;
+  linear_bvh median_bvh(scene, median);
+  linear_bvh sah_bvh(scene);
+  check_tree(sah_bvh, bvh_build_options().max_leaf_size);
+  EXPECT_LT(sah_bvh.get_sah_cost(), median_bvh.get_sah_cost());
+
+  // The same hits, whatever the tree
+  for (int i = 0; i < 300; i++) {
+    const ray r(vec3(0, 1.0f, 0), vec3(-0.6f + 1.2f * (i % 30) / 30,
+                                       -0.05f - 0.05f * (i / 30), -1));
+    hit_record expected, rec;
+    const bool hit = median_bvh.hit(r, interval(.001f, infinity), expected);
+    ASSERT_EQ(sah_bvh.hit(r, interval(.001f, infinity), rec), hit) << i;
+    if (hit) {
+      EXPECT_FLOAT_EQ(rec.t, expected.t);
+    }
+  }
+}
+
+TEST_F(TestLinearBvh, TestBuildOptions) {
+  for (const size_t leaf_size : {1, 2, 8}) {
+    for (const int bins : {2, 8, 32}) {
+      bvh_build_options options;
+      options.max_leaf_size = leaf_size;
+      options.bin_count = bins;
+      linear_bvh bvh(spheres, options);
+      check_tree(bvh, leaf_size);
+
+      // Every ray that hits the root intersects at least one primitive
+      EXPECT_GE(bvh.get_sah_cost(), 1.0f);
+    }
+  }
+}
+
+TEST_F(TestLinearBvh, TestCoincidentPrimitives) {
+  auto mat = make_shared<lambertian>(vec3(0.5f, 0.5f, 0.5f));
+  hittable_list stack;
+  for (int i = 0; i < 37; i++)
+    stack.add(make_shared<sphere>(vec3(0, 0, -3.0f), 0.5f, mat));
+
+  linear_bvh bvh(stack);
+  check_tree(bvh, bvh_build_options().max_leaf_size);
+
+  hit_record rec;
+  EXPECT_TRUE(bvh.hit(ray(vec3(0, 0, 0), vec3(0, 0, -1)),
+                      interval(.001f, infinity), rec));
+  EXPECT_FLOAT_EQ(rec.t, 2.5f);
+}
+
+TEST_F(TestLinearBvh, TestParallelBuildMatchesSerial) {
+  // Large enough for parallel binning at the root and tasks below it
+  auto mat = make_shared<lambertian>(vec3(0.5f, 0.5f, 0.5f));
+  std::mt19937 generator(3);
+  std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+  hittable_list cloud;
+  for (int i = 0; i < 40000; i++) {
+    const float x = position(generator), y = position(generator),
+                z = position(generator);
+    cloud.add(make_shared<sphere>(vec3(x * std::abs(x) / 20, y, z - 30.0f),
+                                  0.1f, mat));
+  }
+
+  bvh_build_options serial;
+  serial.threads = 1;
+  bvh_build_options parallel;
+  parallel.threads = 4;
+  linear_bvh a(cloud, serial);
+  linear_bvh b(cloud, parallel);
+
+  ASSERT_EQ(a.get_nodes().size(), b.get_nodes().size());
+  EXPECT_EQ(a.get_sah_cost(), b.get_sah_cost());
+  for (size_t i = 0; i < a.get_nodes().size(); i++) {
+    const linear_bvh_node& x = a.get_nodes()[i];
+    const linear_bvh_node& y = b.get_nodes()[i];
+    ASSERT_EQ(x.offset, y.offset) << i;
+    ASSERT_EQ(x.count, y.count) << i;
+    for (int axis = 0; axis < 3; axis++) {
+      ASSERT_EQ(x.bounds_min[axis], y.bounds_min[axis]) << i;
+      ASSERT_EQ(x.bounds_max[axis], y.bounds_max[axis]) << i;
+    }
+  }
+  check_tree(b, parallel.max_leaf_size);
+}
+
+TEST_F(TestLinearBvh, TestRefitAfterMove) {
+  bvh_build_options options;
+  options.rebuild_threshold = 0;
+  linear_bvh flat(spheres, options);
+  const std::vector<linear_bvh_node> built = flat.get_nodes();
+  const float built_cost = flat.get_sah_cost();
+
+  // A few objects drift, the tree keeps its shape
+  std::mt19937 generator(5);
+  std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+  for (size_t i = 0; i < spheres.objects.size(); i += 50) {
+    spheres.objects[i]->move(vec3(step(generator), step(generator), 0));
+    flat.mark_moved(i);
+  }
+  EXPECT_FALSE(flat.refit());
+  check_tree(flat, options.max_leaf_size);
+
+  // Only the boxes above the moved objects changed
+  size_t changed = 0;
+  for (size_t i = 0; i < built.size(); i++) {
+    ASSERT_EQ(flat.get_nodes()[i].offset, built[i].offset);
+    changed += flat.get_nodes()[i].bounds_min[0] != built[i].bounds_min[0] ||
+               flat.get_nodes()[i].bounds_max[0] != built[i].bounds_max[0] ||
+               flat.get_nodes()[i].bounds_min[1] != built[i].bounds_min[1] ||
+               flat.get_nodes()[i].bounds_max[1] != built[i].bounds_max[1];
+  }
+  EXPECT_GT(changed, 0u);
+  EXPECT_LT(changed, built.size() / 4);
+
+  // The refitted tree finds what a list of the moved objects finds
+  for (int i = 0; i < 500; i++) {
+    const ray r = fan_ray(i, 500);
+    hit_record expected, rec;
+    const bool hit = spheres.hit(r, interval(.001f, infinity), expected);
+    ASSERT_EQ(flat.hit(r, interval(.001f, infinity), rec), hit) << i;
+    if (hit) {
+      EXPECT_FLOAT_EQ(rec.t, expected.t);
+    }
+  }
+
+  // The cost the refits track is the cost of the tree
+  EXPECT_NEAR(flat.get_degradation() * built_cost, flat.get_sah_cost(),
+              1e-3f * built_cost);
+}
+
+TEST_F(TestLinearBvh, TestRebuildPastThreshold) {
+  linear_bvh flat(spheres);
+  EXPECT_FLOAT_EQ(flat.get_degradation(), 1.0f);
+
+  // Half the objects swap sides, their leaves now span the whole cloud
+  for (size_t i = 0; i < spheres.objects.size(); i += 2) {
+    const interval& x = spheres.objects[i]->bounding_box().x;
+    spheres.objects[i]->move(vec3(-(x.min + x.max), 0, 0));
+    flat.mark_moved(i);
+  }
+  EXPECT_TRUE(flat.refit());
+  EXPECT_FLOAT_EQ(flat.get_degradation(), 1.0f);
+  check_tree(flat, bvh_build_options().max_leaf_size);
+  EXPECT_FLOAT_EQ(flat.get_sah_cost(), linear_bvh(spheres).get_sah_cost());
+
+  // The objects keep their indices across the rebuild
+  const aabb box = spheres.objects[1]->bounding_box();
+  spheres.objects[1]->move(vec3(-0.5f * (box.x.min + box.x.max),
+                                -0.5f * (box.y.min + box.y.max),
+                                50.0f - 0.5f * (box.z.min + box.z.max)));
+  flat.mark_moved(1);
+  EXPECT_FALSE(flat.refit());
+  hit_record rec;
+  EXPECT_TRUE(flat.hit(ray(vec3(0, 0, 0), vec3(0, 0, 1)),
+                       interval(.001f, infinity), rec));
+  EXPECT_EQ(rec.object, spheres.objects[1].get());
+}
+
+TEST_F(TestLinearBvh, TestMoveTree) {
+  linear_bvh flat(spheres);
+  const float cost = flat.get_sah_cost();
+  std::vector<float> expected(200, -1.0f);
+  for (int i = 0; i < 200; i++) {
+    hit_record rec;
+    if (flat.hit(fan_ray(i, 200), interval(.001f, infinity), rec))
+      expected[i] = rec.t;
+  }
+
+  // The rays moved with the tree hit the same objects
+  const vec3 offset(10.0f, -3.0f, 2.0f);
+  flat.move(offset);
+  EXPECT_NEAR(flat.get_sah_cost(), cost, 1e-3f * cost);
+  check_tree(flat, bvh_build_options().max_leaf_size);
+  for (int i = 0; i < 200; i++) {
+    const ray r = fan_ray(i, 200);
+    hit_record rec;
+    const bool hit = flat.hit(ray(r.origin() + offset, r.direction()),
+                              interval(.001f, infinity), rec);
+    ASSERT_EQ(hit, expected[i] > 0) << i;
+    if (hit) {
+      EXPECT_NEAR(rec.t, expected[i], 1e-3f);
+    }
+  }
+}
+
+TEST_F(TestLinearBvh, TestMoveRebuilds) {
+  linear_bvh bvh(spheres);
+  const ray r(vec3(0, 0, 0), vec3(0, 0, -1));
+  hit_record before;
+  const bool hit_before = bvh.hit(r, interval(.001f, infinity), before);
+
+  // The whole cloud leaves the path of the ray, then comes back
+  bvh.move(vec3(100, 0, 0));
+  hit_record rec;
+  EXPECT_FALSE(bvh.hit(r, interval(.001f, infinity), rec));
+  EXPECT_GT(bvh.bounding_box().axis_interval(0).min, 90.0f);
+
+  bvh.move(vec3(-100, 0, 0));
+  ASSERT_EQ(bvh.hit(r, interval(.001f, infinity), rec), hit_before);
+  if (hit_before) {
+    EXPECT_NEAR(rec.t, before.t, 1e-3f);
+  }
+}
+
+TEST_F(TestLinearBvh, TestVisitsNotCountedWhenOff) {
+  linear_bvh flat(spheres);
+  const size_t visits = bvh_visit_counter();
+  hit_record rec;
+  flat.hit(fan_ray(0, 10), interval(.001f, infinity), rec);
+  ray_packet packet;
+  for (int i = 0; i < 8; i++) packet.add(fan_ray(i, 8));
+  packet.pad();
+  hit_record recs[ray_packet::max_size];
+  flat.hit_packet(packet, packet.full_mask(), .001f, recs);
+  EXPECT_EQ(bvh_visit_counter(), visits);
+}
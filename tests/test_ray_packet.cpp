@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "objects/bvh.hpp"
+#include "objects/sphere.hpp"
+
+class TestRayPacket : public ::testing::Test {
+ public:
+  TestRayPacket() {}
+  virtual ~TestRayPacket() {}
+
+  virtual void SetUp() override {
+    auto mat = make_shared<lambertian>(vec3(0.5f, 0.5f, 0.5f));
+    hittable_list spheres;
+    for (int i = 0; i < 5; i++)
+      for (int j = 0; j < 5; j++)
+        spheres.add(make_shared<sphere>(vec3(i - 2.0f, j - 2.0f, -5.0f - i),
+                                        0.4f, mat));
+    world = hittable_list(make_shared<bvh_node>(spheres));
+  }
+  virtual void TearDown() override {}
+
+  hittable_list world;
+};
+
+TEST_F(TestRayPacket, TestFullMask) {
+  ray_packet packet;
+  EXPECT_EQ(packet.full_mask(), 0u);
+  for (int i = 0; i < 4; i++) packet.add(ray(vec3(0, 0, 0), vec3(0, 0, -1)));
+  EXPECT_EQ(packet.full_mask(), 0xFu);
+}
+
+TEST_F(TestRayPacket, TestPacketMatchesSingleRays) {
+  for (int size : {4, 8, 16}) {
+    // A fan of rays, some hit the spheres and some miss
+    ray_packet packet;
+    for (int i = 0; i < size; i++)
+      packet.add(ray(vec3(0, 0, 0), vec3(-1.5f + 3.0f * i / size,
+                                         0.37f * (i % 5) - 0.8f, -1)));
+    packet.pad();
+
+    hit_record recs[ray_packet::max_size];
+    const uint32_t hits =
+        world.hit_packet(packet, packet.full_mask(), .0001f, recs);
+
+    for (int i = 0; i < size; i++) {
+      hit_record rec;
+      const bool hit = world.hit(packet.rays[i], interval(.0001f, infinity),
+                                 rec);
+      ASSERT_EQ(hit, ((hits >> i) & 1u) != 0)
+          << "size " << size << " ray " << i;
+      if (hit) {
+        EXPECT_FLOAT_EQ(rec.t, recs[i].t);
+      }
+    }
+  }
+}
+
+TEST_F(TestRayPacket, TestMaskedRaysAreSkipped) {
+  ray_packet packet;
+  for (int i = 0; i < 4; i++) packet.add(ray(vec3(0, 0, 0), vec3(0, 0, -1)));
+  packet.pad();
+
+  hit_record recs[ray_packet::max_size];
+  EXPECT_EQ(world.hit_packet(packet, 0x5u, .0001f, recs), 0x5u);
+}
+
+TEST_F(TestRayPacket, TestBoxPacket) {
+  aabb box(vec3(-1, -1, -3), vec3(1, 1, -2));
+  ray_packet packet;
+  packet.add(ray(vec3(0, 0, 0), vec3(0, 0, -1)));  // Hits
+  packet.add(ray(vec3(0, 0, 0), vec3(0, 0, 1)));   // Points away
+  packet.add(ray(vec3(0, 0, 0), vec3(1, 0, -1)));  // Passes beside
+  packet.add(ray(vec3(0, 0, 0), vec3(0.3f, 0.3f, -1)));  // Hits
+  packet.pad();
+  EXPECT_EQ(box.hit_packet(packet, packet.full_mask(), 0.0001f), 0x9u);
+
+  // A closer hit already found hides the box
+  packet.t_max[0] = 1.0f;
+  EXPECT_EQ(box.hit_packet(packet, packet.full_mask(), 0.0001f), 0x8u);
+}
+
+TEST_F(TestRayPacket, TestAxisParallelRays) {
+  aabb box(vec3(-1, -1, -3), vec3(1, 1, -2));
+  const ray rays[] = {
+      ray(vec3(0, 0, 0), vec3(0, 0, -1)),       // Hits, two 0 components
+      ray(vec3(2, 0, 0), vec3(0, 0, -1)),       // Outside the x slab
+      ray(vec3(1, 0, 0), vec3(0, 0, -1)),       // On the plane x = 1, grazes
+      ray(vec3(0, -1, 0), vec3(-0.0f, 0, -1)),  // -0, on the plane y = -1
+      ray(vec3(0, 0, 0), vec3(0, 0, 1)),        // Points away
+      ray(vec3(-2, 0, -2.5f), vec3(1, 0, 0)),   // Along x, through the box
+      ray(vec3(-2, 1.5f, -2.5f), vec3(1, -0.0f, 0)),  // Above it
+  };
+  const uint32_t expected = 0x2du;
+
+  ray_packet packet;
+  for (const ray& r : rays) packet.add(r);
+  packet.pad();
+  EXPECT_EQ(box.hit_packet(packet, packet.full_mask(), 0.0001f), expected);
+
+  for (int i = 0; i < packet.size; i++)
+    EXPECT_EQ(box.hit(rays[i], interval(0.0001f, infinity)),
+              ((expected >> i) & 1u) != 0)
+        << i;
+}
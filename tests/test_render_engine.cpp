@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include "objects/sphere.hpp"
+#include "render/render_engine.hpp"
+
+class TestRenderEngine : public ::testing::Test {
+ public:
+  TestRenderEngine() : cam(width, height, 4), engine(width, height) {}
+  virtual ~TestRenderEngine() {}
+
+  virtual void SetUp() override {
+    auto mat = make_shared<lambertian>(vec3(.5f, .5f, .5f));
+    world.add(make_shared<sphere>(vec3(0, 0, -2), 0.5f, mat));
+    engine.set_max_passes(3);
+  }
+  virtual void TearDown() override { engine.stop(); }
+
+  static const int width = 48;
+  static const int height = 32;
+
+  hittable_list world;
+  camera cam;
+  render_engine engine;
+
+  // Wait until the engine published its last pass
+  bool wait_until_done() {
+    const auto start = Clock::now();
+    while (Clock::now() - start < std::chrono::seconds(30)) {
+      if (engine.get_stats().done) return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+  }
+};
+
+TEST_F(TestRenderEngine, TestRendersInBackground) {
+  engine.start(&world, cam);
+  ASSERT_TRUE(wait_until_done());
+  EXPECT_EQ(engine.get_stats().passes, 3);
+
+  int lit = 0;
+  EXPECT_TRUE(engine.read_frame(
+      [&](const std::vector<Color>& frame, const std::vector<tile>& dirty) {
+        EXPECT_EQ(frame.size(), (size_t)(width * height));
+        EXPECT_FALSE(dirty.empty());
+        for (const Color& c : frame) lit += c.r + c.g + c.b > 0;
+      }));
+  EXPECT_EQ(lit, width * height);
+
+  // Nothing new was published since the last read
+  EXPECT_FALSE(engine.read_frame(
+      [](const std::vector<Color>&, const std::vector<tile>&) {}));
+}
+
+TEST_F(TestRenderEngine, TestCommandsRestartTheImage) {
+  engine.start(&world, cam);
+  ASSERT_TRUE(wait_until_done());
+
+  engine.reset();
+  engine.set_tile_order(tile_order::scanline);
+
+  // The engine wakes up, restarts and renders the passes again
+  const auto start = Clock::now();
+  while (engine.get_stats().done &&
+         Clock::now() - start < std::chrono::seconds(1))
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  ASSERT_TRUE(wait_until_done());
+  EXPECT_EQ(engine.get_stats().passes, 3);
+
+  // The restart republished the whole image
+  EXPECT_TRUE(engine.read_frame(
+      [](const std::vector<Color>&, const std::vector<tile>& dirty) {
+        EXPECT_EQ(dirty.front().pixel_count(), width * height);
+      }));
+}
+
+TEST_F(TestRenderEngine, TestStopInterruptsTheRender) {
+  // Never converges, so the engine is still busy when it is stopped
+  engine.set_max_passes(1000000);
+  engine.set_error_threshold(0);
+  engine.start(&world, cam);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  const auto start = Clock::now();
+  engine.stop();
+  EXPECT_LT(std::chrono::duration_cast<Secondsf>(Clock::now() - start).count(),
+            1.0f);
+  EXPECT_FALSE(engine.get_stats().done);
+}
+
+TEST_F(TestRenderEngine, TestPreviewWhileMoving) {
+  engine.set_preview(4, 2, 30.0f);
+  engine.start(&world, cam);
+  ASSERT_TRUE(wait_until_done());
+  engine.read_frame([](const std::vector<Color>&, const std::vector<tile>&) {});
+
+  // Moving the camera shows a quarter resolution frame right away, and no
+  // full resolution pass starts while the camera may still move
+  engine.set_camera(cam);
+  const auto start = Clock::now();
+  while (engine.get_stats().preview_scale == 0 &&
+         Clock::now() - start < std::chrono::seconds(5))
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  const render_stats stats = engine.get_stats();
+  EXPECT_EQ(stats.preview_scale, 4);
+  EXPECT_EQ(stats.passes, 0);
+  EXPECT_FALSE(stats.done);
+
+  int lit = 0;
+  EXPECT_TRUE(engine.read_frame(
+      [&](const std::vector<Color>& frame, const std::vector<tile>& dirty) {
+        EXPECT_EQ(dirty.front().pixel_count(), width * height);
+        for (const Color& c : frame) lit += c.r + c.g + c.b > 0;
+      }));
+  EXPECT_EQ(lit, width * height);
+}
+
+TEST_F(TestRenderEngine, TestFullResolutionResumes) {
+  engine.set_preview(0, 2, 0.01f);
+  engine.start(&world, cam);
+  ASSERT_TRUE(wait_until_done());
+
+  engine.set_camera(cam);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_TRUE(wait_until_done());
+
+  const render_stats stats = engine.get_stats();
+  EXPECT_EQ(stats.preview_scale, 0);
+  EXPECT_EQ(stats.passes, 3);
+}
+
+TEST_F(TestRenderEngine, TestDenoiseEveryBatch) {
+  engine.set_denoise(true);
+  engine.start(&world, cam);
+  ASSERT_TRUE(wait_until_done());
+  EXPECT_GT(engine.get_stats().denoise_time, 0.0f);
+
+  // The filter touches the whole image, so every publish is a full frame
+  int lit = 0;
+  EXPECT_TRUE(engine.read_frame(
+      [&](const std::vector<Color>& frame, const std::vector<tile>& dirty) {
+        EXPECT_EQ(dirty.front().pixel_count(), width * height);
+        for (const Color& c : frame) lit += c.r + c.g + c.b > 0;
+      }));
+  EXPECT_EQ(lit, width * height);
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include "utils.hpp"
+
+TEST(TestRng, TestSameSeedSameSequence) {
+  rng a(42), b(42), c(43);
+  bool differs = false;
+  for (int i = 0; i < 100; i++) {
+    const uint32_t value = a.next_uint();
+    EXPECT_EQ(value, b.next_uint());
+    differs |= value != c.next_uint();
+  }
+  EXPECT_TRUE(differs);
+}
+
+TEST(TestRng, TestFloatRange) {
+  rng generator(7);
+  float min = 1, max = 0, sum = 0;
+  const int n = 100000;
+  for (int i = 0; i < n; i++) {
+    const float value = generator.next_float();
+    ASSERT_GE(value, 0.0f);
+    ASSERT_LT(value, 1.0f);
+    min = std::min(min, value);
+    max = std::max(max, value);
+    sum += value;
+  }
+  EXPECT_LT(min, 0.001f);
+  EXPECT_GT(max, 0.999f);
+  EXPECT_NEAR(sum / n, 0.5f, 0.01f);
+}
+
+TEST(TestRng, TestRandomInt) {
+  int counts[5] = {0};
+  for (int i = 0; i < 10000; i++) {
+    const int value = random_int(3, 7);
+    ASSERT_GE(value, 3);
+    ASSERT_LE(value, 7);
+    counts[value - 3]++;
+  }
+  for (int count : counts) EXPECT_GT(count, 1500);
+}
+
+TEST(TestRng, TestSetRandomSeed) {
+  set_random_seed(1234);
+  std::vector<float> first;
+  for (int i = 0; i < 16; i++) first.push_back(random_float());
+
+  set_random_seed(1234);
+  for (int i = 0; i < 16; i++) EXPECT_EQ(random_float(), first[i]);
+}
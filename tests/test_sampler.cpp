@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include "render/sampler.hpp"
+
+TEST(TestSampler, TestValuesInRange) {
+  for (sampler_type type : {sampler_type::independent, sampler_type::sobol}) {
+    sampler s(type);
+    for (uint32_t i = 0; i < 1000; i++) {
+      s.start_pixel_sample(17, i);
+      float u, v;
+      s.get_2d(u, v);
+      const float w = s.get_1d();
+      ASSERT_GE(u, 0.0f);
+      ASSERT_LT(u, 1.0f);
+      ASSERT_GE(v, 0.0f);
+      ASSERT_LT(v, 1.0f);
+      ASSERT_GE(w, 0.0f);
+      ASSERT_LT(w, 1.0f);
+    }
+  }
+}
+
+TEST(TestSampler, TestSobolIsStratified2D) {
+  // The first 16 points of a pixel fall in every cell of a 4x4 grid, and
+  // also of a 16x1 and a 1x16 grid, whichever dimensions are drawn
+  sampler s(sampler_type::sobol, 3);
+  for (int pixel : {0, 1, 12345}) {
+    for (uint32_t dimension : {0u, 4u, 9u}) {
+      int grid[16] = {0}, rows[16] = {0}, columns[16] = {0};
+      for (uint32_t i = 0; i < 16; i++) {
+        s.start_pixel_sample(pixel, i);
+        s.start_bounce(1, dimension);
+        float u, v;
+        s.get_2d(u, v);
+        grid[(int)(v * 4) * 4 + (int)(u * 4)]++;
+        columns[(int)(u * 16)]++;
+        rows[(int)(v * 16)]++;
+      }
+      for (int i = 0; i < 16; i++) {
+        EXPECT_EQ(grid[i], 1) << "pixel " << pixel << " cell " << i;
+        EXPECT_EQ(columns[i], 1) << "pixel " << pixel << " column " << i;
+        EXPECT_EQ(rows[i], 1) << "pixel " << pixel << " row " << i;
+      }
+    }
+  }
+}
+
+TEST(TestSampler, TestSobolIsStratified1D) {
+  sampler s(sampler_type::sobol);
+  int strata[32] = {0};
+  for (uint32_t i = 0; i < 32; i++) {
+    s.start_pixel_sample(42, i);
+    s.start_bounce(2, sampler::roulette_dimension);
+    strata[(int)(s.get_1d() * 32)]++;
+  }
+  for (int count : strata) EXPECT_EQ(count, 1);
+}
+
+TEST(TestSampler, TestPixelsAreDecorrelated) {
+  // The same sample of two pixels must not land on the same point
+  sampler s(sampler_type::sobol);
+  int equal = 0;
+  for (uint32_t i = 0; i < 64; i++) {
+    float u0, v0, u1, v1;
+    s.start_pixel_sample(0, i);
+    s.get_2d(u0, v0);
+    s.start_pixel_sample(1, i);
+    s.get_2d(u1, v1);
+    if (u0 == u1 && v0 == v1) equal++;
+  }
+  EXPECT_EQ(equal, 0);
+}
+
+TEST(TestSampler, TestDeterministicIndependentSamples) {
+  // The numbers only depend on (seed, pixel, sample, dimension), not on
+  // what the sampler drew before
+  sampler a(sampler_type::independent, 5, true);
+  sampler b(sampler_type::independent, 5, true);
+  for (int i = 0; i < 100; i++) b.get_1d();
+
+  a.start_pixel_sample(42, 3);
+  b.start_pixel_sample(42, 3);
+  for (int d = 0; d < 8; d++) EXPECT_EQ(a.get_1d(), b.get_1d());
+
+  a.start_pixel_sample(42, 3);
+  b.start_pixel_sample(42, 3);
+  a.start_bounce(2);
+  b.get_1d();
+  b.start_bounce(2);
+  EXPECT_EQ(a.get_1d(), b.get_1d());
+
+  // Another seed, pixel or sample draws other numbers
+  sampler c(sampler_type::independent, 6, true);
+  a.start_pixel_sample(42, 3);
+  c.start_pixel_sample(42, 3);
+  EXPECT_NE(a.get_1d(), c.get_1d());
+  a.start_pixel_sample(42, 3);
+  b.start_pixel_sample(42, 4);
+  EXPECT_NE(a.get_1d(), b.get_1d());
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include "objects/sphere.hpp"
+#include "render/temporal_reprojection.hpp"
+
+class TestTemporalReprojection : public ::testing::Test {
+ public:
+  TestTemporalReprojection()
+      : cam(width, height, 4),
+        previous_geometry(width, height),
+        current_geometry(width, height),
+        previous_accum(width, height),
+        current_accum(width, height) {}
+  virtual ~TestTemporalReprojection() {}
+
+  virtual void SetUp() override {
+    // A small sphere in front of a wall that fills the view
+    auto mat = make_shared<lambertian>(vec3(.5f, .5f, .5f));
+    world.add(make_shared<sphere>(vec3(0, 0, -2), 0.5f, mat));
+    world.add(make_shared<sphere>(vec3(0, 0, -100), 90.0f, mat));
+
+    // Every pixel of the previous view has 8 samples of its own color
+    previous_geometry.build(cam, &world);
+    for (int i = 0; i < width * height; i++)
+      for (int s = 0; s < 8; s++) previous_accum.add_sample(i, vec3(i, 0, 0));
+  }
+
+  static const int width = 48;
+  static const int height = 32;
+
+  hittable_list world;
+  camera cam;
+  geometry_buffer previous_geometry;
+  geometry_buffer current_geometry;
+  accumulation_buffer previous_accum;
+  accumulation_buffer current_accum;
+};
+
+TEST_F(TestTemporalReprojection, TestProjectIsTheInverseOfGetRay) {
+  sampler s;
+  const ray r = cam.get_ray(10.5f, 20.5f, s);
+
+  float px, py;
+  ASSERT_TRUE(cam.project(r.at(3.0f), px, py));
+  EXPECT_NEAR(px, 10.5f, 1e-3f);
+  EXPECT_NEAR(py, 20.5f, 1e-3f);
+
+  // Behind the camera
+  EXPECT_FALSE(cam.project(cam.get_position() + vec3(0, 0, 1), px, py));
+}
+
+TEST_F(TestTemporalReprojection, TestStillCameraKeepsEverything) {
+  temporal_reprojection reprojection(32);
+  current_geometry.build(cam, &world);
+
+  const size_t kept =
+      reprojection.reproject(cam, previous_geometry, previous_accum, cam,
+                             current_geometry, current_accum);
+  EXPECT_EQ(kept, (size_t)(width * height));
+
+  for (int i = 0; i < width * height; i++) {
+    EXPECT_EQ(current_accum.get_samples(i), 8u);
+    EXPECT_NEAR(current_accum.get_average(i).x(), (float)i, 1e-3f * i);
+  }
+}
+
+TEST_F(TestTemporalReprojection, TestDisocclusionsAreRejected) {
+  temporal_reprojection reprojection(32);
+  camera moved = cam;
+  moved.set_position(vec3(0.3f, 0, 0));
+  current_geometry.build(moved, &world);
+
+  const size_t kept =
+      reprojection.reproject(cam, previous_geometry, previous_accum, moved,
+                             current_geometry, current_accum);
+  EXPECT_GT(kept, (size_t)(width * height / 2));
+  EXPECT_LT(kept, (size_t)(width * height));
+
+  // The wall right next to the sphere was hidden behind it before the move
+  size_t empty = 0, empty_wall = 0;
+  for (int i = 0; i < width * height; i++) {
+    if (current_accum.get_samples(i) == 0) {
+      empty++;
+      empty_wall += current_geometry.get_distance(i) > 5.0f;
+    }
+  }
+  EXPECT_EQ(empty, width * height - kept);
+  EXPECT_GT(empty_wall, 0u);
+}
+
+TEST_F(TestTemporalReprojection, TestHistoryIsCapped) {
+  temporal_reprojection reprojection(2);
+  current_geometry.build(cam, &world);
+
+  reprojection.reproject(cam, previous_geometry, previous_accum, cam,
+                         current_geometry, current_accum);
+  EXPECT_EQ(current_accum.get_samples(5), 2u);
+  EXPECT_NEAR(current_accum.get_average(5).x(), 5.0f, 1e-3f);
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "render/tile_scheduler.hpp"
+
+class TestTileScheduler : public ::testing::Test {
+ public:
+  TestTileScheduler() {}
+  virtual ~TestTileScheduler() {}
+
+  virtual void SetUp() override {}
+  virtual void TearDown() override {}
+
+  // Count how many times every pixel is visited by a full dispatch
+  static std::vector<int> visit_counts(tile_scheduler& scheduler,
+                                       const int width, const int height) {
+    std::vector<std::atomic<int>> counts(width * height);
+    for (auto& count : counts) count = 0;
+
+    scheduler.dispatch(0, scheduler.tile_count(), [&](const tile& t) {
+      scheduler.for_each_pixel(
+          t, [&](const int x, const int y) { counts[y * width + x]++; });
+    });
+
+    std::vector<int> result;
+    for (auto& count : counts) result.push_back(count);
+    return result;
+  }
+};
+
+TEST_F(TestTileScheduler, TestTileCount) {
+  tile_scheduler scheduler(100, 50, 16);
+  // ceil(100 / 16) * ceil(50 / 16)
+  EXPECT_EQ(scheduler.tile_count(), 7u * 4u);
+}
+
+TEST_F(TestTileScheduler, TestEdgeTilesAreClipped) {
+  tile_scheduler scheduler(20, 20, 16, tile_order::scanline);
+  EXPECT_EQ(scheduler.get_tile(0).pixel_count(), 16 * 16);
+  EXPECT_EQ(scheduler.get_tile(1).pixel_count(), 4 * 16);
+  EXPECT_EQ(scheduler.get_tile(3).pixel_count(), 4 * 4);
+}
+
+TEST_F(TestTileScheduler, TestEveryPixelOnceScanline) {
+  tile_scheduler scheduler(103, 61, 16, tile_order::scanline);
+  for (int count : visit_counts(scheduler, 103, 61)) EXPECT_EQ(count, 1);
+}
+
+TEST_F(TestTileScheduler, TestEveryPixelOnceSpiral) {
+  tile_scheduler scheduler(103, 61, 8, tile_order::spiral);
+  for (int count : visit_counts(scheduler, 103, 61)) EXPECT_EQ(count, 1);
+}
+
+TEST_F(TestTileScheduler, TestEveryPixelOnceRandom) {
+  tile_scheduler scheduler(103, 61, 4, tile_order::random);
+  for (int count : visit_counts(scheduler, 103, 61)) EXPECT_EQ(count, 1);
+}
+
+TEST_F(TestTileScheduler, TestPartialDispatch) {
+  tile_scheduler scheduler(64, 64, 16);
+  std::atomic<int> tiles_done(0);
+  scheduler.dispatch(3, 9, [&](const tile&) { tiles_done++; });
+  EXPECT_EQ(tiles_done, 6);
+}
+
+TEST_F(TestTileScheduler, TestMortonOrderStartsInCorner) {
+  tile_scheduler scheduler(8, 8, 4, tile_order::scanline);
+  std::vector<std::pair<int, int>> visited;
+  scheduler.for_each_pixel(scheduler.get_tile(0), [&](int x, int y) {
+    visited.emplace_back(x, y);
+  });
+  ASSERT_EQ(visited.size(), 16u);
+  EXPECT_EQ(visited[0], std::make_pair(0, 0));
+  EXPECT_EQ(visited[1], std::make_pair(1, 0));
+  EXPECT_EQ(visited[2], std::make_pair(0, 1));
+  EXPECT_EQ(visited[3], std::make_pair(1, 1));
+  EXPECT_EQ(visited[4], std::make_pair(2, 0));
+}
+
+TEST_F(TestTileScheduler, TestSeededShuffleRepeats) {
+  tile_scheduler a(200, 100, 16, tile_order::scanline);
+  tile_scheduler b(200, 100, 16, tile_order::scanline);
+  a.set_shuffle_seed(7);
+  b.set_shuffle_seed(7);
+  a.set_order(tile_order::random);
+  b.set_order(tile_order::random);
+
+  bool shuffled = false;
+  for (size_t i = 0; i < a.tile_count(); i++) {
+    EXPECT_EQ(a.get_tile(i).x0, b.get_tile(i).x0);
+    EXPECT_EQ(a.get_tile(i).y0, b.get_tile(i).y0);
+    if (a.get_tile(i).x0 != (int)(i % 13) * 16) shuffled = true;
+  }
+  EXPECT_TRUE(shuffled);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include "objects/bvh.hpp"
+#include "objects/sphere.hpp"
+#include "render/wavefront_integrator.hpp"
+
+class TestWavefrontIntegrator : public ::testing::Test {
+ public:
+  TestWavefrontIntegrator() : cam(width, height, 10), accum(width, height) {}
+  virtual ~TestWavefrontIntegrator() {}
+
+  virtual void SetUp() override {
+    shared_ptr<material> diffuse =
+        make_shared<lambertian>(vec3(0.5f, 0.5f, 0.5f));
+    shared_ptr<material> mirror =
+        make_shared<metal>(vec3(0.8f, 0.8f, 0.8f), 0.1f);
+    hittable_list spheres;
+    for (int i = 0; i < 4; i++)
+      spheres.add(make_shared<sphere>(vec3(i - 1.5f, 0.0f, -3.0f), 0.45f,
+                                      i % 2 ? diffuse : mirror));
+    spheres.add(make_shared<sphere>(vec3(0, -100.5f, -3.0f), 100.0f, diffuse));
+    world = hittable_list(make_shared<bvh_node>(spheres));
+
+    for (int i = 0; i < width * height; i++) pixels.push_back(i);
+  }
+  virtual void TearDown() override {}
+
+  static const int width = 32;
+  static const int height = 18;
+
+  camera cam;
+  accumulation_buffer accum;
+  hittable_list world;
+  std::vector<int> pixels;
+
+  float average_luminance() const {
+    float total = 0;
+    for (int i = 0; i < width * height; i++)
+      total += accumulation_buffer::luminance(accum.get_average(i));
+    return total / (width * height);
+  }
+};
+
+TEST_F(TestWavefrontIntegrator, TestEmptyWorld) {
+  // Every path escapes straight away, so it is exactly one ray long
+  hittable_list empty;
+  wavefront_integrator integrator(1000);
+  const size_t rays = integrator.render(cam, &empty, pixels, 7, accum);
+
+  EXPECT_EQ(rays, pixels.size() * 7);
+  for (int i = 0; i < width * height; i++) EXPECT_EQ(accum.get_samples(i), 7u);
+}
+
+TEST_F(TestWavefrontIntegrator, TestMatchesPathTracer) {
+  // The batches are smaller than the image and split the samples of pixels
+  wavefront_integrator integrator(1000);
+  integrator.render(cam, &world, pixels, 64, accum);
+  const float wavefront = average_luminance();
+  for (int i = 0; i < width * height; i++)
+    EXPECT_EQ(accum.get_samples(i), 64u);
+
+  accum.reset();
+  sampler independent;
+  for (const int p : pixels)
+    for (int s = 0; s < 64; s++) {
+      independent.start_pixel_sample(p, s);
+      accum.add_sample(p, cam.send_ray(&world, p % width + random_float() - .5f,
+                                       p / width + random_float() - .5f,
+                                       independent));
+    }
+  const float path = average_luminance();
+
+  EXPECT_GT(wavefront, 0.0f);
+  EXPECT_NEAR(wavefront, path, 0.03f * path);
+}